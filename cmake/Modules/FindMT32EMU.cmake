@@ -2,7 +2,7 @@
 # Once done this will define
 #  MT32EMU_FOUND - System has mt32emu
 #  MT32EMU_INCLUDE_DIRS - The location of the mt32emu include directory
-#  MT32EMU_LIBRARIES - The location of the mt32emu library
+#  MT32EMU_LIBRARIES - The location of the mt32emu library and the libraries it depends on
 
 find_path(MT32EMU_INCLUDE_DIR mt32emu/mt32emu.h)
 
@@ -13,7 +13,7 @@ include(FindPackageHandleStandardArgs)
 # all listed variables are TRUE
 find_package_handle_standard_args(MT32EMU DEFAULT_MSG MT32EMU_LIBRARY MT32EMU_INCLUDE_DIR)
 
-set(MT32EMU_LIBRARIES ${MT32EMU_LIBRARY})
+set(MT32EMU_LIBRARIES ${MT32EMU_LIBRARY} ${MT32EMU_LINK_LIBRARIES})
 set(MT32EMU_INCLUDE_DIRS ${MT32EMU_INCLUDE_DIR})
 
-mark_as_advanced(MT32EMU_LIBRARY MT32EMU_INCLUDE_DIR)
+mark_as_advanced(MT32EMU_LIBRARY MT32EMU_LINK_LIBRARIES MT32EMU_INCLUDE_DIR)
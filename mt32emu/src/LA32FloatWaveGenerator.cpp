@@ -315,6 +315,11 @@ void LA32PartialPair::generateNextSample(const PairType useMaster, const Bit32u
 	}
 }
 
+void LA32PartialPair::skipNextSample(const PairType useMaster, const Bit32u amp, const Bit16u pitch, const Bit32u cutoff) {
+	// The wave position of the float model depends on the whole computation of the sample, so only the output is discarded
+	generateNextSample(useMaster, amp, pitch, cutoff);
+}
+
 static inline float produceDistortedSample(float sample) {
 	if (sample < -1.0f) {
 		return sample + 2.0f;
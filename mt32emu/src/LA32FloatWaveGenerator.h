@@ -127,6 +127,9 @@ public:
 	// Update parameters with respect to TVP, TVA and TVF, and generate next sample
 	void generateNextSample(const PairType master, const Bit32u amp, const Bit16u pitch, const Bit32u cutoff);
 
+	// Update parameters and advance the wave position, the next output sample is not to be requested
+	void skipNextSample(const PairType master, const Bit32u amp, const Bit16u pitch, const Bit32u cutoff);
+
 	// Perform mixing / ring modulation and return the result
 	float nextOutSample();
 
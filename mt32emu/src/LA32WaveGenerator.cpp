@@ -220,6 +220,7 @@ void LA32WaveGenerator::pcmSampleToLogSample(LogSample &logSample, const Bit16s
 	logSample.sign = pcmSample < 0 ? LogSample::NEGATIVE : LogSample::POSITIVE;
 }
 
+template <bool looped, bool interpolated>
 void LA32WaveGenerator::generateNextPCMWaveLogSamples() {
 	// This should emulate the ladder we see in the PCM captures for pitches 01, 02, 07, etc.
 	// The most probable cause is the factor in the interpolation formula is one bit less
@@ -227,12 +228,12 @@ void LA32WaveGenerator::generateNextPCMWaveLogSamples() {
 	pcmInterpolationFactor = (wavePosition & 255) >> 1;
 	Bit32u pcmWaveTableIx = wavePosition >> 8;
 	pcmSampleToLogSample(firstPCMLogSample, pcmWaveAddress[pcmWaveTableIx]);
-	if (pcmWaveInterpolated) {
+	if (interpolated) {
 		pcmWaveTableIx++;
 		if (pcmWaveTableIx < pcmWaveLength) {
 			pcmSampleToLogSample(secondPCMLogSample, pcmWaveAddress[pcmWaveTableIx]);
 		} else {
-			if (pcmWaveLooped) {
+			if (looped) {
 				pcmWaveTableIx -= pcmWaveLength;
 				pcmSampleToLogSample(secondPCMLogSample, pcmWaveAddress[pcmWaveTableIx]);
 			} else {
@@ -242,6 +243,11 @@ void LA32WaveGenerator::generateNextPCMWaveLogSamples() {
 	} else {
 		secondPCMLogSample = SILENCE;
 	}
+	advancePCMWavePosition<looped>();
+}
+
+template <bool looped>
+void LA32WaveGenerator::advancePCMWavePosition() {
 	// pcmSampleStep = (Bit32u)EXP2F(pitch / 4096.0f + 3.0f);
 	Bit32u pcmSampleStep = LA32Utilites::interpolateExp(~pitch & 4095);
 	pcmSampleStep <<= pitch >> 12;
@@ -250,7 +256,7 @@ void LA32WaveGenerator::generateNextPCMWaveLogSamples() {
 	pcmSampleStep >>= 9;
 	wavePosition += pcmSampleStep;
 	if (wavePosition >= (pcmWaveLength << 8)) {
-		if (pcmWaveLooped) {
+		if (looped) {
 			wavePosition -= pcmWaveLength << 8;
 		} else {
 			deactivate();
@@ -274,6 +280,11 @@ void LA32WaveGenerator::initSynth(const bool useSawtoothWaveform, const Bit8u us
 	resAmpDecayFactor = Tables::getInstance().resAmpDecayFactor[resonance >> 2] << 2;
 
 	pcmWaveAddress = NULL;
+	if (sawtoothWaveform) {
+		sampleGenerator = &LA32WaveGenerator::generateNextSynthSample<true>;
+	} else {
+		sampleGenerator = &LA32WaveGenerator::generateNextSynthSample<false>;
+	}
 	active = true;
 }
 
@@ -284,29 +295,34 @@ void LA32WaveGenerator::initPCM(const Bit16s * const usePCMWaveAddress, const Bi
 	pcmWaveInterpolated = usePCMWaveInterpolated;
 
 	wavePosition = 0;
+	if (pcmWaveLooped) {
+		if (pcmWaveInterpolated) {
+			sampleGenerator = &LA32WaveGenerator::generateNextPCMSample<true, true>;
+		} else {
+			sampleGenerator = &LA32WaveGenerator::generateNextPCMSample<true, false>;
+		}
+	} else {
+		if (pcmWaveInterpolated) {
+			sampleGenerator = &LA32WaveGenerator::generateNextPCMSample<false, true>;
+		} else {
+			sampleGenerator = &LA32WaveGenerator::generateNextPCMSample<false, false>;
+		}
+	}
 	active = true;
 }
 
-void LA32WaveGenerator::generateNextSample(const Bit32u useAmp, const Bit16u usePitch, const Bit32u useCutoffVal) {
-	if (!active) {
-		return;
-	}
-
+template <bool sawtooth>
+void LA32WaveGenerator::generateNextSynthSample(const Bit32u useAmp, const Bit16u usePitch, const Bit32u useCutoffVal) {
 	amp = useAmp;
 	pitch = usePitch;
 
-	if (isPCMWave()) {
-		generateNextPCMWaveLogSamples();
-		return;
-	}
-
 	// The 240 cutoffVal limit was determined via sample analysis (internal Munt capture IDs: glop3, glop4).
 	// More research is needed to be sure that this is correct, however.
 	cutoffVal = (useCutoffVal > MAX_CUTOFF_VALUE) ? MAX_CUTOFF_VALUE : useCutoffVal;
 
 	generateNextSquareWaveLogSample();
 	generateNextResonanceWaveLogSample();
-	if (sawtoothWaveform) {
+	if (sawtooth) {
 		LogSample cosineLogSample;
 		generateNextSawtoothCosineLogSample(cosineLogSample);
 		LA32Utilites::addLogSamples(squareLogSample, cosineLogSample);
@@ -315,6 +331,41 @@ void LA32WaveGenerator::generateNextSample(const Bit32u useAmp, const Bit16u use
 	advancePosition();
 }
 
+template <bool looped, bool interpolated>
+void LA32WaveGenerator::generateNextPCMSample(const Bit32u useAmp, const Bit16u usePitch, const Bit32u /*useCutoffVal*/) {
+	amp = useAmp;
+	pitch = usePitch;
+	generateNextPCMWaveLogSamples<looped, interpolated>();
+}
+
+void LA32WaveGenerator::generateNextSample(const Bit32u useAmp, const Bit16u usePitch, const Bit32u useCutoffVal) {
+	if (!active) {
+		return;
+	}
+	(this->*sampleGenerator)(useAmp, usePitch, useCutoffVal);
+}
+
+void LA32WaveGenerator::skipNextSample(const Bit32u useAmp, const Bit16u usePitch, const Bit32u useCutoffVal) {
+	if (!active) {
+		return;
+	}
+
+	amp = useAmp;
+	pitch = usePitch;
+
+	if (isPCMWave()) {
+		if (pcmWaveLooped) {
+			advancePCMWavePosition<true>();
+		} else {
+			advancePCMWavePosition<false>();
+		}
+		return;
+	}
+
+	cutoffVal = (useCutoffVal > MAX_CUTOFF_VALUE) ? MAX_CUTOFF_VALUE : useCutoffVal;
+	advancePosition();
+}
+
 LogSample LA32WaveGenerator::getOutputLogSample(const bool first) const {
 	if (!isActive()) {
 		return SILENCE;
@@ -344,6 +395,31 @@ Bit32u LA32WaveGenerator::getPCMInterpolationFactor() const {
 void LA32PartialPair::init(const bool useRingModulated, const bool useMixed) {
 	ringModulated = useRingModulated;
 	mixed = useMixed;
+	selectOutSampleMixer();
+}
+
+void LA32PartialPair::selectOutSampleMixer() {
+	if (!ringModulated) {
+		// The slave WG engine is deactivated in this case, as each partial is paired with an own LA32PartialPair
+		if (master.isPCMWave()) {
+			outSampleMixer = &LA32PartialPair::nextMixedOutSample<true>;
+		} else {
+			outSampleMixer = &LA32PartialPair::nextMixedOutSample<false>;
+		}
+		return;
+	}
+	static const OutSampleMixer RING_MODULATED_OUT_SAMPLE_MIXERS[] = {
+		&LA32PartialPair::nextRingModulatedOutSample<false, false, false>,
+		&LA32PartialPair::nextRingModulatedOutSample<false, false, true>,
+		&LA32PartialPair::nextRingModulatedOutSample<false, true, false>,
+		&LA32PartialPair::nextRingModulatedOutSample<false, true, true>,
+		&LA32PartialPair::nextRingModulatedOutSample<true, false, false>,
+		&LA32PartialPair::nextRingModulatedOutSample<true, false, true>,
+		&LA32PartialPair::nextRingModulatedOutSample<true, true, false>,
+		&LA32PartialPair::nextRingModulatedOutSample<true, true, true>
+	};
+	unsigned int mixerIx = (master.isPCMWave() ? 4 : 0) | (slave.isPCMWave() ? 2 : 0) | (mixed ? 1 : 0);
+	outSampleMixer = RING_MODULATED_OUT_SAMPLE_MIXERS[mixerIx];
 }
 
 void LA32PartialPair::initSynth(const PairType useMaster, const bool sawtoothWaveform, const Bit8u pulseWidth, const Bit8u resonance) {
@@ -352,6 +428,7 @@ void LA32PartialPair::initSynth(const PairType useMaster, const bool sawtoothWav
 	} else {
 		slave.initSynth(sawtoothWaveform, pulseWidth, resonance);
 	}
+	selectOutSampleMixer();
 }
 
 void LA32PartialPair::initPCM(const PairType useMaster, const Bit16s *pcmWaveAddress, const Bit32u pcmWaveLength, const bool pcmWaveLooped) {
@@ -360,6 +437,7 @@ void LA32PartialPair::initPCM(const PairType useMaster, const Bit16s *pcmWaveAdd
 	} else {
 		slave.initPCM(pcmWaveAddress, pcmWaveLength, pcmWaveLooped, !ringModulated);
 	}
+	selectOutSampleMixer();
 }
 
 void LA32PartialPair::generateNextSample(const PairType useMaster, const Bit32u amp, const Bit16u pitch, const Bit32u cutoff) {
@@ -370,23 +448,36 @@ void LA32PartialPair::generateNextSample(const PairType useMaster, const Bit32u
 	}
 }
 
+void LA32PartialPair::skipNextSample(const PairType useMaster, const Bit32u amp, const Bit16u pitch, const Bit32u cutoff) {
+	if (useMaster == MASTER) {
+		master.skipNextSample(amp, pitch, cutoff);
+	} else {
+		slave.skipNextSample(amp, pitch, cutoff);
+	}
+}
+
+template <bool pcm>
 Bit16s LA32PartialPair::unlogAndMixWGOutput(const LA32WaveGenerator &wg) {
 	if (!wg.isActive()) {
 		return 0;
 	}
-	Bit16s firstSample = LA32Utilites::unlog(wg.getOutputLogSample(true));
-	Bit16s secondSample = LA32Utilites::unlog(wg.getOutputLogSample(false));
-	if (wg.isPCMWave()) {
+	if (pcm) {
+		Bit16s firstSample = LA32Utilites::unlog(wg.firstPCMLogSample);
+		Bit16s secondSample = LA32Utilites::unlog(wg.secondPCMLogSample);
 		return Bit16s(firstSample + ((Bit32s(secondSample - firstSample) * wg.getPCMInterpolationFactor()) >> 7));
 	}
+	Bit16s firstSample = LA32Utilites::unlog(wg.squareLogSample);
+	Bit16s secondSample = LA32Utilites::unlog(wg.resonanceLogSample);
 	return firstSample + secondSample;
 }
 
-Bit16s LA32PartialPair::nextOutSample() {
-	if (!ringModulated) {
-		return unlogAndMixWGOutput(master) + unlogAndMixWGOutput(slave);
-	}
+template <bool masterPCM>
+Bit16s LA32PartialPair::nextMixedOutSample() {
+	return unlogAndMixWGOutput<masterPCM>(master);
+}
 
+template <bool masterPCM, bool slavePCM, bool mixMaster>
+Bit16s LA32PartialPair::nextRingModulatedOutSample() {
 	/*
 	 * SEMI-CONFIRMED: Ring modulation model derived from sample analysis of specially constructed patches which exploit distortion.
 	 * LA32 ring modulator found to produce distorted output in case if the absolute value of maximal amplitude of one of the input partials exceeds 8191.
@@ -395,7 +486,7 @@ Bit16s LA32PartialPair::nextOutSample() {
 	 * it is reasonable to assume the ring modulation is performed also in the linear space by sample multiplication.
 	 * Most probably the overflow is caused by limited precision of the multiplication circuit as the very similar distortion occurs with panning.
 	 */
-	Bit16s nonOverdrivenMasterSample = unlogAndMixWGOutput(master); // Store master partial sample for further mixing
+	Bit16s nonOverdrivenMasterSample = unlogAndMixWGOutput<masterPCM>(master); // Store master partial sample for further mixing
 	Bit16s masterSample = nonOverdrivenMasterSample << 2;
 	masterSample >>= 2;
 
@@ -404,11 +495,21 @@ Bit16s LA32PartialPair::nextOutSample() {
 	 * It's assumed that the multiplication circuitry intended to perform the interpolation on the slave PCM partial
 	 * is borrowed by the ring modulation circuit (or the LA32 chip has a similar lack of resources assigned to each partial pair).
 	 */
-	Bit16s slaveSample = slave.isPCMWave() ? LA32Utilites::unlog(slave.getOutputLogSample(true)) : unlogAndMixWGOutput(slave);
+	Bit16s slaveSample;
+	if (slavePCM) {
+		// Unlogging SILENCE yields 0 for an inactive WG engine
+		slaveSample = slave.isActive() ? LA32Utilites::unlog(slave.firstPCMLogSample) : 0;
+	} else {
+		slaveSample = unlogAndMixWGOutput<false>(slave);
+	}
 	slaveSample <<= 2;
 	slaveSample >>= 2;
 	Bit16s ringModulatedSample = Bit16s(((Bit32s)masterSample * (Bit32s)slaveSample) >> 13);
-	return mixed ? nonOverdrivenMasterSample + ringModulatedSample : ringModulatedSample;
+	return mixMaster ? nonOverdrivenMasterSample + ringModulatedSample : ringModulatedSample;
+}
+
+Bit16s LA32PartialPair::nextOutSample() {
+	return (this->*outSampleMixer)();
 }
 
 void LA32PartialPair::deactivate(const PairType useMaster) {
@@ -61,6 +61,8 @@ public:
  * To synthesise sawtooth waves, the resulting square wave is multiplied by synchronous cosine wave.
  */
 class LA32WaveGenerator {
+friend class LA32PartialPair;
+
 	//***************************************************************************
 	//  The local copy of partial parameters below
 	//***************************************************************************
@@ -158,6 +160,11 @@ class LA32WaveGenerator {
 	LogSample firstPCMLogSample;
 	LogSample secondPCMLogSample;
 
+	// The kind of the wave and the PCM wave flags are invariant during the life of a partial,
+	// so the variant of the generator specialised for them is selected once upon initialisation
+	typedef void (LA32WaveGenerator::*SampleGenerator)(const Bit32u amp, const Bit16u pitch, const Bit32u cutoff);
+	SampleGenerator sampleGenerator;
+
 	//***************************************************************************
 	// Internal methods below
 	//***************************************************************************
@@ -174,7 +181,15 @@ class LA32WaveGenerator {
 	void generateNextSawtoothCosineLogSample(LogSample &logSample) const;
 
 	void pcmSampleToLogSample(LogSample &logSample, const Bit16s pcmSample) const;
+	template <bool looped, bool interpolated>
 	void generateNextPCMWaveLogSamples();
+	template <bool looped>
+	void advancePCMWavePosition();
+
+	template <bool sawtooth>
+	void generateNextSynthSample(const Bit32u amp, const Bit16u pitch, const Bit32u cutoff);
+	template <bool looped, bool interpolated>
+	void generateNextPCMSample(const Bit32u amp, const Bit16u pitch, const Bit32u cutoff);
 
 public:
 	// Initialise the WG engine for generation of synth partial samples and set up the invariant parameters
@@ -186,6 +201,9 @@ public:
 	// Update parameters with respect to TVP, TVA and TVF, and generate next sample
 	void generateNextSample(const Bit32u amp, const Bit16u pitch, const Bit32u cutoff);
 
+	// Update parameters and advance the wave position as generateNextSample() does, but leave the output samples undefined
+	void skipNextSample(const Bit32u amp, const Bit16u pitch, const Bit32u cutoff);
+
 	// WG output in the log-space consists of two components which are to be added (or ring modulated) in the linear-space afterwards
 	LogSample getOutputLogSample(const bool first) const;
 
@@ -209,8 +227,21 @@ class LA32PartialPair {
 	bool ringModulated;
 	bool mixed;
 
+	// Variant of nextOutSample() specialised for the structure and the kinds of the waves of both partials,
+	// updated whenever either of them is initialised
+	typedef Bit16s (LA32PartialPair::*OutSampleMixer)();
+	OutSampleMixer outSampleMixer;
+
+	template <bool pcm>
 	static Bit16s unlogAndMixWGOutput(const LA32WaveGenerator &wg);
 
+	template <bool masterPCM>
+	Bit16s nextMixedOutSample();
+	template <bool masterPCM, bool slavePCM, bool mixMaster>
+	Bit16s nextRingModulatedOutSample();
+
+	void selectOutSampleMixer();
+
 public:
 	enum PairType {
 		MASTER,
@@ -231,6 +262,9 @@ public:
 	// Update parameters with respect to TVP, TVA and TVF, and generate next sample
 	void generateNextSample(const PairType master, const Bit32u amp, const Bit16u pitch, const Bit32u cutoff);
 
+	// Update parameters and advance the wave position, the next output sample is not to be requested
+	void skipNextSample(const PairType master, const Bit32u amp, const Bit16u pitch, const Bit32u cutoff);
+
 	// Perform mixing / ring modulation and return the result
 	Bit16s nextOutSample();
 
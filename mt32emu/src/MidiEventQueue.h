@@ -60,6 +60,7 @@ public:
 	const MidiEvent *peekMidiEvent();
 	void dropMidiEvent();
 	bool isFull() const;
+	Bit32u getLength() const;
 };
 
 }
@@ -63,9 +63,7 @@ Part::Part(Synth *useSynth, unsigned int usePartNum) {
 }
 
 Part::~Part() {
-	while (!activePolys.isEmpty()) {
-		delete activePolys.takeFirst();
-	}
+	// The active polys are owned by PartialManager
 }
 
 void Part::setDataEntryMSB(unsigned char midiDataEntryMSB) {
@@ -588,6 +586,10 @@ Synth *Part::getSynth() const {
 	return synth;
 }
 
+unsigned int Part::getPartNum() const {
+	return partNum;
+}
+
 void Part::partialDeactivated(Poly *poly) {
 	activePartialCount--;
 	if (!poly->isActive()) {
@@ -112,6 +112,7 @@ public:
 	unsigned int getActivePartialCount() const;
 	unsigned int getActiveNonReleasingPartialCount() const;
 	Synth *getSynth() const;
+	unsigned int getPartNum() const;
 
 	const MemParams::PatchTemp *getPatchTemp() const;
 
@@ -18,6 +18,7 @@
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
+#include <new>
 
 #include "mt32emu.h"
 #include "mmath.h"
@@ -30,22 +31,41 @@ static const Bit8u PAN_NUMERATOR_SLAVE[]  = {0, 1, 2, 3, 4, 5, 6, 7, 7, 7, 7, 7,
 
 static const Bit32s PAN_FACTORS[] = {0, 18, 37, 55, 73, 91, 110, 128, 146, 165, 183, 201, 219, 238, 256};
 
-Partial::Partial(Synth *useSynth, int useDebugPartialNum) :
-	synth(useSynth), debugPartialNum(useDebugPartialNum), sampleNum(0) {
+// The log-space samples produced by the wave generator are never less than (amp >> 10) - 3072 (due to the resonance wave
+// amp adjustment), and unlog() yields 0 for the log values of 13 << 12 and above, as the exponent table has 13 bits.
+// Thus, a partial pair is silent (ring modulation included) while the amp of the master partial is not below this value.
+static const Bit32u INAUDIBLE_AMP_VALUE = (14 << 12) << 10;
+// A releasing partial is terminated once it remains inaudible for this number of samples in a row
+static const Bit32u EARLY_RELEASE_TERMINATION_SAMPLES = 256;
+
+static size_t alignEnvelopeSize(size_t size) {
+	return (size + Partial::ENVELOPE_STORAGE_ALIGNMENT - 1) & ~(Partial::ENVELOPE_STORAGE_ALIGNMENT - 1);
+}
+
+size_t Partial::getEnvelopeStorageSize() {
+	return alignEnvelopeSize(sizeof(TVA)) + alignEnvelopeSize(sizeof(TVP)) + alignEnvelopeSize(sizeof(TVF));
+}
+
+Partial::Partial(Synth *useSynth, int useDebugPartialNum, void *envelopeStorage, PatchCache *useCachebackup) :
+	sampleNum(0), synth(useSynth), debugPartialNum(useDebugPartialNum), cachebackup(useCachebackup) {
 	// Initialisation of tva, tvp and tvf uses 'this' pointer
 	// and thus should not be in the initializer list to avoid a compiler warning
-	tva = new TVA(this, &ampRamp);
-	tvp = new TVP(this);
-	tvf = new TVF(this, &cutoffModifierRamp);
+	Bit8u *envelopeAddress = (Bit8u *)envelopeStorage;
+	tva = new (envelopeAddress) TVA(this, &ampRamp);
+	envelopeAddress += alignEnvelopeSize(sizeof(TVA));
+	tvp = new (envelopeAddress) TVP(this);
+	envelopeAddress += alignEnvelopeSize(sizeof(TVP));
+	tvf = new (envelopeAddress) TVF(this, &cutoffModifierRamp);
 	ownerPart = -1;
 	poly = NULL;
 	pair = NULL;
 }
 
 Partial::~Partial() {
-	delete tva;
-	delete tvp;
-	delete tvf;
+	// The storage is owned by PartialManager
+	tva->~TVA();
+	tvp->~TVP();
+	tvf->~TVF();
 }
 
 // Only used for debugging purposes
@@ -179,6 +199,7 @@ void Partial::startPartial(const Part *part, Poly *usePoly, const PatchCache *us
 
 	pair = pairPartial;
 	alreadyOutputed = false;
+	inaudibleReleaseSampleCount = 0;
 	tva->reset(part, patchCache->partialParam, rhythmTemp);
 	tvp->reset(part, patchCache->partialParam);
 	tvf->reset(patchCache->partialParam, tvp->getBasePitch());
@@ -261,8 +282,8 @@ TVA *Partial::getTVA() const {
 
 void Partial::backupCache(const PatchCache &cache) {
 	if (patchCache == &cache) {
-		cachebackup = cache;
-		patchCache = &cachebackup;
+		*cachebackup = cache;
+		patchCache = cachebackup;
 	}
 }
 
@@ -275,15 +296,35 @@ bool Partial::produceOutput(Sample *leftBuf, Sample *rightBuf, unsigned long len
 		return false;
 	}
 	alreadyOutputed = true;
+	const bool cullingEnabled = synth->isInaudiblePartialCullingEnabled();
 
 	for (sampleNum = 0; sampleNum < length; sampleNum++) {
 		if (!tva->isPlaying() || !la32Pair.isActive(LA32PartialPair::MASTER)) {
 			deactivate();
 			break;
 		}
-		la32Pair.generateNextSample(LA32PartialPair::MASTER, getAmpValue(), tvp->nextPitch(), getCutoffValue());
+		bool inaudible = false;
+		if (cullingEnabled) {
+			Bit32u ampValue = getAmpValue();
+			Bit16u pitch = tvp->nextPitch();
+			Bit32u cutoffValue = getCutoffValue();
+			inaudible = ampValue >= INAUDIBLE_AMP_VALUE;
+			if (inaudible) {
+				la32Pair.skipNextSample(LA32PartialPair::MASTER, ampValue, pitch, cutoffValue);
+			} else {
+				la32Pair.generateNextSample(LA32PartialPair::MASTER, ampValue, pitch, cutoffValue);
+			}
+		} else {
+			la32Pair.generateNextSample(LA32PartialPair::MASTER, getAmpValue(), tvp->nextPitch(), getCutoffValue());
+		}
 		if (hasRingModulatingSlave()) {
-			la32Pair.generateNextSample(LA32PartialPair::SLAVE, pair->getAmpValue(), pair->tvp->nextPitch(), pair->getCutoffValue());
+			if (inaudible) {
+				Bit32u slaveAmpValue = pair->getAmpValue();
+				Bit16u slavePitch = pair->tvp->nextPitch();
+				la32Pair.skipNextSample(LA32PartialPair::SLAVE, slaveAmpValue, slavePitch, pair->getCutoffValue());
+			} else {
+				la32Pair.generateNextSample(LA32PartialPair::SLAVE, pair->getAmpValue(), pair->tvp->nextPitch(), pair->getCutoffValue());
+			}
 			if (!pair->tva->isPlaying() || !la32Pair.isActive(LA32PartialPair::SLAVE)) {
 				pair->deactivate();
 				if (mixType == 2) {
@@ -293,6 +334,18 @@ bool Partial::produceOutput(Sample *leftBuf, Sample *rightBuf, unsigned long len
 			}
 		}
 
+		if (inaudible) {
+			// The pair contributes nothing to the output this time
+			if (tva->getPhase() == TVA_PHASE_RELEASE && ++inaudibleReleaseSampleCount >= EARLY_RELEASE_TERMINATION_SAMPLES) {
+				deactivate();
+				break;
+			}
+			leftBuf++;
+			rightBuf++;
+			continue;
+		}
+		inaudibleReleaseSampleCount = 0;
+
 		// Although, LA32 applies panning itself, we assume here it is applied in the mixer, not within a pair.
 		// Applying the pan value in the log-space looks like a waste of unlog resources. Though, it needs clarification.
 		Sample sample = la32Pair.nextOutSample();
@@ -28,11 +28,17 @@ struct ControlROMPCMStruct;
 // A partial represents one of up to four waveform generators currently playing within a poly.
 class Partial {
 private:
-	Synth *synth;
-	const int debugPartialNum; // Only used for debugging
-	// Number of the sample currently being rendered by produceOutput(), or 0 if no run is in progress
-	// This is only kept available for debugging purposes.
-	unsigned long sampleNum;
+	// The per-sample state goes first, so that it occupies the leading cache lines of the block the partial is placed into
+	// by PartialManager. The envelope generators follow the partial in the same block, see Partial().
+	LA32Ramp ampRamp;
+	LA32Ramp cutoffModifierRamp;
+
+	// TODO: This should be owned by PartialPair
+	LA32PartialPair la32Pair;
+
+	TVA *tva;
+	TVP *tvp;
+	TVF *tvf;
 
 	// Actually, this is a 4-bit register but we abuse this to emulate inverted mixing.
 	// Also we double the value to enable INACCURATE_SMOOTH_PAN, with respect to MoK.
@@ -42,30 +48,34 @@ private:
 	int mixType;
 	int structurePosition; // 0 or 1 of a structure pair
 
-	// Only used for PCM partials
-	int pcmNum;
+	Poly *poly;
+	Partial *pair;
+
+	// Number of the consecutive samples rendered as inaudible during the release, see Synth::setInaudiblePartialCullingEnabled()
+	Bit32u inaudibleReleaseSampleCount;
+
 	// FIXME: Give this a better name (e.g. pcmWaveInfo)
 	PCMWaveEntry *pcmWave;
 
-	// Final pulse width value, with velfollow applied, matching what is sent to the LA32.
-	// Range: 0-255
-	int pulseWidthVal;
+	// Number of the sample currently being rendered by produceOutput(), or 0 if no run is in progress
+	// This is only kept available for debugging purposes.
+	unsigned long sampleNum;
 
-	Poly *poly;
-	Partial *pair;
+	// The state below is only accessed when the partial starts
 
-	TVA *tva;
-	TVP *tvp;
-	TVF *tvf;
+	Synth *synth;
+	const int debugPartialNum; // Only used for debugging
 
-	LA32Ramp ampRamp;
-	LA32Ramp cutoffModifierRamp;
+	// Only used for PCM partials
+	int pcmNum;
 
-	// TODO: This should be owned by PartialPair
-	LA32PartialPair la32Pair;
+	// Final pulse width value, with velfollow applied, matching what is sent to the LA32.
+	// Range: 0-255
+	int pulseWidthVal;
 
 	const PatchCache *patchCache;
-	PatchCache cachebackup;
+	// Kept apart from the partials by PartialManager, as it is only written when the cache of the part changes
+	PatchCache *cachebackup;
 
 	Bit32u getAmpValue();
 	Bit32u getCutoffValue();
@@ -73,7 +83,11 @@ private:
 public:
 	bool alreadyOutputed;
 
-	Partial(Synth *synth, int debugPartialNum);
+	// The storage for the envelope generators provided to the constructor must be aligned to this boundary
+	static const size_t ENVELOPE_STORAGE_ALIGNMENT = 16;
+	static size_t getEnvelopeStorageSize();
+
+	Partial(Synth *synth, int debugPartialNum, void *envelopeStorage, PatchCache *cachebackup);
 	~Partial();
 
 	int debugGetPartialNum() const;
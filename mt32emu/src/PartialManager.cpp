@@ -16,6 +16,7 @@
  */
 
 #include <cstring>
+#include <new>
 
 #include "mt32emu.h"
 #include "internals.h"
@@ -23,23 +24,49 @@
 
 namespace MT32Emu {
 
+static const size_t CACHE_LINE_SIZE = 64;
+
+static size_t alignToCacheLine(size_t size) {
+	return (size + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1);
+}
+
+static size_t getPartialSlotSize() {
+	size_t partialSize = (sizeof(Partial) + Partial::ENVELOPE_STORAGE_ALIGNMENT - 1) & ~(Partial::ENVELOPE_STORAGE_ALIGNMENT - 1);
+	return alignToCacheLine(partialSize + Partial::getEnvelopeStorageSize());
+}
+
 PartialManager::PartialManager(Synth *useSynth, Part **useParts) {
 	synth = useSynth;
 	parts = useParts;
-	partialTable = new Partial *[synth->getPartialCount()];
-	freePolys = new Poly *[synth->getPartialCount()];
+	const unsigned int partialCount = synth->getPartialCount();
+	const size_t partialSlotSize = getPartialSlotSize();
+	const size_t envelopeStorageOffset = partialSlotSize - Partial::getEnvelopeStorageSize();
+	const size_t polysOffset = partialCount * partialSlotSize;
+	const size_t cachebackupsOffset = polysOffset + alignToCacheLine(partialCount * sizeof(Poly));
+	const size_t arenaSize = cachebackupsOffset + partialCount * sizeof(PatchCache);
+
+	arenaMemory = new Bit8u[arenaSize + CACHE_LINE_SIZE - 1];
+	Bit8u *arena = arenaMemory + ((CACHE_LINE_SIZE - (size_t)arenaMemory % CACHE_LINE_SIZE) % CACHE_LINE_SIZE);
+	polys = (Poly *)(arena + polysOffset);
+	PatchCache *cachebackups = (PatchCache *)(arena + cachebackupsOffset);
+
+	partialTable = new Partial *[partialCount];
+	freePolys = new Poly *[partialCount];
 	firstFreePolyIndex = 0;
-	for (unsigned int i = 0; i < synth->getPartialCount(); i++) {
-		partialTable[i] = new Partial(synth, i);
-		freePolys[i] = new Poly();
+	for (unsigned int i = 0; i < partialCount; i++) {
+		Bit8u *partialSlot = arena + i * partialSlotSize;
+		partialTable[i] = new (partialSlot) Partial(synth, i, partialSlot + envelopeStorageOffset, new (&cachebackups[i]) PatchCache());
+		freePolys[i] = new (&polys[i]) Poly();
 	}
 }
 
 PartialManager::~PartialManager(void) {
+	// The polys held by the parts are not deleted by them, as they reside in the arena as well
 	for (unsigned int i = 0; i < synth->getPartialCount(); i++) {
-		delete partialTable[i];
-		if (freePolys[i] != NULL) delete freePolys[i];
+		partialTable[i]->~Partial();
+		polys[i].~Poly();
 	}
+	delete[] arenaMemory;
 	delete[] partialTable;
 	delete[] freePolys;
 }
@@ -85,6 +112,7 @@ Partial *PartialManager::allocPartial(int partNum) {
 	}
 	if (outPartial != NULL) {
 		outPartial->activate(partNum);
+		synth->partialActivated();
 	}
 	return outPartial;
 }
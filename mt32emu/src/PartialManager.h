@@ -26,6 +26,10 @@ class PartialManager {
 private:
 	Synth *synth;
 	Part **parts;
+	// All the partials along with their envelope generators, the polys and the backups of the partial caches are placed
+	// into a single cache line aligned arena. Each partial starts a new cache line, the rarely accessed backups go last.
+	Bit8u *arenaMemory;
+	Poly *polys;
 	Poly **freePolys;
 	Partial **partialTable;
 	Bit8u numReservedPartialsForPart[9];
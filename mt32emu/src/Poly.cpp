@@ -114,6 +114,9 @@ bool Poly::startAbort() {
 			part->getSynth()->abortingPoly = this;
 		}
 	}
+	if (part->getSynth()->abortingPoly == this) {
+		part->getSynth()->polyAbortStarted(part->getPartNum());
+	}
 	return true;
 }
 
@@ -16,7 +16,8 @@
  */
 
 #include <cstring>
-#include "ROMInfo.h"
+#include "mt32emu.h"
+#include "internals.h"
 
 namespace MT32Emu {
 
@@ -37,6 +38,12 @@ static const ROMInfo *getKnownROMInfoFromList(unsigned int index) {
 	static const ROMInfo PCM_MT32 = {524288, "f6b1eebc4b2d200ec6d3d21d51325d5b48c60252", ROMInfo::PCM, "pcm_mt32", "MT-32 PCM ROM", ROMInfo::Full, NULL, NULL};
 	static const ROMInfo PCM_CM32L = {1048576, "289cc298ad532b702461bfc738009d9ebe8025ea", ROMInfo::PCM, "pcm_cm32l", "CM-32L/CM-64/LAPC-I PCM ROM", ROMInfo::Full, NULL, NULL};
 
+#if MT32EMU_ACCEPT_TEST_ROMS
+	// Synthetic images produced by TestROMGenerator in mt32emu_bench
+	static const ROMInfo CTRL_TEST = {65536, "4056a689e5ee3f624b32f538ca4cd11948a2d0e9", ROMInfo::Control, "ctrl_test", "Synthetic Test Control ROM", ROMInfo::Full, NULL, &MT32_COMPATIBLE};
+	static const ROMInfo PCM_TEST = {524288, "da3dfc2a2a36423cf22167d3cb1984ceb8f15779", ROMInfo::PCM, "pcm_test", "Synthetic Test PCM ROM", ROMInfo::Full, NULL, NULL};
+#endif
+
 	static const ROMInfo * const ROM_INFOS[] = {
 		&CTRL_MT32_V1_04,
 		&CTRL_MT32_V1_05,
@@ -47,6 +54,10 @@ static const ROMInfo *getKnownROMInfoFromList(unsigned int index) {
 		&CTRL_CM32L_V1_02,
 		&PCM_MT32,
 		&PCM_CM32L,
+#if MT32EMU_ACCEPT_TEST_ROMS
+		&CTRL_TEST,
+		&PCM_TEST,
+#endif
 		NULL};
 
 	return ROM_INFOS[index];
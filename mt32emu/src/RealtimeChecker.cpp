@@ -0,0 +1,402 @@
+/* Copyright (C) 2011, 2012, 2013, 2014 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "mt32emu.h"
+#include "internals.h"
+
+#if MT32EMU_REALTIME_CHECKS
+
+#ifdef _WIN32
+#include <windows.h>
+#define MT32EMU_THREAD_LOCAL __declspec(thread)
+#else
+#define MT32EMU_THREAD_LOCAL __thread
+#endif
+
+#if defined(__GLIBC__) || defined(__APPLE__)
+#include <execinfo.h>
+#define MT32EMU_HAVE_BACKTRACE 1
+#endif
+
+// With glibc, the C allocation functions, pthread locks and common blocking calls are interposed as well
+#ifdef __GLIBC__
+#include <dlfcn.h>
+#include <malloc.h>
+#include <poll.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include <unistd.h>
+#define MT32EMU_INTERPOSE_LIBC 1
+#undef MT32EMU_THREAD_LOCAL
+// The initial-exec model never allocates on access, the variables are read from within malloc()
+#define MT32EMU_THREAD_LOCAL __thread __attribute__((tls_model("initial-exec")))
+#endif
+
+#endif
+
+namespace MT32Emu {
+
+#if MT32EMU_REALTIME_CHECKS
+
+static const char * const VIOLATION_DESCRIPTIONS[] = {"heap allocation", "heap deallocation", "lock acquisition", "blocking call"};
+
+static const int MAX_STACK_DEPTH = 32;
+
+static MT32EMU_THREAD_LOCAL unsigned int sectionDepth = 0;
+static MT32EMU_THREAD_LOCAL const char *sectionName = NULL;
+// Set while a violation is being reported, printing a stack trace may well allocate memory itself
+static MT32EMU_THREAD_LOCAL bool reporting = false;
+
+// Shared by all the threads, races may only make the counts slightly inaccurate
+static volatile Bit32u violationCount = 0;
+static volatile Bit32u maxReportedViolations = 16;
+
+static void printStackTrace() {
+#if MT32EMU_HAVE_BACKTRACE
+	void *frames[MAX_STACK_DEPTH];
+	int frameCount = backtrace(frames, MAX_STACK_DEPTH);
+	backtrace_symbols_fd(frames, frameCount, 2);
+#elif defined(_WIN32)
+	void *frames[MAX_STACK_DEPTH];
+	USHORT frameCount = CaptureStackBackTrace(0, MAX_STACK_DEPTH, frames, NULL);
+	for (USHORT i = 0; i < frameCount; i++) {
+		fprintf(stderr, "  %p\n", frames[i]);
+	}
+#endif
+}
+
+bool RealtimeChecker::isAvailable() {
+	return true;
+}
+
+void RealtimeChecker::enterSection(const char *name) {
+	if (sectionDepth++ == 0) sectionName = name;
+}
+
+void RealtimeChecker::leaveSection() {
+	if (sectionDepth > 0 && --sectionDepth == 0) sectionName = NULL;
+}
+
+bool RealtimeChecker::isInSection() {
+	return sectionDepth > 0;
+}
+
+void RealtimeChecker::checkLock(const char *lockName) {
+	if (sectionDepth > 0) reportViolation(RealtimeViolationType_LOCK, lockName);
+}
+
+void RealtimeChecker::checkBlockingCall(const char *callName) {
+	if (sectionDepth > 0) reportViolation(RealtimeViolationType_BLOCKING_CALL, callName);
+}
+
+Bit32u RealtimeChecker::getViolationCount() {
+	return violationCount;
+}
+
+void RealtimeChecker::resetViolationCount() {
+	violationCount = 0;
+}
+
+void RealtimeChecker::setMaxReportedViolations(Bit32u count) {
+	maxReportedViolations = count;
+}
+
+void RealtimeChecker::reportViolation(RealtimeViolationType type, const char *what) {
+	if (reporting) return;
+	reporting = true;
+	if (violationCount++ < maxReportedViolations) {
+		fprintf(stderr, "mt32emu: realtime violation: %s (%s) in %s\n", VIOLATION_DESCRIPTIONS[type], what, sectionName == NULL ? "unnamed section" : sectionName);
+		printStackTrace();
+		if (violationCount == maxReportedViolations) {
+			fprintf(stderr, "mt32emu: further realtime violations are counted but not reported\n");
+		}
+	}
+	reporting = false;
+}
+
+#if MT32EMU_INTERPOSE_LIBC
+
+// Returns the next definition of the interposed function, resolved on the first use.
+// Violations are not reported while resolving, dlsym() may allocate memory itself.
+template <class Function>
+static Function nextFunction(Function &function, const char *name) {
+	if (function == NULL) {
+		bool wasReporting = reporting;
+		reporting = true;
+		void *symbol = dlsym(RTLD_NEXT, name);
+		reporting = wasReporting;
+		if (symbol == NULL) {
+			fprintf(stderr, "mt32emu: realtime checker failed to resolve %s\n", name);
+			abort();
+		}
+		memcpy(&function, &symbol, sizeof(symbol));
+	}
+	return function;
+}
+
+static void checkCall(RealtimeViolationType type, const char *name) {
+	if (sectionDepth > 0) RealtimeChecker::reportViolation(type, name);
+}
+
+#endif
+
+#else
+
+bool RealtimeChecker::isAvailable() {
+	return false;
+}
+
+void RealtimeChecker::enterSection(const char * /* name */) {}
+
+void RealtimeChecker::leaveSection() {}
+
+bool RealtimeChecker::isInSection() {
+	return false;
+}
+
+void RealtimeChecker::checkLock(const char * /* lockName */) {}
+
+void RealtimeChecker::checkBlockingCall(const char * /* callName */) {}
+
+Bit32u RealtimeChecker::getViolationCount() {
+	return 0;
+}
+
+void RealtimeChecker::resetViolationCount() {}
+
+void RealtimeChecker::setMaxReportedViolations(Bit32u /* count */) {}
+
+void RealtimeChecker::reportViolation(RealtimeViolationType /* type */, const char * /* what */) {}
+
+#endif
+
+}
+
+#if MT32EMU_REALTIME_CHECKS
+
+// Replacements of the global allocation functions, they take effect program-wide as soon as this file is linked in.
+
+#if MT32EMU_INTERPOSE_LIBC
+
+// The glibc allocator entry points, these are not affected by the interposed malloc() and free() below
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void __libc_free(void *ptr);
+
+#define MT32EMU_RAW_MALLOC __libc_malloc
+#define MT32EMU_RAW_FREE __libc_free
+
+#else
+
+#define MT32EMU_RAW_MALLOC malloc
+#define MT32EMU_RAW_FREE free
+
+#endif
+
+static void *checkedAlloc(size_t size) {
+	if (MT32Emu::sectionDepth > 0) MT32Emu::RealtimeChecker::reportViolation(MT32Emu::RealtimeViolationType_ALLOCATION, "operator new");
+	return MT32EMU_RAW_MALLOC(size == 0 ? 1 : size);
+}
+
+static void checkedFree(void *ptr) {
+	if (ptr == NULL) return;
+	if (MT32Emu::sectionDepth > 0) MT32Emu::RealtimeChecker::reportViolation(MT32Emu::RealtimeViolationType_DEALLOCATION, "operator delete");
+	MT32EMU_RAW_FREE(ptr);
+}
+
+void *operator new(size_t size) throw(std::bad_alloc) {
+	void *ptr = checkedAlloc(size);
+	if (ptr == NULL) throw std::bad_alloc();
+	return ptr;
+}
+
+void *operator new[](size_t size) throw(std::bad_alloc) {
+	void *ptr = checkedAlloc(size);
+	if (ptr == NULL) throw std::bad_alloc();
+	return ptr;
+}
+
+void *operator new(size_t size, const std::nothrow_t &) throw() {
+	return checkedAlloc(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) throw() {
+	return checkedAlloc(size);
+}
+
+void operator delete(void *ptr) throw() {
+	checkedFree(ptr);
+}
+
+void operator delete[](void *ptr) throw() {
+	checkedFree(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) throw() {
+	checkedFree(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) throw() {
+	checkedFree(ptr);
+}
+
+#if MT32EMU_INTERPOSE_LIBC
+
+// Interposed C library functions, the definitions in the program take precedence over those in the shared libc.
+// Only the calls made through the dynamic symbol table are seen, this excludes the calls within libc itself,
+// static linking and the primitives that invoke the system directly. Notably, QMutex and QWaitCondition of Qt 5
+// on Linux use futexes without going through pthread, so those can only be reported manually via checkLock().
+
+using MT32Emu::checkCall;
+using MT32Emu::nextFunction;
+using MT32Emu::RealtimeViolationType_ALLOCATION;
+using MT32Emu::RealtimeViolationType_DEALLOCATION;
+using MT32Emu::RealtimeViolationType_LOCK;
+using MT32Emu::RealtimeViolationType_BLOCKING_CALL;
+
+extern "C" {
+
+void *malloc(size_t size) __THROW {
+	checkCall(RealtimeViolationType_ALLOCATION, "malloc");
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) __THROW {
+	checkCall(RealtimeViolationType_ALLOCATION, "calloc");
+	return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) __THROW {
+	checkCall(RealtimeViolationType_ALLOCATION, "realloc");
+	return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) __THROW {
+	if (ptr == NULL) return;
+	checkCall(RealtimeViolationType_DEALLOCATION, "free");
+	__libc_free(ptr);
+}
+
+static int (*nextPosixMemalign)(void **, size_t, size_t) = NULL;
+
+int posix_memalign(void **ptr, size_t alignment, size_t size) __THROW {
+	checkCall(RealtimeViolationType_ALLOCATION, "posix_memalign");
+	return nextFunction(nextPosixMemalign, "posix_memalign")(ptr, alignment, size);
+}
+
+static void *(*nextMemalign)(size_t, size_t) = NULL;
+
+void *memalign(size_t alignment, size_t size) __THROW {
+	checkCall(RealtimeViolationType_ALLOCATION, "memalign");
+	return nextFunction(nextMemalign, "memalign")(alignment, size);
+}
+
+static int (*nextPthreadMutexLock)(pthread_mutex_t *) = NULL;
+
+int pthread_mutex_lock(pthread_mutex_t *mutex) __THROWNL {
+	checkCall(RealtimeViolationType_LOCK, "pthread_mutex_lock");
+	return nextFunction(nextPthreadMutexLock, "pthread_mutex_lock")(mutex);
+}
+
+static int (*nextPthreadRwlockRdlock)(pthread_rwlock_t *) = NULL;
+
+int pthread_rwlock_rdlock(pthread_rwlock_t *rwlock) __THROWNL {
+	checkCall(RealtimeViolationType_LOCK, "pthread_rwlock_rdlock");
+	return nextFunction(nextPthreadRwlockRdlock, "pthread_rwlock_rdlock")(rwlock);
+}
+
+static int (*nextPthreadRwlockWrlock)(pthread_rwlock_t *) = NULL;
+
+int pthread_rwlock_wrlock(pthread_rwlock_t *rwlock) __THROWNL {
+	checkCall(RealtimeViolationType_LOCK, "pthread_rwlock_wrlock");
+	return nextFunction(nextPthreadRwlockWrlock, "pthread_rwlock_wrlock")(rwlock);
+}
+
+static int (*nextPthreadCondWait)(pthread_cond_t *, pthread_mutex_t *) = NULL;
+
+int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex) {
+	checkCall(RealtimeViolationType_LOCK, "pthread_cond_wait");
+	return nextFunction(nextPthreadCondWait, "pthread_cond_wait")(cond, mutex);
+}
+
+static int (*nextPthreadCondTimedwait)(pthread_cond_t *, pthread_mutex_t *, const struct timespec *) = NULL;
+
+int pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *abstime) {
+	checkCall(RealtimeViolationType_LOCK, "pthread_cond_timedwait");
+	return nextFunction(nextPthreadCondTimedwait, "pthread_cond_timedwait")(cond, mutex, abstime);
+}
+
+static int (*nextSemWait)(sem_t *) = NULL;
+
+int sem_wait(sem_t *sem) {
+	checkCall(RealtimeViolationType_LOCK, "sem_wait");
+	return nextFunction(nextSemWait, "sem_wait")(sem);
+}
+
+static int (*nextNanosleep)(const struct timespec *, struct timespec *) = NULL;
+
+int nanosleep(const struct timespec *requested, struct timespec *remaining) {
+	checkCall(RealtimeViolationType_BLOCKING_CALL, "nanosleep");
+	return nextFunction(nextNanosleep, "nanosleep")(requested, remaining);
+}
+
+static int (*nextClockNanosleep)(clockid_t, int, const struct timespec *, struct timespec *) = NULL;
+
+int clock_nanosleep(clockid_t clockId, int flags, const struct timespec *requested, struct timespec *remaining) {
+	checkCall(RealtimeViolationType_BLOCKING_CALL, "clock_nanosleep");
+	return nextFunction(nextClockNanosleep, "clock_nanosleep")(clockId, flags, requested, remaining);
+}
+
+static int (*nextUsleep)(useconds_t) = NULL;
+
+int usleep(useconds_t useconds) {
+	checkCall(RealtimeViolationType_BLOCKING_CALL, "usleep");
+	return nextFunction(nextUsleep, "usleep")(useconds);
+}
+
+static ssize_t (*nextRead)(int, void *, size_t) = NULL;
+
+ssize_t read(int fd, void *buffer, size_t count) {
+	checkCall(RealtimeViolationType_BLOCKING_CALL, "read");
+	return nextFunction(nextRead, "read")(fd, buffer, count);
+}
+
+static ssize_t (*nextWrite)(int, const void *, size_t) = NULL;
+
+ssize_t write(int fd, const void *buffer, size_t count) {
+	checkCall(RealtimeViolationType_BLOCKING_CALL, "write");
+	return nextFunction(nextWrite, "write")(fd, buffer, count);
+}
+
+static int (*nextPoll)(struct pollfd *, nfds_t, int) = NULL;
+
+int poll(struct pollfd *fds, nfds_t fdCount, int timeout) {
+	checkCall(RealtimeViolationType_BLOCKING_CALL, "poll");
+	return nextFunction(nextPoll, "poll")(fds, fdCount, timeout);
+}
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,79 @@
+/* Copyright (C) 2011, 2012, 2013, 2014 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MT32EMU_REALTIME_CHECKER_H
+#define MT32EMU_REALTIME_CHECKER_H
+
+#include "mt32emu.h"
+
+namespace MT32Emu {
+
+enum RealtimeViolationType {
+	RealtimeViolationType_ALLOCATION,
+	RealtimeViolationType_DEALLOCATION,
+	RealtimeViolationType_LOCK,
+	RealtimeViolationType_BLOCKING_CALL
+};
+
+// Debugging aid which verifies that the code running in a realtime section, e.g. rendering in an audio callback,
+// never uses the heap, takes a lock or makes a potentially blocking call, any of which may stall the thread for unbounded time.
+// Synth::render() and Synth::renderStreams() are realtime sections, the application marks its own audio callbacks likewise.
+// Heap usage is detected by replacing the global operator new and delete. With glibc, malloc() and friends, pthread mutex,
+// rwlock and condition waits, sem_wait() and the common blocking calls (sleeps, read(), write(), poll()) are interposed
+// as well. Locks that bypass these, e.g. the futex-based QMutex, and blocking calls elsewhere can be reported by the code
+// that performs them via checkLock() and checkBlockingCall(). Each violation is printed to stderr along with
+// a stack trace where the platform provides one (with glibc, link the application with -rdynamic to see the function names).
+// The checks are only compiled in when libmt32emu is built with MT32EMU_REALTIME_CHECKS enabled
+// (CMake option libmt32emu_WITH_REALTIME_CHECKS), otherwise all the methods do nothing. Never enable this in release builds.
+class RealtimeChecker {
+public:
+	// Marks a realtime section in the current thread for its lifetime. Sections may nest.
+	class Section {
+	public:
+		Section(const char *name) {
+			enterSection(name);
+		}
+
+		~Section() {
+			leaveSection();
+		}
+	};
+
+	// Returns true if the checks are compiled in
+	static bool isAvailable();
+
+	// The name must be a string literal or otherwise outlive the section
+	static void enterSection(const char *name);
+	static void leaveSection();
+	static bool isInSection();
+
+	// Report a violation if invoked within a realtime section of the current thread
+	static void checkLock(const char *lockName);
+	static void checkBlockingCall(const char *callName);
+
+	// Returns the number of violations detected in all the threads since the start or the last reset
+	static Bit32u getViolationCount();
+	static void resetViolationCount();
+
+	// Only the first so many violations are printed (default 16), the rest are counted silently
+	static void setMaxReportedViolations(Bit32u count);
+
+	static void reportViolation(RealtimeViolationType type, const char *what);
+};
+
+}
+
+#endif
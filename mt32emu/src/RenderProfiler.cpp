@@ -0,0 +1,148 @@
+/* Copyright (C) 2011, 2012, 2013, 2014 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+#include "RenderProfiler.h"
+
+namespace MT32Emu {
+
+double RenderProfiler::getNanos() {
+#ifdef _WIN32
+	static double nanosPerTick = 0.0;
+	if (nanosPerTick == 0.0) {
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		nanosPerTick = 1e9 / double(frequency.QuadPart);
+	}
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return double(counter.QuadPart) * nanosPerTick;
+#elif defined(__APPLE__)
+	static double nanosPerTick = 0.0;
+	if (nanosPerTick == 0.0) {
+		mach_timebase_info_data_t timebase;
+		mach_timebase_info(&timebase);
+		nanosPerTick = double(timebase.numer) / double(timebase.denom);
+	}
+	return double(mach_absolute_time()) * nanosPerTick;
+#else
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return double(ts.tv_sec) * 1e9 + double(ts.tv_nsec);
+#endif
+}
+
+RenderProfiler::RenderProfiler() : enabled(false), reportInterval(0), renderDepth(0), renderStartNanos(0.0),
+	renderNanosSum(0.0), externalStageActive(false), externalStageStartNanos(0.0), externalStageStartRenderNanos(0.0)
+{
+	reset();
+}
+
+void RenderProfiler::setEnabled(bool newEnabled) {
+	if (enabled == newEnabled) return;
+	enabled = newEnabled;
+	renderDepth = 0;
+	externalStageActive = false;
+	resetInterval();
+}
+
+void RenderProfiler::setReportInterval(Bit32u samples) {
+	reportInterval = samples;
+	resetInterval();
+}
+
+Bit32u RenderProfiler::getReportInterval() const {
+	return reportInterval;
+}
+
+void RenderProfiler::getProfile(RenderProfile &profile) const {
+	profile = totalProfile;
+}
+
+void RenderProfiler::reset() {
+	clearProfile(totalProfile);
+	resetInterval();
+}
+
+double RenderProfiler::accountStage(RenderStage stage, double sinceNanos) {
+	double nowNanos = getNanos();
+	double nanos = nowNanos - sinceNanos;
+	totalProfile.stageNanos[stage] += nanos;
+	totalProfile.stageCalls[stage]++;
+	intervalProfile.stageNanos[stage] += nanos;
+	intervalProfile.stageCalls[stage]++;
+	return nowNanos;
+}
+
+void RenderProfiler::accountSlice(Bit32u length) {
+	totalProfile.renderSliceCount++;
+	totalProfile.renderedSampleCount += length;
+	intervalProfile.renderSliceCount++;
+	intervalProfile.renderedSampleCount += length;
+}
+
+void RenderProfiler::startRender() {
+	if (renderDepth++ == 0) {
+		renderStartNanos = getNanos();
+	}
+}
+
+bool RenderProfiler::endRender() {
+	if (renderDepth == 0 || --renderDepth > 0) return false;
+	double nanos = getNanos() - renderStartNanos;
+	renderNanosSum += nanos;
+	totalProfile.renderNanos += nanos;
+	totalProfile.renderCalls++;
+	intervalProfile.renderNanos += nanos;
+	intervalProfile.renderCalls++;
+	return reportInterval > 0 && intervalProfile.renderedSampleCount >= reportInterval;
+}
+
+const RenderProfile &RenderProfiler::getIntervalProfile() const {
+	return intervalProfile;
+}
+
+void RenderProfiler::resetInterval() {
+	clearProfile(intervalProfile);
+}
+
+void RenderProfiler::startExternalStage() {
+	externalStageActive = true;
+	externalStageStartRenderNanos = renderNanosSum;
+	externalStageStartNanos = getNanos();
+}
+
+void RenderProfiler::endExternalStage(RenderStage stage) {
+	if (!externalStageActive) return;
+	externalStageActive = false;
+	double nestedRenderNanos = renderNanosSum - externalStageStartRenderNanos;
+	accountStage(stage, externalStageStartNanos + nestedRenderNanos);
+}
+
+void RenderProfiler::clearProfile(RenderProfile &profile) {
+	memset(&profile, 0, sizeof(RenderProfile));
+}
+
+}
@@ -0,0 +1,82 @@
+/* Copyright (C) 2011, 2012, 2013, 2014 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MT32EMU_RENDER_PROFILER_H
+#define MT32EMU_RENDER_PROFILER_H
+
+#include "mt32emu.h"
+
+namespace MT32Emu {
+
+/* Accumulates the time spent in the stages of the rendering pipeline, see RenderProfile.
+ * When disabled, the only cost to the rendering thread is a check of the flag per render slice.
+ * All the methods except the getters are meant to be called from the rendering thread only.
+ */
+class RenderProfiler {
+public:
+	// Returns a monotonic timestamp in nanoseconds
+	static double getNanos();
+
+	RenderProfiler();
+
+	bool isEnabled() const {
+		return enabled;
+	}
+
+	void setEnabled(bool enabled);
+	void setReportInterval(Bit32u samples);
+	Bit32u getReportInterval() const;
+	void getProfile(RenderProfile &profile) const;
+	void reset();
+
+	// Adds the time passed since the timestamp to the stage, returns the current timestamp for chaining
+	double accountStage(RenderStage stage, double sinceNanos);
+
+	void accountSlice(Bit32u length);
+
+	// Calls of renderStreams() from render() nest, the total time is only accounted by the outermost pair
+	void startRender();
+
+	// Returns true if the report interval has elapsed, the interval data is available via getIntervalProfile() then
+	bool endRender();
+
+	const RenderProfile &getIntervalProfile() const;
+	void resetInterval();
+
+	// Delimit a stage the application performs around its render() calls, e.g. resampling of the output.
+	// The time of the nested render() calls is excluded, so the stage is only charged for its own processing.
+	void startExternalStage();
+	void endExternalStage(RenderStage stage);
+
+private:
+	bool enabled;
+	Bit32u reportInterval;
+	unsigned int renderDepth;
+	double renderStartNanos;
+	// Running sum of the time accounted by endRender(), unaffected by resets
+	double renderNanosSum;
+	bool externalStageActive;
+	double externalStageStartNanos;
+	double externalStageStartRenderNanos;
+	RenderProfile totalProfile;
+	RenderProfile intervalProfile;
+
+	static void clearProfile(RenderProfile &profile);
+};
+
+}
+
+#endif
@@ -35,7 +35,7 @@ namespace MT32Emu {
 // MIDI interface data transfer rate in samples. Used to simulate the transfer delay.
 static const double MIDI_DATA_TRANSFER_RATE = (double)SAMPLE_RATE / 31250.0 * 8.0;
 
-static const ControlROMMap ControlROMMaps[7] = {
+static const ControlROMMap ControlROMMaps[] = {
 	// ID    IDc IDbytes                     PCMmap  PCMc  tmbrA   tmbrAO, tmbrAC tmbrB   tmbrBO, tmbrBC tmbrR   trC  rhythm  rhyC  rsrv    panpot  prog    rhyMax  patMax  sysMax  timMax
 	{0x4014, 22, "\000 ver1.04 14 July 87 ", 0x3000,  128, 0x8000, 0x0000, false, 0xC000, 0x4000, false, 0x3200,  30, 0x73A6,  85,  0x57C7, 0x57E2, 0x57D0, 0x5252, 0x525E, 0x526E, 0x520A},
 	{0x4014, 22, "\000 ver1.05 06 Aug, 87 ", 0x3000,  128, 0x8000, 0x0000, false, 0xC000, 0x4000, false, 0x3200,  30, 0x7414,  85,  0x57C7, 0x57E2, 0x57D0, 0x5252, 0x525E, 0x526E, 0x520A},
@@ -43,7 +43,10 @@ static const ControlROMMap ControlROMMaps[7] = {
 	{0x4010, 22, "\000 ver1.07 10 Oct, 87 ", 0x3000,  128, 0x8000, 0x0000, false, 0xC000, 0x4000, false, 0x3200,  30, 0x73fe,  85,  0x57B1, 0x57CC, 0x57BA, 0x523C, 0x5248, 0x5258, 0x51F4}, // MT-32 revision 1
 	{0x4010, 22, "\000verX.XX  30 Sep, 88 ", 0x3000,  128, 0x8000, 0x0000, false, 0xC000, 0x4000, false, 0x3200,  30, 0x741C,  85,  0x57E5, 0x5800, 0x57EE, 0x5270, 0x527C, 0x528C, 0x5228}, // MT-32 Blue Ridge mod
 	{0x2205, 22, "\000CM32/LAPC1.00 890404", 0x8100,  256, 0x8000, 0x8000, false, 0x8080, 0x8000, false, 0x8500,  64, 0x8580,  85,  0x4F65, 0x4F80, 0x4F6E, 0x48A1, 0x48A5, 0x48BE, 0x48D5},
-	{0x2205, 22, "\000CM32/LAPC1.02 891205", 0x8100,  256, 0x8000, 0x8000, true,  0x8080, 0x8000, true,  0x8500,  64, 0x8580,  85,  0x4F93, 0x4FAE, 0x4F9C, 0x48CB, 0x48CF, 0x48E8, 0x48FF}  // CM-32L
+	{0x2205, 22, "\000CM32/LAPC1.02 891205", 0x8100,  256, 0x8000, 0x8000, true,  0x8080, 0x8000, true,  0x8500,  64, 0x8580,  85,  0x4F93, 0x4FAE, 0x4F9C, 0x48CB, 0x48CF, 0x48E8, 0x48FF}, // CM-32L
+#if MT32EMU_ACCEPT_TEST_ROMS
+	{0x4010, 22, "\000SYNTHETIC TEST v1.00 ", 0x3000,  128, 0x8000, 0x0000, false, 0xC000, 0x4000, false, 0x3200,  30, 0x3300,  85,  0x3500, 0x3510, 0x3520, 0x3530, 0x3540, 0x3560, 0x3580}, // Synthetic test ROM
+#endif
 	// (Note that all but CM-32L ROM actually have 86 entries for rhythmTemp)
 };
 
@@ -85,15 +88,23 @@ Synth::Synth(ReportHandler *useReportHandler) : mt32ram(*new MemParams()), mt32d
 	setOutputGain(1.0f);
 	setReverbOutputGain(1.0f);
 	setReversedStereoEnabled(false);
+	partRefreshCoalescingEnabled = false;
+	pendingPartRefreshMask = 0;
+	inaudiblePartialCullingEnabled = false;
 	partialManager = NULL;
 	midiQueue = NULL;
 	lastReceivedMIDIEventTimestamp = 0;
 	memset(parts, 0, sizeof(parts));
 	renderedSampleCount = 0;
+	renderProfiler = new RenderProfiler;
+	voiceStatisticsReportInterval = 0;
+	resetVoiceStatistics();
+	traceBuffer = NULL;
 }
 
 Synth::~Synth() {
 	close(); // Make sure we're closed and everything is freed
+	delete renderProfiler;
 	if (isDefaultReportHandler) {
 		delete reportHandler;
 	}
@@ -119,6 +130,7 @@ void Synth::newTimbreSet(int partNum, Bit8u timbreGroup, const char patchName[])
 }
 
 void Synth::printDebug(const char *fmt, ...) {
+	RealtimeChecker::checkBlockingCall("Synth::printDebug");
 	va_list ap;
 	va_start(ap, fmt);
 #if MT32EMU_DEBUG_SAMPLESTAMPS > 0
@@ -232,6 +244,23 @@ bool Synth::isReversedStereoEnabled() {
 	return reversedStereoEnabled;
 }
 
+void Synth::setPartRefreshCoalescingEnabled(bool enabled) {
+	partRefreshCoalescingEnabled = enabled;
+	if (!enabled) flushPendingPartRefreshes();
+}
+
+bool Synth::isPartRefreshCoalescingEnabled() const {
+	return partRefreshCoalescingEnabled;
+}
+
+void Synth::setInaudiblePartialCullingEnabled(bool enabled) {
+	inaudiblePartialCullingEnabled = enabled;
+}
+
+bool Synth::isInaudiblePartialCullingEnabled() const {
+	return inaudiblePartialCullingEnabled;
+}
+
 bool Synth::loadControlROM(const ROMImage &controlROMImage) {
 	File *file = controlROMImage.getFile();
 	const ROMInfo *controlROMInfo = controlROMImage.getROMInfo();
@@ -385,6 +414,8 @@ bool Synth::open(const ROMImage &controlROMImage, const ROMImage &pcmROMImage, u
 	}
 	partialCount = usePartialCount;
 	abortingPoly = NULL;
+	pendingPartRefreshMask = 0;
+	currentAbortStallSamples = 0;
 
 	// This is to help detect bugs
 	memset(&mt32ram, '?', sizeof(mt32ram));
@@ -577,6 +608,7 @@ void Synth::close(bool forced) {
 	}
 	reverbModel = NULL;
 	controlROMFeatures = NULL;
+	pendingPartRefreshMask = 0;
 	isOpen = false;
 }
 
@@ -596,6 +628,13 @@ void Synth::flushMIDIQueue() {
 	}
 }
 
+void Synth::discardMIDIQueue() {
+	if (midiQueue != NULL) {
+		midiQueue->reset();
+		lastReceivedMIDIEventTimestamp = renderedSampleCount;
+	}
+}
+
 Bit32u Synth::setMIDIEventQueueSize(Bit32u useSize) {
 	static const Bit32u MAX_QUEUE_SIZE = (1 << 24); // This results in about 256 Mb - much greater than any reasonable value
 
@@ -653,7 +692,9 @@ bool Synth::playMsg(Bit32u msg, Bit32u timestamp) {
 		timestamp = addMIDIInterfaceDelay(getShortMessageLength(msg), timestamp);
 	}
 	if (!isEnabled) isEnabled = true;
-	return midiQueue->pushShortMessage(msg, timestamp);
+	bool enqueued = midiQueue->pushShortMessage(msg, timestamp);
+	updateMIDIQueueStatistics(enqueued);
+	return enqueued;
 }
 
 bool Synth::playSysex(const Bit8u *sysex, Bit32u len) {
@@ -666,7 +707,9 @@ bool Synth::playSysex(const Bit8u *sysex, Bit32u len, Bit32u timestamp) {
 		timestamp = addMIDIInterfaceDelay(len, timestamp);
 	}
 	if (!isEnabled) isEnabled = true;
-	return midiQueue->pushSysex(sysex, len, timestamp);
+	bool enqueued = midiQueue->pushSysex(sysex, len, timestamp);
+	updateMIDIQueueStatistics(enqueued);
+	return enqueued;
 }
 
 void Synth::playMsgNow(Bit32u msg) {
@@ -695,6 +738,17 @@ void Synth::playMsgOnPart(unsigned char part, unsigned char code, unsigned char
 	Bit32u bend;
 
 	//printDebug("Synth::playMsgOnPart(%02x, %02x, %02x, %02x)", part, code, note, velocity);
+	if (isTracing()) {
+		if (code == 0x9 && velocity > 0) {
+			traceBuffer->addInstantEvent("midi", "noteOn", "part", part, "key", note);
+		} else if (code == 0x8 || code == 0x9) {
+			traceBuffer->addInstantEvent("midi", "noteOff", "part", part, "key", note);
+		}
+	}
+	if (code != 0x8 && (code != 0x9 || velocity > 0)) {
+		// Note-offs only affect the playing polys
+		flushPendingPartRefresh(part);
+	}
 	switch (code) {
 	case 0x8:
 		//printDebug("Note OFF - Part %d", part);
@@ -957,7 +1011,13 @@ void Synth::writeSysex(unsigned char device, const Bit8u *sysex, Bit32u len) {
 			printDebug("Sysex write to unrecognised address %06x, len %d", MT32EMU_SYSEXMEMADDR(addr), len);
 			break;
 		}
-		writeMemoryRegion(region, addr, region->getClampedLen(addr, len), sysex);
+		if (isTracing()) {
+			double startNanos = TraceRecorder::getNanos();
+			writeMemoryRegion(region, addr, region->getClampedLen(addr, len), sysex);
+			traceBuffer->addCompleteEvent("midi", "sysexWrite", startNanos, "address", MT32EMU_SYSEXMEMADDR(addr), "length", len);
+		} else {
+			writeMemoryRegion(region, addr, region->getClampedLen(addr, len), sysex);
+		}
 
 		Bit32u next = region->next(addr, len);
 		if (next == 0) {
@@ -1090,7 +1150,7 @@ void Synth::writeMemoryRegion(const MemoryRegion *region, Bit32u addr, Bit32u le
 						parts[i]->setTimbre(&mt32ram.timbres[parts[i]->getAbsTimbreNum()].timbre);
 					}
 				}
-				parts[i]->refresh();
+				refreshPart(i);
 			}
 		}
 		break;
@@ -1110,7 +1170,7 @@ void Synth::writeMemoryRegion(const MemoryRegion *region, Bit32u addr, Bit32u le
 #endif
 		}
 		if (parts[8] != NULL) {
-			parts[8]->refresh();
+			refreshPart(8);
 		}
 		break;
 	case MR_TimbreTemp:
@@ -1123,7 +1183,7 @@ void Synth::writeMemoryRegion(const MemoryRegion *region, Bit32u addr, Bit32u le
 			printDebug("WRITE-PARTTIMBRE (%d-%d@%d..%d): timbre=%d (%s)", first, last, off, off + len, i, instrumentName);
 #endif
 			if (parts[i] != NULL) {
-				parts[i]->refresh();
+				refreshPart(i);
 			}
 		}
 		break;
@@ -1381,6 +1441,35 @@ void Synth::refreshSystem() {
 	refreshSystemMasterVol();
 }
 
+// Part::refresh() only derives the state read by the note-ons, program changes, controllers and pitch bends from the temporary memory areas,
+// and detaches the playing polys from the cache beforehand. Thus, deferring it until the next such message for the part does not change the output,
+// while consecutive writes to the same part are coalesced. Part::setTimbre() is never deferred, since it overwrites the Timbre Temp area.
+void Synth::refreshPart(unsigned int partNum) {
+	if (!partRefreshCoalescingEnabled) {
+		voiceStatistics.partRefreshes++;
+		parts[partNum]->refresh();
+	} else if ((pendingPartRefreshMask & (1 << partNum)) != 0) {
+		voiceStatistics.coalescedPartRefreshes++;
+	} else {
+		pendingPartRefreshMask |= 1 << partNum;
+	}
+}
+
+void Synth::flushPendingPartRefresh(unsigned int partNum) {
+	if ((pendingPartRefreshMask & (1 << partNum)) == 0) return;
+	pendingPartRefreshMask &= ~(1 << partNum);
+	if (parts[partNum] != NULL) {
+		voiceStatistics.partRefreshes++;
+		parts[partNum]->refresh();
+	}
+}
+
+void Synth::flushPendingPartRefreshes() {
+	for (unsigned int i = 0; pendingPartRefreshMask != 0; i++) {
+		flushPendingPartRefresh(i);
+	}
+}
+
 void Synth::reset() {
 #if MT32EMU_MONITOR_SYSEX > 0
 	printDebug("RESET");
@@ -1397,6 +1486,7 @@ void Synth::reset() {
 		}
 	}
 	refreshSystem();
+	pendingPartRefreshMask = 0;
 	isEnabled = false;
 }
 
@@ -1475,11 +1565,22 @@ bool MidiEventQueue::isFull() const {
 	return startPosition == ((endPosition + 1) & ringBufferMask);
 }
 
+Bit32u MidiEventQueue::getLength() const {
+	return (endPosition - startPosition) & ringBufferMask;
+}
+
+unsigned int Synth::getStereoOutputSampleRate(AnalogOutputMode analogOutputMode) {
+	static const unsigned int SAMPLE_RATES[] = {SAMPLE_RATE, SAMPLE_RATE, SAMPLE_RATE * 3 / 2, SAMPLE_RATE * 3};
+
+	return SAMPLE_RATES[analogOutputMode];
+}
+
 unsigned int Synth::getStereoOutputSampleRate() const {
 	return (analog == NULL) ? SAMPLE_RATE : analog->getOutputSampleRate();
 }
 
 void Synth::render(Sample *stream, Bit32u len) {
+	RealtimeChecker::Section realtimeSection("Synth::render");
 	if (!isEnabled) {
 		renderedSampleCount += analog->getDACStreamsLength(len);
 		analog->process(NULL, NULL, NULL, NULL, NULL, NULL, NULL, len);
@@ -1487,6 +1588,12 @@ void Synth::render(Sample *stream, Bit32u len) {
 		return;
 	}
 
+	const bool profiling = renderProfiler->isEnabled();
+	if (profiling) renderProfiler->startRender();
+	const bool tracing = isTracing();
+	const double renderStartNanos = tracing ? TraceRecorder::getNanos() : 0.0;
+	const Bit32u renderLen = len;
+
 	// As in AnalogOutputMode_ACCURATE mode output is upsampled, buffer size MAX_SAMPLES_PER_RUN is more than enough.
 	Sample tmpNonReverbLeft[MAX_SAMPLES_PER_RUN], tmpNonReverbRight[MAX_SAMPLES_PER_RUN];
 	Sample tmpReverbDryLeft[MAX_SAMPLES_PER_RUN], tmpReverbDryRight[MAX_SAMPLES_PER_RUN];
@@ -1495,13 +1602,23 @@ void Synth::render(Sample *stream, Bit32u len) {
 	while (len > 0) {
 		Bit32u thisPassLen = len > MAX_SAMPLES_PER_RUN ? MAX_SAMPLES_PER_RUN : len;
 		renderStreams(tmpNonReverbLeft, tmpNonReverbRight, tmpReverbDryLeft, tmpReverbDryRight, tmpReverbWetLeft, tmpReverbWetRight, analog->getDACStreamsLength(thisPassLen));
+		double timestamp = profiling ? RenderProfiler::getNanos() : 0.0;
 		analog->process(&stream, tmpNonReverbLeft, tmpNonReverbRight, tmpReverbDryLeft, tmpReverbDryRight, tmpReverbWetLeft, tmpReverbWetRight, thisPassLen);
+		if (profiling) renderProfiler->accountStage(RenderStage_ANALOG, timestamp);
 		len -= thisPassLen;
 	}
+
+	if (profiling) reportRenderProfile();
+	if (tracing) traceBuffer->addCompleteEvent("render", "render", renderStartNanos, "frames", renderLen);
 }
 
 void Synth::renderStreams(Sample *nonReverbLeft, Sample *nonReverbRight, Sample *reverbDryLeft, Sample *reverbDryRight, Sample *reverbWetLeft, Sample *reverbWetRight, Bit32u len) {
+	RealtimeChecker::Section realtimeSection("Synth::renderStreams");
+	const bool profiling = renderProfiler->isEnabled();
+	if (profiling) renderProfiler->startRender();
+	const bool tracing = isTracing();
 	while (len > 0) {
+		const double sliceStartNanos = tracing ? TraceRecorder::getNanos() : 0.0;
 		// We need to ensure zero-duration notes will play so add minimum 1-sample delay.
 		Bit32u thisLen = 1;
 		if (!isAbortingPoly()) {
@@ -1513,6 +1630,7 @@ void Synth::renderStreams(Sample *nonReverbLeft, Sample *nonReverbRight, Sample
 					thisLen = samplesToNextEvent;
 				}
 			} else {
+				double timestamp = profiling ? RenderProfiler::getNanos() : 0.0;
 				if (nextEvent->sysexData == NULL) {
 					playMsgNow(nextEvent->shortMessageData);
 					// If a poly is aborting we don't drop the event from the queue.
@@ -1524,8 +1642,11 @@ void Synth::renderStreams(Sample *nonReverbLeft, Sample *nonReverbRight, Sample
 					playSysexNow(nextEvent->sysexData, nextEvent->sysexLength);
 					midiQueue->dropMidiEvent();
 				}
+				if (profiling) renderProfiler->accountStage(RenderStage_MIDI_DISPATCH, timestamp);
 			}
 		}
+		updateAbortStallStatistics(thisLen);
+		if (profiling) renderProfiler->accountSlice(thisLen);
 		doRenderStreams(nonReverbLeft, nonReverbRight, reverbDryLeft, reverbDryRight, reverbWetLeft, reverbWetRight, thisLen);
 		advanceStreamPosition(nonReverbLeft, thisLen);
 		advanceStreamPosition(nonReverbRight, thisLen);
@@ -1533,8 +1654,79 @@ void Synth::renderStreams(Sample *nonReverbLeft, Sample *nonReverbRight, Sample
 		advanceStreamPosition(reverbDryRight, thisLen);
 		advanceStreamPosition(reverbWetLeft, thisLen);
 		advanceStreamPosition(reverbWetRight, thisLen);
+		if (tracing) traceBuffer->addCompleteEvent("render", "slice", sliceStartNanos, "samples", thisLen);
 		len -= thisLen;
 	}
+	// Makes the program changes reported and visible via getPatchName() once the SysEx messages played during this call are processed
+	flushPendingPartRefreshes();
+	if (profiling) reportRenderProfile();
+}
+
+static unsigned int getHistogramBucket(Bit32u value) {
+	unsigned int bucket = 0;
+	while (value > 1 && bucket < VOICE_STATISTICS_HISTOGRAM_SIZE - 1) {
+		value >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+void Synth::updateMIDIQueueStatistics(bool enqueued) {
+	if (!enqueued) {
+		voiceStatistics.rejectedMIDIEvents++;
+		return;
+	}
+	Bit32u queueLength = midiQueue->getLength();
+	if (voiceStatistics.midiQueueHighWaterMark < queueLength) {
+		voiceStatistics.midiQueueHighWaterMark = queueLength;
+	}
+	voiceStatistics.midiQueueDepthHistogram[getHistogramBucket(queueLength)]++;
+}
+
+// Invoked for each render slice after the MIDI events due are processed. While a poly is aborting, slices are 1 sample long,
+// and the MIDI event that caused the abortion is pending in the queue.
+void Synth::updateAbortStallStatistics(Bit32u sliceLength) {
+	if (isAbortingPoly()) {
+		currentAbortStallSamples += sliceLength;
+	} else if (currentAbortStallSamples > 0) {
+		voiceStatistics.abortStallCount++;
+		voiceStatistics.abortStallSamples += currentAbortStallSamples;
+		if (voiceStatistics.maxAbortStallSamples < currentAbortStallSamples) {
+			voiceStatistics.maxAbortStallSamples = currentAbortStallSamples;
+		}
+		voiceStatistics.abortStallHistogram[getHistogramBucket(currentAbortStallSamples)]++;
+		currentAbortStallSamples = 0;
+	}
+	if (voiceStatisticsReportInterval > 0) {
+		samplesSinceVoiceStatisticsReport += sliceLength;
+		if (samplesSinceVoiceStatisticsReport >= voiceStatisticsReportInterval) {
+			samplesSinceVoiceStatisticsReport = 0;
+			reportHandler->onVoiceStatistics(voiceStatistics);
+		}
+	}
+}
+
+void Synth::polyAbortStarted(unsigned int partNum) {
+	voiceStatistics.polyAborts[partNum]++;
+	if (isTracing()) traceBuffer->addInstantEvent("voice", "polyAbort", "part", partNum);
+}
+
+void Synth::partialActivated() {
+	Bit32u activePartialCount = partialCount - partialManager->getFreePartialCount();
+	if (voiceStatistics.peakActivePartials < activePartialCount) {
+		voiceStatistics.peakActivePartials = activePartialCount;
+	}
+}
+
+bool Synth::isTracing() const {
+	return traceBuffer != NULL && traceBuffer->isEnabled();
+}
+
+void Synth::reportRenderProfile() {
+	if (renderProfiler->endRender()) {
+		reportHandler->onRenderProfile(renderProfiler->getIntervalProfile());
+		renderProfiler->resetInterval();
+	}
 }
 
 // In GENERATION2 units, the output from LA32 goes to the Boss chip already bit-shifted.
@@ -1588,6 +1780,9 @@ void Synth::doRenderStreams(Sample *nonReverbLeft, Sample *nonReverbRight, Sampl
 	if (reverbDryRight == NULL) reverbDryRight = tmpBufReverbDryRight;
 
 	if (isEnabled) {
+		const bool profiling = renderProfiler->isEnabled();
+		double timestamp = profiling ? RenderProfiler::getNanos() : 0.0;
+
 		muteSampleBuffer(nonReverbLeft, len);
 		muteSampleBuffer(nonReverbRight, len);
 		muteSampleBuffer(reverbDryLeft, len);
@@ -1600,30 +1795,32 @@ void Synth::doRenderStreams(Sample *nonReverbLeft, Sample *nonReverbRight, Sampl
 				partialManager->produceOutput(i, nonReverbLeft, nonReverbRight, len);
 			}
 		}
+		if (profiling) timestamp = renderProfiler->accountStage(RenderStage_PARTIALS, timestamp);
 
 		produceLA32Output(reverbDryLeft, len);
 		produceLA32Output(reverbDryRight, len);
+		// Don't bother with conversion if the output is going to be unused
+		if (nonReverbLeft != tmpBufNonReverbLeft) produceLA32Output(nonReverbLeft, len);
+		if (nonReverbRight != tmpBufNonReverbRight) produceLA32Output(nonReverbRight, len);
+		if (profiling) timestamp = renderProfiler->accountStage(RenderStage_LA32_OUTPUT, timestamp);
 
 		if (isReverbEnabled()) {
 			reverbModel->process(reverbDryLeft, reverbDryRight, reverbWetLeft, reverbWetRight, len);
-			if (reverbWetLeft != NULL) convertSamplesToOutput(reverbWetLeft, len);
-			if (reverbWetRight != NULL) convertSamplesToOutput(reverbWetRight, len);
 		} else {
 			muteSampleBuffer(reverbWetLeft, len);
 			muteSampleBuffer(reverbWetRight, len);
 		}
+		if (profiling) timestamp = renderProfiler->accountStage(RenderStage_REVERB, timestamp);
 
-		// Don't bother with conversion if the output is going to be unused
-		if (nonReverbLeft != tmpBufNonReverbLeft) {
-			produceLA32Output(nonReverbLeft, len);
-			convertSamplesToOutput(nonReverbLeft, len);
-		}
-		if (nonReverbRight != tmpBufNonReverbRight) {
-			produceLA32Output(nonReverbRight, len);
-			convertSamplesToOutput(nonReverbRight, len);
+		if (isReverbEnabled()) {
+			if (reverbWetLeft != NULL) convertSamplesToOutput(reverbWetLeft, len);
+			if (reverbWetRight != NULL) convertSamplesToOutput(reverbWetRight, len);
 		}
+		if (nonReverbLeft != tmpBufNonReverbLeft) convertSamplesToOutput(nonReverbLeft, len);
+		if (nonReverbRight != tmpBufNonReverbRight) convertSamplesToOutput(nonReverbRight, len);
 		if (reverbDryLeft != tmpBufReverbDryLeft) convertSamplesToOutput(reverbDryLeft, len);
 		if (reverbDryRight != tmpBufReverbDryRight) convertSamplesToOutput(reverbDryRight, len);
+		if (profiling) renderProfiler->accountStage(RenderStage_OUTPUT_CONVERSION, timestamp);
 	} else {
 		// Avoid muting buffers that wasn't requested
 		if (nonReverbLeft != tmpBufNonReverbLeft) muteSampleBuffer(nonReverbLeft, len);
@@ -1713,6 +1910,68 @@ const char *Synth::getPatchName(unsigned int partNumber) const {
 	return (!isOpen || partNumber > 8) ? NULL : parts[partNumber]->getCurrentInstr();
 }
 
+void Synth::setRenderProfilingEnabled(bool enabled) {
+	renderProfiler->setEnabled(enabled);
+}
+
+bool Synth::isRenderProfilingEnabled() const {
+	return renderProfiler->isEnabled();
+}
+
+void Synth::setRenderProfileReportInterval(Bit32u samples) {
+	renderProfiler->setReportInterval(samples);
+}
+
+Bit32u Synth::getRenderProfileReportInterval() const {
+	return renderProfiler->getReportInterval();
+}
+
+void Synth::getRenderProfile(RenderProfile &profile) const {
+	renderProfiler->getProfile(profile);
+}
+
+void Synth::resetRenderProfile() {
+	renderProfiler->reset();
+}
+
+void Synth::startResamplingStage() {
+	if (renderProfiler->isEnabled()) renderProfiler->startExternalStage();
+}
+
+void Synth::endResamplingStage() {
+	if (renderProfiler->isEnabled()) renderProfiler->endExternalStage(RenderStage_RESAMPLING);
+}
+
+void Synth::getVoiceStatistics(VoiceStatistics &statistics) const {
+	statistics = voiceStatistics;
+}
+
+void Synth::resetVoiceStatistics() {
+	memset(&voiceStatistics, 0, sizeof(VoiceStatistics));
+	samplesSinceVoiceStatisticsReport = 0;
+	if (partialManager != NULL) {
+		// Partials that keep playing count towards the peak
+		voiceStatistics.peakActivePartials = partialCount - partialManager->getFreePartialCount();
+	}
+}
+
+void Synth::setVoiceStatisticsReportInterval(Bit32u samples) {
+	voiceStatisticsReportInterval = samples;
+	samplesSinceVoiceStatisticsReport = 0;
+}
+
+Bit32u Synth::getVoiceStatisticsReportInterval() const {
+	return voiceStatisticsReportInterval;
+}
+
+void Synth::setTraceBuffer(TraceBuffer *useTraceBuffer) {
+	traceBuffer = useTraceBuffer;
+}
+
+TraceBuffer *Synth::getTraceBuffer() const {
+	return traceBuffer;
+}
+
 const Part *Synth::getPart(unsigned int partNum) const {
 	if (partNum > 8) {
 		return NULL;
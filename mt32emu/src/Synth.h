@@ -31,6 +31,8 @@ class Part;
 class Poly;
 class Partial;
 class PartialManager;
+class RenderProfiler;
+class TraceBuffer;
 
 class PatchTempMemoryRegion;
 class RhythmTempMemoryRegion;
@@ -117,6 +119,75 @@ enum PartialState {
 	PartialState_RELEASE
 };
 
+// Stages of the rendering pipeline the time is accounted for when render profiling is enabled.
+enum RenderStage {
+	// Processing of the enqueued MIDI events by playMsgNow() and playSysexNow() during rendering
+	RenderStage_MIDI_DISPATCH,
+	// Generation of the output of all the active partials
+	RenderStage_PARTIALS,
+	// Adaptation of the LA32 output to the DAC input mode (produceLA32Output())
+	RenderStage_LA32_OUTPUT,
+	// Processing of the reverb model
+	RenderStage_REVERB,
+	// Conversion of the streams to the output format emulating the DAC bit layout (convertSamplesToOutput())
+	RenderStage_OUTPUT_CONVERSION,
+	// Emulation of the analogue circuitry in render(). In AnalogOutputMode_ACCURATE and AnalogOutputMode_OVERSAMPLED modes,
+	// this includes resampling to the output sample rate, since the upsampling is inherent to the LPF emulated.
+	RenderStage_ANALOG,
+	// Sample rate conversion performed by the application, which pulls the samples via render().
+	// Only accounted when delimited with Synth::startResamplingStage() and Synth::endResamplingStage(),
+	// the time of the nested render() calls is excluded. Not included in RenderProfile::renderNanos either.
+	RenderStage_RESAMPLING,
+	RenderStage_COUNT
+};
+
+// Number of buckets in the histograms of VoiceStatistics. Bucket 0 counts values 0 and 1, bucket i > 0 counts values
+// in range [2^i, 2^(i + 1)), the last bucket also counts all the greater values.
+const unsigned int VOICE_STATISTICS_HISTOGRAM_SIZE = 16;
+
+// Counters which reveal how the synth copes with the load, i.e. when MIDI events are dropped or delayed and voices stolen.
+// Like the hardware, the emulation never reports these conditions otherwise.
+// The MIDI queue counters are updated by the thread that calls playMsg() and playSysex(), the rest are updated by the rendering thread.
+struct VoiceStatistics {
+	// Maximum number of events waiting in the MIDI event queue at once
+	Bit32u midiQueueHighWaterMark;
+	// Number of events in the MIDI event queue, sampled each time an event is enqueued
+	Bit32u midiQueueDepthHistogram[VOICE_STATISTICS_HISTOGRAM_SIZE];
+	// Number of MIDI events playMsg() and playSysex() failed to enqueue because the queue was full
+	Bit32u rejectedMIDIEvents;
+	// Number of polys aborted to free partials for a new note or in single-assign mode, per part (0..7 for Part 1..8, 8 for Rhythm)
+	Bit32u polyAborts[9];
+	// Number of completed periods when processing of MIDI events was stalled waiting for an aborted poly to finish,
+	// their total and maximum duration in samples at the DAC sample rate, and the distribution of the duration
+	Bit32u abortStallCount;
+	Bit32u abortStallSamples;
+	Bit32u maxAbortStallSamples;
+	Bit32u abortStallHistogram[VOICE_STATISTICS_HISTOGRAM_SIZE];
+	// Maximum number of partials playing simultaneously
+	Bit32u peakActivePartials;
+	// Number of parts refreshed due to SysEx writes to the Patch Temp, Rhythm Setup Temp and Timbre Temp areas,
+	// and the number of such writes which found the refresh of the part already pending (see Synth::setPartRefreshCoalescingEnabled())
+	Bit32u partRefreshes;
+	Bit32u coalescedPartRefreshes;
+};
+
+// Timing data collected by the render profiler. The counters are 32-bit and wrap around eventually,
+// so long-running applications should rather rely on the periodic reports which cover a fixed interval each.
+struct RenderProfile {
+	// Time in nanoseconds spent in each stage, and the number of times the stage was entered
+	double stageNanos[RenderStage_COUNT];
+	Bit32u stageCalls[RenderStage_COUNT];
+	// Total time in nanoseconds spent in render() and renderStreams(), including any time not accounted for in the stages,
+	// and the number of such calls (renderStreams() invoked by render() is not counted separately)
+	double renderNanos;
+	Bit32u renderCalls;
+	// Number of slices the rendering is split into by renderStreams(). A new slice starts at each MIDI event
+	// and after MAX_SAMPLES_PER_RUN samples. While a poly is being aborted, each slice is 1 sample long.
+	Bit32u renderSliceCount;
+	// Number of samples rendered at the DAC sample rate
+	Bit32u renderedSampleCount;
+};
+
 const Bit8u SYSEX_MANUFACTURER_ROLAND = 0x41;
 
 const Bit8u SYSEX_MDL_MT32 = 0x16;
@@ -159,6 +230,10 @@ protected:
 	virtual void onNewReverbLevel(Bit8u /* level */) {}
 	virtual void onPolyStateChanged(int /* partNum */) {}
 	virtual void onProgramChanged(int /* partNum */, int /* bankNum */, const char * /* patchName */) {}
+	// Invoked from the rendering thread with the data collected since the previous report, see Synth::setRenderProfileReportInterval()
+	virtual void onRenderProfile(const RenderProfile & /* profile */) {}
+	// Invoked from the rendering thread with the counters accumulated so far, see Synth::setVoiceStatisticsReportInterval()
+	virtual void onVoiceStatistics(const VoiceStatistics & /* statistics */) {}
 };
 
 class Synth {
@@ -215,6 +290,12 @@ private:
 
 	bool reversedStereoEnabled;
 
+	// Parts whose refresh is deferred until the next MIDI channel message for the part or the end of renderStreams(), bit 8 stands for the rhythm part
+	bool partRefreshCoalescingEnabled;
+	Bit32u pendingPartRefreshMask;
+
+	bool inaudiblePartialCullingEnabled;
+
 	bool isOpen;
 
 	bool isDefaultReportHandler;
@@ -230,18 +311,36 @@ private:
 
 	Analog *analog;
 
+	RenderProfiler *renderProfiler;
+
+	VoiceStatistics voiceStatistics;
+	Bit32u currentAbortStallSamples;
+	Bit32u voiceStatisticsReportInterval;
+	Bit32u samplesSinceVoiceStatisticsReport;
+
+	TraceBuffer *traceBuffer;
+
 	Bit32u addMIDIInterfaceDelay(Bit32u len, Bit32u timestamp);
 
 	void produceLA32Output(Sample *buffer, Bit32u len);
 	void convertSamplesToOutput(Sample *buffer, Bit32u len);
 	bool isAbortingPoly() const;
 	void doRenderStreams(Sample *nonReverbLeft, Sample *nonReverbRight, Sample *reverbDryLeft, Sample *reverbDryRight, Sample *reverbWetLeft, Sample *reverbWetRight, Bit32u len);
+	void reportRenderProfile();
+	void updateMIDIQueueStatistics(bool enqueued);
+	void updateAbortStallStatistics(Bit32u sliceLength);
+	void polyAbortStarted(unsigned int partNum);
+	void partialActivated();
+	bool isTracing() const;
 
 	void readSysex(unsigned char channel, const Bit8u *sysex, Bit32u len) const;
 	void initMemoryRegions();
 	void deleteMemoryRegions();
 	MemoryRegion *findMemoryRegion(Bit32u addr);
 	void writeMemoryRegion(const MemoryRegion *region, Bit32u addr, Bit32u len, const Bit8u *data);
+	void refreshPart(unsigned int partNum);
+	void flushPendingPartRefresh(unsigned int partNum);
+	void flushPendingPartRefreshes();
 	void readMemoryRegion(const MemoryRegion *region, Bit32u addr, Bit32u len, Bit8u *data);
 
 	bool loadControlROM(const ROMImage &controlROMImage);
@@ -317,6 +416,10 @@ public:
 	// All the enqueued events are processed by the synth immediately.
 	void flushMIDIQueue();
 
+	// All the enqueued events are dropped without being processed, e.g. when playback of scheduled events is cancelled.
+	// Must not be called concurrently with playMsg(), playSysex() or rendering.
+	void discardMIDIQueue();
+
 	// Sets size of the internal MIDI event queue. The queue size is set to the minimum power of 2 that is greater or equal to the size specified.
 	// The queue is flushed before reallocation.
 	// Returns the actual queue size being used.
@@ -395,6 +498,25 @@ public:
 	void setReversedStereoEnabled(bool enabled);
 	bool isReversedStereoEnabled();
 
+	// Enables deferred refreshing of the parts affected by SysEx writes to the Patch Temp, Rhythm Setup Temp and Timbre Temp areas.
+	// Instead of upon every write, each affected part is then refreshed once before the next MIDI channel message other than note-off
+	// is played on it, or at the end of renderStreams(). This speeds up bulk uploads which consist of many small SysEx messages
+	// without affecting the audio output. However, ReportHandler::onProgramChanged() is only invoked upon the deferred refresh,
+	// so applications see the patch changes later. Disabled by default. The setting is retained when the synth is re-opened.
+	void setPartRefreshCoalescingEnabled(bool enabled);
+	bool isPartRefreshCoalescingEnabled() const;
+
+	// Enables skipping the wave generation for the partials which are too quiet to affect the output while their envelopes
+	// and wave positions still advance, and terminating the releasing partials early once they remain inaudible for a while.
+	// This saves rendering time and frees the partials sooner in dense arrangements, though the output is no longer bit-exact
+	// with the emulation of the hardware as the voice allocation may change. Disabled by default.
+	// The setting is retained when the synth is re-opened.
+	void setInaudiblePartialCullingEnabled(bool enabled);
+	bool isInaudiblePartialCullingEnabled() const;
+
+	// Returns the sample rate of the output signal produced by render() in the given analog output mode.
+	static unsigned int getStereoOutputSampleRate(AnalogOutputMode analogOutputMode);
+
 	// Returns actual sample rate used in emulation of stereo analog circuitry of hardware units.
 	// See comment for render() below.
 	unsigned int getStereoOutputSampleRate() const;
@@ -440,6 +562,38 @@ public:
 	const char *getPatchName(unsigned int partNumber) const;
 
 	void readMemory(Bit32u addr, Bit32u len, Bit8u *data);
+
+	// Enables accounting of the time spent in each RenderStage. The overhead is a few clock reads per render slice,
+	// when disabled (by default), the overhead is negligible. Enabling or disabling the profiler does not reset the data collected so far.
+	// The setting is retained when the synth is re-opened.
+	void setRenderProfilingEnabled(bool enabled);
+	bool isRenderProfilingEnabled() const;
+	// Sets the number of samples (at the DAC sample rate) after which ReportHandler::onRenderProfile() is invoked
+	// with the data collected during that period. Zero (default) disables the periodic reports.
+	void setRenderProfileReportInterval(Bit32u samples);
+	Bit32u getRenderProfileReportInterval() const;
+	// Fills in the data collected since the synth was created or the last reset.
+	// The profile is updated by the rendering thread, so reading it from another thread may yield slightly inconsistent values.
+	void getRenderProfile(RenderProfile &profile) const;
+	void resetRenderProfile();
+	// To be invoked from the rendering thread around a sample rate conversion which pulls the input via render(),
+	// so that its own processing time is accounted for in RenderStage_RESAMPLING. Do nothing unless profiling is enabled.
+	void startResamplingStage();
+	void endResamplingStage();
+
+	// Fills in the voice allocation and MIDI queue counters accumulated since the synth was created or the last reset.
+	// Reading from a thread other than the rendering thread may yield slightly inconsistent values.
+	void getVoiceStatistics(VoiceStatistics &statistics) const;
+	void resetVoiceStatistics();
+	// Sets the number of samples (at the DAC sample rate) after which ReportHandler::onVoiceStatistics() is invoked.
+	// Zero (default) disables the periodic reports.
+	void setVoiceStatisticsReportInterval(Bit32u samples);
+	Bit32u getVoiceStatisticsReportInterval() const;
+
+	// Sets the buffer to record the rendering and MIDI processing events into while the owning TraceRecorder is enabled.
+	// NULL (default) disables tracing. The buffer is filled by the rendering thread (and by the threads calling play*Now()).
+	void setTraceBuffer(TraceBuffer *traceBuffer);
+	TraceBuffer *getTraceBuffer() const;
 };
 
 }
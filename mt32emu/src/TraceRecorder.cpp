@@ -0,0 +1,214 @@
+/* Copyright (C) 2011, 2012, 2013, 2014 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include "mt32emu.h"
+#include "RenderProfiler.h"
+
+namespace MT32Emu {
+
+// Process ID reported for all the events, the tracks are distinguished by thread IDs
+static const int TRACE_PROCESS_ID = 1;
+
+static void writeJSONString(FILE *file, const char *str) {
+	fputc('"', file);
+	for (const char *p = str; *p != 0; p++) {
+		unsigned char c = (unsigned char)*p;
+		if (c == '"' || c == '\\') {
+			fputc('\\', file);
+			fputc(c, file);
+		} else if (c < 0x20) {
+			fprintf(file, "\\u%04x", c);
+		} else {
+			fputc(c, file);
+		}
+	}
+	fputc('"', file);
+}
+
+static void writeArgs(FILE *file, const TraceEvent &event) {
+	if (event.argNames[0] == NULL) return;
+	fputs(",\"args\":{", file);
+	for (int i = 0; i < 2 && event.argNames[i] != NULL; i++) {
+		if (i > 0) fputc(',', file);
+		writeJSONString(file, event.argNames[i]);
+		fprintf(file, ":%.17g", event.argValues[i]);
+	}
+	fputc('}', file);
+}
+
+TraceBuffer::TraceBuffer(const TraceRecorder &useRecorder, const char *useThreadName, unsigned int useThreadID, Bit32u useCapacity) :
+	recorder(useRecorder), threadID(useThreadID), events(new TraceEvent[useCapacity]), capacity(useCapacity),
+	eventCount(0), droppedEventCount(0), next(NULL)
+{
+	threadName = new char[strlen(useThreadName) + 1];
+	strcpy(threadName, useThreadName);
+}
+
+TraceBuffer::~TraceBuffer() {
+	delete[] threadName;
+	delete[] events;
+}
+
+bool TraceBuffer::isEnabled() const {
+	return recorder.isEnabled();
+}
+
+TraceEvent *TraceBuffer::allocEvent(char phase, const char *category, const char *name) {
+	if (eventCount == capacity) {
+		droppedEventCount++;
+		return NULL;
+	}
+	TraceEvent *event = &events[eventCount++];
+	event->phase = phase;
+	event->category = category;
+	event->name = name;
+	event->durationNanos = 0.0;
+	return event;
+}
+
+void TraceBuffer::addCompleteEvent(const char *category, const char *name, double startNanos, const char *argName, double argValue, const char *arg2Name, double arg2Value) {
+	TraceEvent *event = allocEvent('X', category, name);
+	if (event == NULL) return;
+	event->timestampNanos = startNanos;
+	event->durationNanos = TraceRecorder::getNanos() - startNanos;
+	event->argNames[0] = argName;
+	event->argValues[0] = argValue;
+	event->argNames[1] = arg2Name;
+	event->argValues[1] = arg2Value;
+}
+
+void TraceBuffer::addInstantEvent(const char *category, const char *name, const char *argName, double argValue, const char *arg2Name, double arg2Value) {
+	TraceEvent *event = allocEvent('i', category, name);
+	if (event == NULL) return;
+	event->timestampNanos = TraceRecorder::getNanos();
+	event->argNames[0] = argName;
+	event->argValues[0] = argValue;
+	event->argNames[1] = arg2Name;
+	event->argValues[1] = arg2Value;
+}
+
+void TraceBuffer::addCounterEvent(const char *category, const char *name, double value) {
+	TraceEvent *event = allocEvent('C', category, name);
+	if (event == NULL) return;
+	event->timestampNanos = TraceRecorder::getNanos();
+	event->argNames[0] = "value";
+	event->argValues[0] = value;
+	event->argNames[1] = NULL;
+}
+
+Bit32u TraceBuffer::getEventCount() const {
+	return eventCount;
+}
+
+Bit32u TraceBuffer::getDroppedEventCount() const {
+	return droppedEventCount;
+}
+
+double TraceRecorder::getNanos() {
+	return RenderProfiler::getNanos();
+}
+
+TraceRecorder::TraceRecorder(Bit32u useEventsPerBuffer) :
+	enabled(false), eventsPerBuffer(useEventsPerBuffer), startNanos(getNanos()), firstBuffer(NULL), lastBuffer(NULL), bufferCount(0)
+{}
+
+TraceRecorder::~TraceRecorder() {
+	while (firstBuffer != NULL) {
+		TraceBuffer *buffer = firstBuffer;
+		firstBuffer = buffer->next;
+		delete buffer;
+	}
+}
+
+TraceBuffer *TraceRecorder::createBuffer(const char *threadName) {
+	TraceBuffer *buffer = new TraceBuffer(*this, threadName, ++bufferCount, eventsPerBuffer);
+	if (lastBuffer == NULL) {
+		firstBuffer = buffer;
+	} else {
+		lastBuffer->next = buffer;
+	}
+	lastBuffer = buffer;
+	return buffer;
+}
+
+void TraceRecorder::setEnabled(bool newEnabled) {
+	enabled = newEnabled;
+}
+
+bool TraceRecorder::isEnabled() const {
+	return enabled;
+}
+
+void TraceRecorder::clear() {
+	for (TraceBuffer *buffer = firstBuffer; buffer != NULL; buffer = buffer->next) {
+		buffer->eventCount = 0;
+		buffer->droppedEventCount = 0;
+	}
+}
+
+Bit32u TraceRecorder::getEventCount() const {
+	Bit32u count = 0;
+	for (const TraceBuffer *buffer = firstBuffer; buffer != NULL; buffer = buffer->next) {
+		count += buffer->eventCount;
+	}
+	return count;
+}
+
+Bit32u TraceRecorder::getDroppedEventCount() const {
+	Bit32u count = 0;
+	for (const TraceBuffer *buffer = firstBuffer; buffer != NULL; buffer = buffer->next) {
+		count += buffer->droppedEventCount;
+	}
+	return count;
+}
+
+bool TraceRecorder::writeJSON(const char *fileName) const {
+	FILE *file = fopen(fileName, "w");
+	if (file == NULL) return false;
+	fputs("{\"traceEvents\":[\n", file);
+	bool first = true;
+	for (const TraceBuffer *buffer = firstBuffer; buffer != NULL; buffer = buffer->next) {
+		if (!first) fputs(",\n", file);
+		first = false;
+		fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":", TRACE_PROCESS_ID, buffer->threadID);
+		writeJSONString(file, buffer->threadName);
+		fputs("}}", file);
+		for (Bit32u i = 0; i < buffer->eventCount; i++) {
+			const TraceEvent &event = buffer->events[i];
+			fputs(",\n{\"name\":", file);
+			writeJSONString(file, event.name);
+			fputs(",\"cat\":", file);
+			writeJSONString(file, event.category);
+			// Timestamps are in microseconds since the recorder was created
+			fprintf(file, ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%u", event.phase, (event.timestampNanos - startNanos) * 1e-3, TRACE_PROCESS_ID, buffer->threadID);
+			if (event.phase == 'X') {
+				fprintf(file, ",\"dur\":%.3f", event.durationNanos * 1e-3);
+			} else if (event.phase == 'i') {
+				fputs(",\"s\":\"t\"", file);
+			}
+			writeArgs(file, event);
+			fputc('}', file);
+		}
+	}
+	fputs("\n],\"displayTimeUnit\":\"ns\"}\n", file);
+	bool success = ferror(file) == 0;
+	return (fclose(file) == 0) && success;
+}
+
+}
@@ -0,0 +1,111 @@
+/* Copyright (C) 2011, 2012, 2013, 2014 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MT32EMU_TRACE_RECORDER_H
+#define MT32EMU_TRACE_RECORDER_H
+
+#include "mt32emu.h"
+
+namespace MT32Emu {
+
+class TraceRecorder;
+
+// A single recorded event. The strings are not copied, so they must outlive the recorder (string literals are assumed).
+struct TraceEvent {
+	// Phase as defined by the Chrome trace event format: 'X' - complete event, 'i' - instant event, 'C' - counter
+	char phase;
+	const char *category;
+	const char *name;
+	double timestampNanos;
+	double durationNanos;
+	// Optional numeric arguments, unused ones have NULL names
+	const char *argNames[2];
+	double argValues[2];
+};
+
+// Fixed-capacity event buffer filled by a single thread at a time. Adding an event neither locks nor allocates.
+// When the buffer is full, further events are dropped and counted.
+class TraceBuffer {
+friend class TraceRecorder;
+public:
+	bool isEnabled() const;
+
+	// Records an event which started at the timestamp given (obtained from TraceRecorder::getNanos()) and ends now
+	void addCompleteEvent(const char *category, const char *name, double startNanos, const char *argName = NULL, double argValue = 0.0, const char *arg2Name = NULL, double arg2Value = 0.0);
+	void addInstantEvent(const char *category, const char *name, const char *argName = NULL, double argValue = 0.0, const char *arg2Name = NULL, double arg2Value = 0.0);
+	void addCounterEvent(const char *category, const char *name, double value);
+
+	Bit32u getEventCount() const;
+	Bit32u getDroppedEventCount() const;
+
+private:
+	const TraceRecorder &recorder;
+	char *threadName;
+	const unsigned int threadID;
+	TraceEvent * const events;
+	const Bit32u capacity;
+	Bit32u eventCount;
+	Bit32u droppedEventCount;
+	TraceBuffer *next;
+
+	TraceBuffer(const TraceRecorder &recorder, const char *threadName, unsigned int threadID, Bit32u capacity);
+	~TraceBuffer();
+	TraceEvent *allocEvent(char phase, const char *category, const char *name);
+};
+
+// Collects timestamped events from several threads, each of them filling its own TraceBuffer,
+// and writes them to a file in the Chrome trace event format (JSON), viewable in chrome://tracing or Perfetto UI.
+// Recording is disabled initially. Synth records the rendering and MIDI processing events into the buffer set by Synth::setTraceBuffer().
+// NOTE: Buffers must be created from a single thread, though it is safe while other threads are adding events to their buffers.
+// Methods clear(), writeJSON() and the event counters should only be used while no thread is adding events, e.g. with recording disabled.
+// The recorder must outlive all the users of its buffers.
+class TraceRecorder {
+public:
+	static const Bit32u DEFAULT_EVENTS_PER_BUFFER = 65536;
+
+	// Returns a monotonic timestamp in nanoseconds, the time base of all the recorded events
+	static double getNanos();
+
+	TraceRecorder(Bit32u eventsPerBuffer = DEFAULT_EVENTS_PER_BUFFER);
+	~TraceRecorder();
+
+	// Creates a buffer for a thread, which shows up as a separate track named threadName. The buffer is owned by the recorder.
+	TraceBuffer *createBuffer(const char *threadName);
+
+	void setEnabled(bool enabled);
+	bool isEnabled() const;
+
+	// Discards the events recorded so far, the buffers remain valid
+	void clear();
+
+	// Returns the total number of events recorded or dropped because of insufficient buffer capacity
+	Bit32u getEventCount() const;
+	Bit32u getDroppedEventCount() const;
+
+	bool writeJSON(const char *fileName) const;
+
+private:
+	volatile bool enabled;
+	const Bit32u eventsPerBuffer;
+	const double startNanos;
+	TraceBuffer *firstBuffer;
+	TraceBuffer *lastBuffer;
+	unsigned int bufferCount;
+};
+
+}
+
+#endif
@@ -69,6 +69,21 @@
 // 1: Maximum achievable emulation accuracy.
 #define MT32EMU_BOSS_REVERB_PRECISE_MODE 0
 
+// 0: Only the known ROM images are accepted.
+// 1: Additionally accept the synthetic test ROMs made by TestROMGenerator (see mt32emu_bench), so that benchmarks
+//    and regression checks can run without real ROMs. These ROMs contain no real sounds, never enable this in release builds.
+#ifndef MT32EMU_ACCEPT_TEST_ROMS
+#define MT32EMU_ACCEPT_TEST_ROMS 0
+#endif
+
+// 0: No realtime-safety checks.
+// 1: RealtimeChecker reports heap usage, locks and blocking calls within the realtime sections, e.g. Synth::render().
+//    The global operator new and delete (and with glibc, the C allocation, pthread locking and common blocking functions)
+//    are replaced for the whole program, intended for debug builds only.
+#ifndef MT32EMU_REALTIME_CHECKS
+#define MT32EMU_REALTIME_CHECKS 0
+#endif
+
 #include "Structures.h"
 #include "Tables.h"
 #include "Poly.h"
@@ -79,5 +94,6 @@
 #include "TVF.h"
 #include "Partial.h"
 #include "Part.h"
+#include "RenderProfiler.h"
 
 #endif
@@ -60,5 +60,7 @@ const unsigned int DEFAULT_MIDI_EVENT_QUEUE_SIZE = 1024;
 #include "ROMInfo.h"
 #include "Synth.h"
 #include "MidiStreamParser.h"
+#include "TraceRecorder.h"
+#include "RealtimeChecker.h"
 
 #endif
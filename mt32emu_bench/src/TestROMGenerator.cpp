@@ -0,0 +1,367 @@
+/* Copyright (C) 2011, 2012, 2013, 2014 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include "TestROMGenerator.h"
+
+using namespace MT32Emu;
+
+// Control ROM layout, must match the test entry of ControlROMMaps in Synth.cpp.
+static const Bit16u ID_POS = 0x4010;
+static const char ID_BYTES[] = "\000SYNTHETIC TEST v1.00 ";
+static const Bit16u ID_LEN = 22;
+static const Bit16u PCM_TABLE = 0x3000;
+static const Bit16u PCM_COUNT = 128;
+static const Bit16u TIMBRE_A_MAP = 0x8000;
+static const Bit16u TIMBRE_A_OFFSET = 0x0000;
+static const Bit16u TIMBRE_B_MAP = 0xC000;
+static const Bit16u TIMBRE_B_OFFSET = 0x4000;
+static const Bit16u TIMBRE_R_MAP = 0x3200;
+static const Bit16u TIMBRE_R_COUNT = 30;
+static const Bit16u TIMBRE_R_DATA = 0x0100;
+static const Bit16u RHYTHM_SETTINGS = 0x3300;
+static const Bit16u RHYTHM_SETTINGS_COUNT = 85;
+static const Bit16u RESERVE_SETTINGS = 0x3500;
+static const Bit16u PAN_SETTINGS = 0x3510;
+static const Bit16u PROGRAM_SETTINGS = 0x3520;
+static const Bit16u RHYTHM_MAX_TABLE = 0x3530;
+static const Bit16u PATCH_MAX_TABLE = 0x3540;
+static const Bit16u SYSTEM_MAX_TABLE = 0x3560;
+static const Bit16u TIMBRE_MAX_TABLE = 0x3580;
+
+static const unsigned int TIMBRE_COMMON_SIZE = 14;
+static const unsigned int TIMBRE_PARTIAL_SIZE = 58;
+static const unsigned int TIMBRE_SIZE = TIMBRE_COMMON_SIZE + 4 * TIMBRE_PARTIAL_SIZE;
+static const unsigned int MELODIC_TIMBRE_COUNT = 64;
+
+// The PCM ROM is split into regions of this many samples, each holding a distinct wave.
+static const unsigned int PCM_REGION_LENGTH = 4096;
+static const unsigned int PCM_REGION_COUNT = (TEST_PCM_ROM_SIZE / 2) / PCM_REGION_LENGTH;
+
+// Max tables, field ranges as documented in Structures.h (MT-32 variant, two waveforms only).
+static const Bit8u TIMBRE_MAX[TIMBRE_COMMON_SIZE + TIMBRE_PARTIAL_SIZE] = {
+	127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 12, 12, 15, 1,
+	96, 100, 16, 1, 1, 127, 100, 14,
+	10, 100, 4, 100, 100, 100, 100, 100, 100, 100, 100, 100,
+	100, 100, 100,
+	100, 30, 14, 127, 14, 100, 100, 4, 4, 100, 100, 100, 100, 100, 100, 100, 100, 100,
+	100, 100, 127, 12, 127, 12, 4, 4, 100, 100, 100, 100, 100, 100, 100, 100, 100
+};
+static const Bit8u PATCH_MAX[16] = {3, 63, 48, 100, 24, 3, 1, 0, 100, 14, 0, 0, 0, 0, 0, 0};
+static const Bit8u RHYTHM_MAX[4] = {94, 100, 14, 1};
+static const Bit8u SYSTEM_MAX[23] = {127, 3, 7, 7, 32, 32, 32, 32, 32, 32, 32, 32, 32, 16, 16, 16, 16, 16, 16, 16, 16, 16, 100};
+
+static const Bit8u RESERVE[9] = {3, 10, 6, 4, 3, 0, 0, 0, 6};
+static const Bit8u PAN[9] = {7, 3, 11, 5, 9, 1, 13, 7, 7};
+static const Bit8u PROGRAMS[8] = {0, 68, 48, 95, 78, 41, 3, 110};
+
+// Minimal deterministic pseudo-random sequence, std::rand() would make the output depend on the C runtime.
+class Random {
+private:
+	Bit32u state;
+
+public:
+	Random(Bit32u seed) : state(seed) {}
+
+	unsigned int next(unsigned int range) {
+		state = state * 1103515245 + 12345;
+		return ((state >> 16) & 0x7FFF) % range;
+	}
+};
+
+static void putLE16(Bit8u *p, Bit16u value) {
+	p[0] = Bit8u(value & 0xFF);
+	p[1] = Bit8u(value >> 8);
+}
+
+static void makePartial(Bit8u *partial, Random &random, bool pcm, bool percussive) {
+	Bit8u *p = partial;
+	// WG
+	*(p++) = Bit8u(30 + random.next(13)); // pitch coarse
+	*(p++) = Bit8u(45 + random.next(11)); // pitch fine
+	*(p++) = 11; // pitch keyfollow 1
+	*(p++) = 1; // bender enabled
+	*(p++) = Bit8u(random.next(2)); // waveform
+	*(p++) = Bit8u(random.next(PCM_COUNT)); // PCM wave
+	*(p++) = Bit8u(random.next(101)); // pulse width
+	*(p++) = Bit8u(4 + random.next(7)); // PW velo sensitivity
+	// Pitch envelope
+	*(p++) = Bit8u(random.next(4)); // depth
+	*(p++) = Bit8u(random.next(40));
+	*(p++) = Bit8u(random.next(5));
+	for (int i = 0; i < 4; i++) *(p++) = Bit8u(random.next(60));
+	for (int i = 0; i < 5; i++) *(p++) = Bit8u(44 + random.next(13));
+	// Pitch LFO
+	*(p++) = Bit8u(40 + random.next(50));
+	*(p++) = Bit8u(random.next(20));
+	*(p++) = Bit8u(random.next(30));
+	// TVF
+	*(p++) = Bit8u(pcm ? 100 : 40 + random.next(61)); // cutoff
+	*(p++) = Bit8u(random.next(31)); // resonance
+	*(p++) = Bit8u(random.next(15)); // keyfollow
+	*(p++) = Bit8u(random.next(128)); // bias point
+	*(p++) = Bit8u(random.next(15)); // bias level
+	*(p++) = Bit8u(random.next(101)); // env depth
+	*(p++) = Bit8u(random.next(101));
+	*(p++) = Bit8u(random.next(5));
+	*(p++) = Bit8u(random.next(5));
+	for (int i = 0; i < 5; i++) *(p++) = Bit8u(random.next(80));
+	for (int i = 0; i < 4; i++) *(p++) = Bit8u(random.next(101));
+	// TVA
+	*(p++) = Bit8u(70 + random.next(31)); // level
+	*(p++) = Bit8u(random.next(101));
+	*(p++) = Bit8u(random.next(128));
+	*(p++) = Bit8u(random.next(13));
+	*(p++) = Bit8u(random.next(128));
+	*(p++) = Bit8u(random.next(13));
+	*(p++) = Bit8u(random.next(5));
+	*(p++) = Bit8u(random.next(5));
+	*(p++) = Bit8u(random.next(percussive ? 10 : 40)); // attack
+	for (int i = 0; i < 4; i++) *(p++) = Bit8u(random.next(percussive ? 50 : 80));
+	*(p++) = 100;
+	for (int i = 0; i < 2; i++) *(p++) = Bit8u(50 + random.next(51));
+	*(p++) = Bit8u(percussive ? 0 : 40 + random.next(61)); // sustain level
+}
+
+// Returns the length of the data written, which is shorter than TIMBRE_SIZE for compressed timbres with muted partials.
+static unsigned int makeTimbre(Bit8u *timbre, unsigned int seed, const char *namePrefix, unsigned int number, bool rhythm, bool compressed) {
+	Random random(seed);
+	char name[16];
+	sprintf(name, "%s%02u    ", namePrefix, number % 100);
+	memcpy(timbre, name, 10);
+	Bit8u partialStructure12 = Bit8u(random.next(13));
+	Bit8u partialStructure34 = Bit8u(random.next(13));
+	// Partial 0 may be muted as well, it is present in compressed data in any case
+	Bit8u partialMute = rhythm ? Bit8u(1 + random.next(3)) : Bit8u(1 + random.next(15));
+	timbre[10] = partialStructure12;
+	timbre[11] = partialStructure34;
+	timbre[12] = partialMute;
+	timbre[13] = rhythm ? 1 : Bit8u(random.next(8) == 0);
+
+	// Mirror of PartialStruct in Part.cpp, bit 1 marks the first partial of the pair as PCM, bit 0 the second.
+	static const Bit8u PARTIAL_STRUCT[13] = {0, 0, 2, 2, 1, 3, 3, 0, 3, 0, 2, 1, 3};
+	unsigned int length = TIMBRE_COMMON_SIZE;
+	for (unsigned int t = 0; t < 4; t++) {
+		Bit8u structure = PARTIAL_STRUCT[t < 2 ? partialStructure12 : partialStructure34];
+		bool pcm = (structure & ((t & 1) ? 1 : 2)) != 0;
+		Bit8u partial[TIMBRE_PARTIAL_SIZE];
+		makePartial(partial, random, pcm, rhythm);
+		if (!compressed || t == 0 || ((partialMute >> t) & 1) != 0) {
+			memcpy(timbre + length, partial, TIMBRE_PARTIAL_SIZE);
+			length += TIMBRE_PARTIAL_SIZE;
+		}
+	}
+	return length;
+}
+
+void TestROMGenerator::generateControlROM(Bit8u *data) {
+	memset(data, 0, TEST_CONTROL_ROM_SIZE);
+	memcpy(data + ID_POS, ID_BYTES, ID_LEN);
+
+	// Wave map. Waves 0-63 occupy whole regions, waves 64-127 reuse the first halves of the same regions.
+	// Odd regions contain periodic waves which loop seamlessly at either length.
+	for (unsigned int i = 0; i < PCM_COUNT; i++) {
+		unsigned int region = i % PCM_REGION_COUNT;
+		Bit8u *entry = data + PCM_TABLE + 4 * i;
+		entry[0] = Bit8u(region * PCM_REGION_LENGTH / 0x800);
+		entry[1] = Bit8u(((i < PCM_REGION_COUNT ? 1 : 0) << 4) | ((region & 1) ? 0x80 : 0x00) | ((i % 5) != 0 ? 0x01 : 0x00));
+		// Pitch 0x4000 plays the wave at the native sample rate at key 60 with neutral coarse and fine tune
+		Bit16u pitch = Bit16u(0x4000 + ((i * 97) % 512) - 256);
+		entry[2] = Bit8u(pitch & 0xFF);
+		entry[3] = Bit8u(pitch >> 8);
+	}
+
+	// Melodic banks A and B, uncompressed. The maps contain addresses relative to the bank offsets.
+	Bit16u timbreAddress = TIMBRE_A_MAP + 2 * MELODIC_TIMBRE_COUNT;
+	for (unsigned int i = 0; i < MELODIC_TIMBRE_COUNT; i++) {
+		putLE16(data + TIMBRE_A_MAP + 2 * i, Bit16u(timbreAddress - TIMBRE_A_OFFSET));
+		makeTimbre(data + timbreAddress, 0x1000 + i, "TestA", i + 1, false, false);
+		timbreAddress += TIMBRE_SIZE;
+	}
+	timbreAddress = TIMBRE_B_MAP + 2 * MELODIC_TIMBRE_COUNT;
+	for (unsigned int i = 0; i < MELODIC_TIMBRE_COUNT; i++) {
+		putLE16(data + TIMBRE_B_MAP + 2 * i, Bit16u(timbreAddress - TIMBRE_B_OFFSET));
+		makeTimbre(data + timbreAddress, 0x2000 + i, "TestB", i + 1, false, false);
+		timbreAddress += TIMBRE_SIZE;
+	}
+
+	// Rhythm bank, always compressed
+	timbreAddress = TIMBRE_R_DATA;
+	for (unsigned int i = 0; i < TIMBRE_R_COUNT; i++) {
+		putLE16(data + TIMBRE_R_MAP + 2 * i, timbreAddress);
+		timbreAddress += makeTimbre(data + timbreAddress, 0x3000 + i, "TestR", i + 1, true, true);
+	}
+
+	// Rhythm setup: keys cycle through the rhythm timbres, a few keys use memory timbres and a few are off
+	Random random(0x4000);
+	for (unsigned int i = 0; i < RHYTHM_SETTINGS_COUNT; i++) {
+		Bit8u *entry = data + RHYTHM_SETTINGS + 4 * i;
+		if (i % 17 == 16) {
+			// Unlike the hardware, libmt32emu only treats timbre numbers >= 127 as unmapped keys
+			entry[0] = 127;
+		} else if (i % 11 == 10) {
+			entry[0] = Bit8u(random.next(64));
+		} else {
+			entry[0] = Bit8u(64 + i % TIMBRE_R_COUNT);
+		}
+		entry[1] = Bit8u(60 + random.next(41));
+		entry[2] = Bit8u(random.next(15));
+		entry[3] = Bit8u(random.next(2));
+	}
+
+	memcpy(data + RESERVE_SETTINGS, RESERVE, sizeof(RESERVE));
+	memcpy(data + PAN_SETTINGS, PAN, sizeof(PAN));
+	memcpy(data + PROGRAM_SETTINGS, PROGRAMS, sizeof(PROGRAMS));
+	memcpy(data + RHYTHM_MAX_TABLE, RHYTHM_MAX, sizeof(RHYTHM_MAX));
+	memcpy(data + PATCH_MAX_TABLE, PATCH_MAX, sizeof(PATCH_MAX));
+	memcpy(data + SYSTEM_MAX_TABLE, SYSTEM_MAX, sizeof(SYSTEM_MAX));
+	memcpy(data + TIMBRE_MAX_TABLE, TIMBRE_MAX, sizeof(TIMBRE_MAX));
+}
+
+// The generator uses integer arithmetic only. The PCM ROM is identified by its SHA1 digest,
+// and libm functions aren't guaranteed to produce bit-identical results across platforms.
+
+// Number of phase steps per period of the sine approximation below.
+static const int SINE_PERIOD = 2048;
+
+// Log magnitude units per octave, as used by the LA32 log format.
+static const int LOG_OCTAVE = 2048;
+
+// Decay rates in LOG_OCTAVE units per PCM_REGION_LENGTH samples, approximating exp(-4t) and exp(-6t) respectively.
+static const int PERIODIC_DECAY = 11819;
+static const int NOISE_DECAY = 17728;
+
+// Returns sin(2 * pi * phase / SINE_PERIOD) scaled to [-2048, 2048], using Bhaskara I's rational approximation.
+static int sine(unsigned int phase) {
+	const int halfPeriod = SINE_PERIOD / 2;
+	int x = int(phase % SINE_PERIOD);
+	bool negative = x >= halfPeriod;
+	if (negative) x -= halfPeriod;
+	// sin(pi * x / halfPeriod) ~= 16q / (5 - 4q), where q = x * (halfPeriod - x) / halfPeriod^2, up to 0.25.
+	// Numerator and denominator are both divided by 4 to keep the scaled numerator within 32 bits.
+	Bit32u q = Bit32u(x * (halfPeriod - x));
+	int value = int((q << 13) / (5u * halfPeriod * halfPeriod / 4u - q));
+	return negative ? -value : value;
+}
+
+// Returns log2(value) in LOG_OCTAVE units, value must be positive.
+static int log2Fixed(Bit32u value) {
+	int result = 0;
+	while (value >= 0x10000) {
+		value >>= 1;
+		result += LOG_OCTAVE;
+	}
+	while (value < 0x8000) {
+		value <<= 1;
+		result -= LOG_OCTAVE;
+	}
+	// value is now a Q15 fixed-point number in [1, 2), which corresponds to log2(value) in [15, 16)
+	result += 15 * LOG_OCTAVE;
+	// Fractional bits are produced one at a time by repeated squaring
+	for (int bit = LOG_OCTAVE >> 1; bit > 0; bit >>= 1) {
+		value = (value * value) >> 15;
+		if (value >= 0x10000) {
+			value >>= 1;
+			result += bit;
+		}
+	}
+	return result;
+}
+
+// Encodes a linear sample into the sign-magnitude log format consumed by LA32WaveGenerator::pcmSampleToLogSample().
+// The attenuation is given in LOG_OCTAVE units.
+static Bit16u linearToLog(int sample, int attenuation) {
+	Bit32u magnitude = Bit32u(sample < 0 ? -sample : sample);
+	if (magnitude < 1) return 0;
+	// The LA32 unlogs logValue = (32787 - pcmMagnitude) * 2 to 2^(13 - logValue / 4096)
+	int logMagnitude = 32787 - 13 * LOG_OCTAVE + log2Fixed(magnitude) - attenuation;
+	if (logMagnitude < 0) logMagnitude = 0;
+	if (logMagnitude > 32767) logMagnitude = 32767;
+	return Bit16u((sample < 0 ? 0x8000 : 0) | logMagnitude);
+}
+
+void TestROMGenerator::generatePCMROM(Bit8u *data) {
+	// Inverse of the bit scrambling undone by Synth::loadPCMROM()
+	static const int ORDER[16] = {0, 9, 1, 2, 3, 4, 5, 6, 7, 10, 11, 12, 13, 14, 15, 8};
+
+	Random random(0x5000);
+	for (unsigned int region = 0; region < PCM_REGION_COUNT; region++) {
+		// Periods divide PCM_REGION_LENGTH / 2, so that both the full and the half-length waves loop seamlessly
+		unsigned int periods = 4 << (region % 5);
+		// Harmonic levels in twentieths of the fundamental
+		int harmonic2 = 2 * int(region % 7);
+		int harmonic3 = int(region % 3);
+		bool noise = (region % 8) == 6;
+		for (unsigned int i = 0; i < PCM_REGION_LENGTH; i++) {
+			unsigned int phase = i * periods * SINE_PERIOD / PCM_REGION_LENGTH;
+			int sample;
+			int attenuation = 0;
+			if (noise) {
+				sample = int(random.next(16384)) - 8192;
+				attenuation = int(i * NOISE_DECAY / PCM_REGION_LENGTH);
+			} else {
+				int sum = 20 * sine(phase) + harmonic2 * sine(2 * phase) + harmonic3 * sine(3 * phase);
+				sample = 7000 * sum / (2048 * 20);
+				if ((region & 1) == 0) {
+					// One-shot waves decay
+					attenuation = int(i * PERIODIC_DECAY / PCM_REGION_LENGTH);
+				}
+			}
+			Bit16u log = linearToLog(sample, attenuation);
+			Bit8u s = 0;
+			Bit8u c = 0;
+			for (int u = 0; u < 15; u++) {
+				int bit = (log >> (15 - u)) & 1;
+				if (ORDER[u] < 8) {
+					s |= Bit8u(bit << (7 - ORDER[u]));
+				} else {
+					c |= Bit8u(bit << (7 - (ORDER[u] - 8)));
+				}
+			}
+			Bit8u *p = data + 2 * (region * PCM_REGION_LENGTH + i);
+			p[0] = s;
+			p[1] = c;
+		}
+	}
+}
+
+TestROMFile::TestROMFile(Type type) {
+	if (type == CONTROL) {
+		fileSize = TEST_CONTROL_ROM_SIZE;
+		data = new unsigned char[fileSize];
+		TestROMGenerator::generateControlROM(data);
+	} else {
+		fileSize = TEST_PCM_ROM_SIZE;
+		data = new unsigned char[fileSize];
+		TestROMGenerator::generatePCMROM(data);
+	}
+}
+
+TestROMFile::~TestROMFile() {
+	delete[] data;
+}
+
+size_t TestROMFile::getSize() {
+	return fileSize;
+}
+
+const unsigned char *TestROMFile::getData() {
+	return data;
+}
+
+void TestROMFile::close() {}
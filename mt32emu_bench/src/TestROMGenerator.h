@@ -0,0 +1,56 @@
+/* Copyright (C) 2011, 2012, 2013, 2014 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MT32EMU_BENCH_TEST_ROM_GENERATOR_H
+#define MT32EMU_BENCH_TEST_ROM_GENERATOR_H
+
+#include <mt32emu/mt32emu.h>
+
+// Sizes of the generated images, matching the MT-32 layout.
+const size_t TEST_CONTROL_ROM_SIZE = 64 * 1024;
+const size_t TEST_PCM_ROM_SIZE = 512 * 1024;
+
+// Produces stand-in control and PCM ROM images which are structurally valid for libmt32emu:
+// the control ROM contains a wave map, melodic and rhythm timbre banks, rhythm setup, default settings and max tables
+// at the locations described by the matching ControlROMMap entry, the PCM ROM contains synthetic waves in the LA32 log format.
+// The images contain no Roland data whatsoever. They are only accepted by libmt32emu built with MT32EMU_ACCEPT_TEST_ROMS.
+// NOTE: The output must stay byte-exact, since the library recognises the images by SHA1 digests listed in ROMInfo.cpp.
+// Any change to the generator requires updating those digests.
+class TestROMGenerator {
+public:
+	// Fills the buffer of TEST_CONTROL_ROM_SIZE bytes.
+	static void generateControlROM(MT32Emu::Bit8u *data);
+
+	// Fills the buffer of TEST_PCM_ROM_SIZE bytes.
+	static void generatePCMROM(MT32Emu::Bit8u *data);
+};
+
+// Keeps a generated ROM image in memory, so that it can be passed to ROMImage::makeROMImage() without touching the file system.
+class TestROMFile : public MT32Emu::File {
+public:
+	enum Type {
+		CONTROL,
+		PCM
+	};
+
+	TestROMFile(Type type);
+	~TestROMFile();
+	size_t getSize();
+	const unsigned char *getData();
+	void close();
+};
+
+#endif
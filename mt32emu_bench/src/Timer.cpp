@@ -0,0 +1,83 @@
+/* Copyright (C) 2011, 2012, 2013, 2014 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Timer.h"
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#define MT32EMU_BENCH_RDTSC() __rdtsc()
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <x86intrin.h>
+#define MT32EMU_BENCH_RDTSC() __rdtsc()
+#endif
+
+bool Timer::hasCycleCounter() {
+#ifdef MT32EMU_BENCH_RDTSC
+	return true;
+#else
+	return false;
+#endif
+}
+
+double Timer::getCycles() {
+#ifdef MT32EMU_BENCH_RDTSC
+	return double(MT32EMU_BENCH_RDTSC());
+#else
+	return getNanos();
+#endif
+}
+
+#if defined(_WIN32)
+
+#include <windows.h>
+
+double Timer::getNanos() {
+	static double nanosPerCount = 0.0;
+	if (nanosPerCount == 0.0) {
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		nanosPerCount = 1e9 / double(frequency.QuadPart);
+	}
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return double(counter.QuadPart) * nanosPerCount;
+}
+
+#elif defined(__APPLE__)
+
+#include <mach/mach_time.h>
+
+double Timer::getNanos() {
+	static double nanosPerTick = 0.0;
+	if (nanosPerTick == 0.0) {
+		mach_timebase_info_data_t timebase;
+		mach_timebase_info(&timebase);
+		nanosPerTick = double(timebase.numer) / timebase.denom;
+	}
+	return double(mach_absolute_time()) * nanosPerTick;
+}
+
+#else
+
+#include <time.h>
+
+double Timer::getNanos() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return double(ts.tv_sec) * 1e9 + ts.tv_nsec;
+}
+
+#endif
@@ -0,0 +1,35 @@
+/* Copyright (C) 2011, 2012, 2013, 2014 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MT32EMU_BENCH_TIMER_H
+#define MT32EMU_BENCH_TIMER_H
+
+// Monotonic high-resolution clock used to time the benchmark runs.
+class Timer {
+public:
+	// Returns nanoseconds elapsed since an arbitrary point in the past.
+	static double getNanos();
+
+	// Returns true if getCycles() reads the CPU time stamp counter.
+	// Otherwise, getCycles() falls back to getNanos().
+	static bool hasCycleCounter();
+
+	// Returns the current value of the CPU time stamp counter. Note, modern CPUs increment it
+	// at a constant rate which may differ from the actual core clock under frequency scaling.
+	static double getCycles();
+};
+
+#endif
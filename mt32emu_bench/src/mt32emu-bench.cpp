@@ -0,0 +1,622 @@
+/* Copyright (C) 2011, 2012, 2013, 2014 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <mt32emu/mt32emu.h>
+
+#include "TestROMGenerator.h"
+#include "Timer.h"
+
+using namespace MT32Emu;
+
+static const unsigned int DEFAULT_BLOCK_SIZE = 512;
+static const double DEFAULT_DURATION = 2.0;
+
+// Rendered before the timed run to let the attack phases settle and fill the caches.
+static const double WARMUP_DURATION = 0.1;
+
+// Notes of the PCM workload are released and struck again with this period (in seconds)
+// since one-shot PCM partials would otherwise die off during the timed run.
+static const double PCM_RETRIGGER_PERIOD = 0.25;
+
+// Number of DT1 messages sent before each rendered block by the SysEx workload.
+static const unsigned int SYSEX_PER_BLOCK = 16;
+
+// The patch dump workload uploads the timbre of a part in this many DT1 messages, like the games do at startup,
+// and sends the next dump once this many blocks are rendered.
+static const unsigned int PATCH_DUMP_MESSAGES_PER_TIMBRE = 1 + 4;
+static const unsigned int PATCH_DUMP_PERIOD_BLOCKS = 4;
+
+// Capacity of the trace buffer, enough for the default runs of a single output mode.
+static const Bit32u TRACE_EVENTS_PER_BUFFER = 1 << 20;
+
+static const unsigned int PART_COUNT = 8;
+static const unsigned int PARTIALS_PER_TIMBRE = 4;
+
+// Layout of the timbre data as seen in the SysEx address space.
+static const unsigned int TIMBRE_COMMON_SIZE = 14;
+static const unsigned int TIMBRE_PARTIAL_SIZE = 58;
+static const unsigned int TIMBRE_SIZE = TIMBRE_COMMON_SIZE + 4 * TIMBRE_PARTIAL_SIZE;
+static const unsigned int TIMBRE_PARTIAL_TVF_CUTOFF_OFF = 23;
+
+static const Bit32u TIMBRE_TEMP_ADDR = 0x040000;
+static const Bit32u PATCH_TEMP_ADDR = 0x030000;
+static const Bit32u SYSTEM_ADDR = 0x100000;
+static const unsigned int PATCH_TEMP_SIZE = 16;
+static const unsigned int PATCH_TEMP_PANPOT_OFF = 9;
+
+static const char * const ANALOG_OUTPUT_MODE_NAMES[] = {"digital", "coarse", "accurate", "oversampled"};
+static const char * const DAC_INPUT_MODE_NAMES[] = {"nice", "pure", "gen1", "gen2"};
+static const char * const REVERB_MODE_NAMES[] = {"room", "hall", "plate", "tap-delay"};
+static const char * const RENDER_STAGE_NAMES[] = {"midi", "partials", "la32out", "reverb", "outconv", "analog", "resample"};
+
+enum WorkloadType {
+	// Sustained notes using square and sawtooth synth partials only.
+	WorkloadType_SYNTH,
+	// Periodically retriggered notes using PCM partials from both banks, looped and one-shot alike.
+	WorkloadType_PCM,
+	// Partial pairs ring-modulated with and without the master signal mixed in.
+	WorkloadType_RING_MOD,
+	// Synth notes accompanied by a dense stream of parameter changes via DT1 messages.
+	WorkloadType_SYSEX,
+	// Synth notes accompanied by periodic uploads of the complete timbres and patches of all the parts, split into many DT1 messages.
+	WorkloadType_PATCH_DUMP,
+	// Synth notes with the reverb mode, time and level set explicitly.
+	WorkloadType_REVERB
+};
+
+struct Workload {
+	WorkloadType type;
+	unsigned int partials;
+	int reverbMode;
+	char name[32];
+};
+
+struct Options {
+	const char *romDir;
+	bool useTestROMs;
+	bool profileStages;
+	bool voiceStatistics;
+	bool partRefreshCoalescing;
+	double duration;
+	unsigned int blockSize;
+	unsigned int partialCount;
+	int analogOutputMode;
+	int dacInputMode;
+	const char *workloadFilter;
+	const char *traceFileName;
+};
+
+struct Result {
+	Bit32u frames;
+	double nanos;
+	double averageActivePartials;
+	RenderProfile profile;
+	VoiceStatistics voiceStatistics;
+};
+
+class QuietReportHandler : public ReportHandler {
+protected:
+	void printDebug(const char * /* fmt */, va_list /* list */) {}
+	void showLCDMessage(const char * /* message */) {}
+};
+
+static void printUsage(const char *cmd) {
+	fprintf(stderr, "Usage: %s [options]\n\n", cmd);
+	fprintf(stderr, "Renders synthetic workloads and reports the realtime factor and the rendering time per output frame.\n\n");
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "  -m, --rom-dir <directory>     Directory in which ROMs are stored (including trailing path separator)\n");
+	fprintf(stderr, "  -s, --stages                  Also report the share of the rendering time spent in each stage, and the number of render slices\n");
+	fprintf(stderr, "  -v, --voices                  Also report the peak partial count, poly aborts, MIDI processing stalls, MIDI queue usage and part refreshes\n");
+	fprintf(stderr, "  -c, --coalesce-refreshes     Enable coalescing of the part refreshes caused by SysEx writes\n");
+	fprintf(stderr, "  -t, --test-roms               Use the generated synthetic ROMs rather than real ones (requires libmt32emu built with libmt32emu_WITH_TEST_ROMS)\n");
+	fprintf(stderr, "  -d, --duration <seconds>      Length of audio rendered per run (default: %.1f)\n", DEFAULT_DURATION);
+	fprintf(stderr, "  -b, --block-size <frames>     Number of frames rendered per call (default: %u)\n", DEFAULT_BLOCK_SIZE);
+	fprintf(stderr, "  -p, --partials <count>        Maximum number of partials playing simultaneously (default: %u)\n", DEFAULT_MAX_PARTIALS);
+	fprintf(stderr, "  -a, --analog-output-mode <n>  Only run the analog output mode given: 0 - digital, 1 - coarse, 2 - accurate, 3 - oversampled\n");
+	fprintf(stderr, "  -i, --dac-input-mode <n>      Only run the DAC input mode given: 0 - nice, 1 - pure, 2 - gen1, 3 - gen2\n");
+	fprintf(stderr, "  -j, --trace <file>            Record the rendering and MIDI processing events of the measured runs to a Chrome trace JSON file\n");
+	fprintf(stderr, "  -w, --workload <prefix>       Only run workloads whose name starts with the given prefix\n");
+	fprintf(stderr, "  -h, --help                    Show this help\n");
+}
+
+static bool parseUnsigned(const char *str, unsigned int &value) {
+	char *end;
+	unsigned long parsed = strtoul(str, &end, 10);
+	if (*str == '\0' || *end != '\0') return false;
+	value = (unsigned int)parsed;
+	return true;
+}
+
+static bool parseOptions(int argc, char *argv[], Options &options) {
+	options.romDir = "";
+	options.useTestROMs = false;
+	options.profileStages = false;
+	options.voiceStatistics = false;
+	options.partRefreshCoalescing = false;
+	options.duration = DEFAULT_DURATION;
+	options.blockSize = DEFAULT_BLOCK_SIZE;
+	options.partialCount = DEFAULT_MAX_PARTIALS;
+	options.analogOutputMode = -1;
+	options.dacInputMode = -1;
+	options.workloadFilter = "";
+	options.traceFileName = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+			return false;
+		}
+		if (strcmp(arg, "-t") == 0 || strcmp(arg, "--test-roms") == 0) {
+			options.useTestROMs = true;
+			continue;
+		}
+		if (strcmp(arg, "-s") == 0 || strcmp(arg, "--stages") == 0) {
+			options.profileStages = true;
+			continue;
+		}
+		if (strcmp(arg, "-v") == 0 || strcmp(arg, "--voices") == 0) {
+			options.voiceStatistics = true;
+			continue;
+		}
+		if (strcmp(arg, "-c") == 0 || strcmp(arg, "--coalesce-refreshes") == 0) {
+			options.partRefreshCoalescing = true;
+			continue;
+		}
+		if (i + 1 == argc) {
+			fprintf(stderr, "Unknown option or missing argument: %s\n", arg);
+			return false;
+		}
+		const char *value = argv[++i];
+		unsigned int number = 0;
+		if (strcmp(arg, "-m") == 0 || strcmp(arg, "--rom-dir") == 0) {
+			options.romDir = value;
+		} else if (strcmp(arg, "-d") == 0 || strcmp(arg, "--duration") == 0) {
+			options.duration = atof(value);
+			if (options.duration <= 0.0) {
+				fprintf(stderr, "Invalid duration: %s\n", value);
+				return false;
+			}
+		} else if (strcmp(arg, "-b") == 0 || strcmp(arg, "--block-size") == 0) {
+			if (!parseUnsigned(value, options.blockSize) || options.blockSize == 0) {
+				fprintf(stderr, "Invalid block size: %s\n", value);
+				return false;
+			}
+		} else if (strcmp(arg, "-p") == 0 || strcmp(arg, "--partials") == 0) {
+			if (!parseUnsigned(value, options.partialCount) || options.partialCount < PARTIALS_PER_TIMBRE) {
+				fprintf(stderr, "Invalid partial count: %s\n", value);
+				return false;
+			}
+		} else if (strcmp(arg, "-a") == 0 || strcmp(arg, "--analog-output-mode") == 0) {
+			if (!parseUnsigned(value, number) || number > AnalogOutputMode_OVERSAMPLED) {
+				fprintf(stderr, "Invalid analog output mode: %s\n", value);
+				return false;
+			}
+			options.analogOutputMode = number;
+		} else if (strcmp(arg, "-i") == 0 || strcmp(arg, "--dac-input-mode") == 0) {
+			if (!parseUnsigned(value, number) || number > DACInputMode_GENERATION2) {
+				fprintf(stderr, "Invalid DAC input mode: %s\n", value);
+				return false;
+			}
+			options.dacInputMode = number;
+		} else if (strcmp(arg, "-w") == 0 || strcmp(arg, "--workload") == 0) {
+			options.workloadFilter = value;
+		} else if (strcmp(arg, "-j") == 0 || strcmp(arg, "--trace") == 0) {
+			options.traceFileName = value;
+		} else {
+			fprintf(stderr, "Unknown option: %s\n", arg);
+			return false;
+		}
+	}
+	return true;
+}
+
+static void sendDT1(Synth &synth, Bit32u addr, const Bit8u *data, Bit32u len) {
+	Bit8u sysex[MAX_SYSEX_SIZE];
+	sysex[0] = 0xF0;
+	sysex[1] = SYSEX_MANUFACTURER_ROLAND;
+	sysex[2] = 0x10;
+	sysex[3] = SYSEX_MDL_MT32;
+	sysex[4] = SYSEX_CMD_DT1;
+	sysex[5] = Bit8u((addr >> 16) & 0x7F);
+	sysex[6] = Bit8u((addr >> 8) & 0x7F);
+	sysex[7] = Bit8u(addr & 0x7F);
+	memcpy(sysex + 8, data, len);
+	sysex[8 + len] = Synth::calcSysexChecksum(sysex + 5, len + 3);
+	sysex[9 + len] = 0xF7;
+	synth.playSysex(sysex, len + 10);
+}
+
+// Converts a linear offset into the 7-bit SysEx address space.
+static Bit32u addSysexOffset(Bit32u addr, unsigned int offset) {
+	Bit32u linear = ((addr >> 16) << 14) | (((addr >> 8) & 0x7F) << 7) | (addr & 0x7F);
+	linear += offset;
+	return ((linear >> 14) << 16) | (((linear >> 7) & 0x7F) << 8) | (linear & 0x7F);
+}
+
+static void makePartial(Bit8u *partial, Bit8u waveform, Bit8u pcmWave, unsigned int variation) {
+	static const Bit8u TEMPLATE[TIMBRE_PARTIAL_SIZE] = {
+		// WG: pitch coarse, fine, keyfollow, bender, waveform, PCM wave, pulse width, PW velo sensitivity
+		36, 50, 11, 1, 0, 0, 50, 7,
+		// Pitch envelope: depth, velo sensitivity, time keyfollow, time 1-4, level 0-4
+		2, 0, 0, 20, 30, 40, 50, 50, 55, 45, 50, 50,
+		// Pitch LFO: rate, depth, mod sensitivity
+		60, 8, 0,
+		// TVF: cutoff, resonance, keyfollow, bias point, bias level, env depth, env velo sensitivity, env depth keyfollow, env time keyfollow, env time 1-5, env level 1-4
+		70, 12, 11, 64, 7, 60, 30, 0, 0, 5, 20, 30, 40, 50, 100, 80, 70, 60,
+		// TVA: level, velo sensitivity, bias point 1, bias level 1, bias point 2, bias level 2, env time keyfollow, env time velo sensitivity, env time 1-5, env level 1-4
+		90, 50, 64, 12, 64, 12, 0, 0, 1, 20, 30, 40, 30, 100, 90, 80, 80
+	};
+	memcpy(partial, TEMPLATE, TIMBRE_PARTIAL_SIZE);
+	partial[1] = Bit8u(40 + 5 * variation); // Slight detune makes the partials of a timbre differ
+	partial[4] = waveform;
+	partial[5] = pcmWave;
+	partial[6] = Bit8u(20 + 20 * variation);
+	partial[23] = Bit8u(50 + 10 * variation);
+}
+
+static void makeTimbre(Bit8u *timbre, WorkloadType type, unsigned int partNum) {
+	memset(timbre, 0, TIMBRE_SIZE);
+	memcpy(timbre, "Bench     ", 10);
+	timbre[13] = 0; // Normal envelope mode, notes sustain
+	timbre[12] = 0x0F; // All four partials enabled
+	switch (type) {
+	case WorkloadType_PCM:
+		// Structure 6: PCM + PCM, mixed
+		timbre[10] = 5;
+		timbre[11] = 5;
+		for (unsigned int i = 0; i < 4; i++) {
+			// Waveform values 2 and 3 select the second PCM bank, where present
+			makePartial(timbre + TIMBRE_COMMON_SIZE + i * TIMBRE_PARTIAL_SIZE, Bit8u(i & 2), Bit8u((partNum * 37 + i * 29 + 3) & 0x7F), i);
+		}
+		break;
+	case WorkloadType_RING_MOD:
+		// Structure 2: synth ring-modulated by synth with the master mixed in
+		timbre[10] = 1;
+		// Structure 11: PCM ring-modulated by synth
+		timbre[11] = 10;
+		for (unsigned int i = 0; i < 4; i++) {
+			makePartial(timbre + TIMBRE_COMMON_SIZE + i * TIMBRE_PARTIAL_SIZE, Bit8u(i & 1), Bit8u((partNum * 11 + 1) & 0x7F), i);
+		}
+		break;
+	default:
+		// Structure 1: synth + synth, mixed
+		timbre[10] = 0;
+		timbre[11] = 0;
+		for (unsigned int i = 0; i < 4; i++) {
+			makePartial(timbre + TIMBRE_COMMON_SIZE + i * TIMBRE_PARTIAL_SIZE, Bit8u(i & 1), 0, i);
+		}
+		break;
+	}
+}
+
+static void setupWorkload(Synth &synth, const Workload &workload) {
+	Bit8u timbre[TIMBRE_SIZE];
+	for (unsigned int part = 0; part < PART_COUNT; part++) {
+		makeTimbre(timbre, workload.type, part);
+		sendDT1(synth, addSysexOffset(TIMBRE_TEMP_ADDR, part * TIMBRE_SIZE), timbre, TIMBRE_SIZE);
+	}
+	if (workload.type == WorkloadType_REVERB) {
+		const Bit8u reverbSettings[] = {Bit8u(workload.reverbMode), 7, 7};
+		sendDT1(synth, addSysexOffset(SYSTEM_ADDR, 1), reverbSettings, sizeof(reverbSettings));
+	}
+}
+
+// Spreads the notes among the melodic parts, which are assigned to MIDI channels 2-9 by default.
+static void playNotes(Synth &synth, const Workload &workload, bool noteOn) {
+	unsigned int noteCount = workload.partials / PARTIALS_PER_TIMBRE;
+	for (unsigned int i = 0; i < noteCount; i++) {
+		Bit32u channel = 1 + i % PART_COUNT;
+		Bit32u key = 36 + (i * 7) % 60;
+		Bit32u velocity = noteOn ? 64 + (i * 13) % 64 : 0;
+		synth.playMsg((velocity << 16) | (key << 8) | 0x90 | channel);
+	}
+}
+
+static void sendSysexBurst(Synth &synth, unsigned int blockNum) {
+	for (unsigned int i = 0; i < SYSEX_PER_BLOCK; i++) {
+		unsigned int seq = blockNum * SYSEX_PER_BLOCK + i;
+		unsigned int part = seq % PART_COUNT;
+		Bit8u value;
+		switch (seq % 3) {
+		case 0:
+			value = Bit8u(seq % 15);
+			sendDT1(synth, addSysexOffset(PATCH_TEMP_ADDR, part * PATCH_TEMP_SIZE + PATCH_TEMP_PANPOT_OFF), &value, 1);
+			break;
+		case 1:
+			value = Bit8u(40 + seq % 60);
+			sendDT1(synth, addSysexOffset(TIMBRE_TEMP_ADDR, part * TIMBRE_SIZE + TIMBRE_COMMON_SIZE + (seq & 3) * TIMBRE_PARTIAL_SIZE + TIMBRE_PARTIAL_TVF_CUTOFF_OFF), &value, 1);
+			break;
+		default:
+			value = Bit8u(seq & 7);
+			sendDT1(synth, addSysexOffset(SYSTEM_ADDR, 3), &value, 1);
+			break;
+		}
+	}
+}
+
+// Uploads the Patch Temp parameters of each part followed by its timbre in the Timbre Temp area, piecewise.
+// The timbre group and number are not written, since that would reload the timbre of the part from the timbre memory.
+static void sendPatchDump(Synth &synth, unsigned int dumpNum) {
+	Bit8u timbre[TIMBRE_SIZE];
+	for (unsigned int part = 0; part < PART_COUNT; part++) {
+		// Fine tune, bender range, assign mode, reverb switch, dummy, output level, panpot
+		const Bit8u patch[] = {50, 12, 0, 1, 0, 100, Bit8u((dumpNum + part) % 15)};
+		sendDT1(synth, addSysexOffset(PATCH_TEMP_ADDR, part * PATCH_TEMP_SIZE + PATCH_TEMP_PANPOT_OFF + 1 - sizeof(patch)), patch, sizeof(patch));
+		makeTimbre(timbre, WorkloadType_PATCH_DUMP, part);
+		// Vary the TVF cutoff between the dumps, so that each one actually changes the sound
+		for (unsigned int i = 0; i < 4; i++) {
+			timbre[TIMBRE_COMMON_SIZE + i * TIMBRE_PARTIAL_SIZE + TIMBRE_PARTIAL_TVF_CUTOFF_OFF] = Bit8u(40 + (dumpNum * 7 + i) % 60);
+		}
+		Bit32u timbreAddr = addSysexOffset(TIMBRE_TEMP_ADDR, part * TIMBRE_SIZE);
+		sendDT1(synth, timbreAddr, timbre, TIMBRE_COMMON_SIZE);
+		for (unsigned int i = 0; i < PATCH_DUMP_MESSAGES_PER_TIMBRE - 1; i++) {
+			unsigned int offset = TIMBRE_COMMON_SIZE + i * TIMBRE_PARTIAL_SIZE;
+			sendDT1(synth, addSysexOffset(timbreAddr, offset), timbre + offset, TIMBRE_PARTIAL_SIZE);
+		}
+	}
+}
+
+static unsigned int countActivePartials(const Synth &synth, PartialState *partialStates) {
+	synth.getPartialStates(partialStates);
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < synth.getPartialCount(); i++) {
+		if (partialStates[i] != PartialState_INACTIVE) count++;
+	}
+	return count;
+}
+
+static bool runWorkload(Synth &synth, TraceRecorder *traceRecorder, const ROMImage &controlROMImage, const ROMImage &pcmROMImage, const Options &options, AnalogOutputMode analogOutputMode, DACInputMode dacInputMode, const Workload &workload, Result &result) {
+	if (!synth.open(controlROMImage, pcmROMImage, options.partialCount, analogOutputMode)) {
+		fprintf(stderr, "Error opening synth.\n");
+		return false;
+	}
+	synth.setDACInputMode(dacInputMode);
+	synth.setRenderProfilingEnabled(options.profileStages);
+	synth.setPartRefreshCoalescingEnabled(options.partRefreshCoalescing);
+
+	Sample *buffer = new Sample[2 * options.blockSize];
+	PartialState *partialStates = new PartialState[synth.getPartialCount()];
+	const unsigned int sampleRate = synth.getStereoOutputSampleRate();
+	const Bit32u totalFrames = Bit32u(options.duration * sampleRate);
+	const Bit32u retriggerFrames = Bit32u(PCM_RETRIGGER_PERIOD * sampleRate);
+
+	setupWorkload(synth, workload);
+	playNotes(synth, workload, true);
+	for (Bit32u warmupFrames = Bit32u(WARMUP_DURATION * sampleRate); warmupFrames > 0;) {
+		Bit32u frames = warmupFrames < options.blockSize ? warmupFrames : options.blockSize;
+		synth.render(buffer, frames);
+		warmupFrames -= frames;
+	}
+	synth.resetRenderProfile();
+	synth.resetVoiceStatistics();
+	if (traceRecorder != NULL) traceRecorder->setEnabled(true);
+	const double traceStartNanos = TraceRecorder::getNanos();
+
+	double nanos = 0.0;
+	double activePartialsSum = 0.0;
+	Bit32u frameNum = 0;
+	Bit32u nextRetriggerFrame = retriggerFrames;
+	unsigned int blockNum = 0;
+	while (frameNum < totalFrames) {
+		Bit32u frames = totalFrames - frameNum < options.blockSize ? totalFrames - frameNum : options.blockSize;
+		double startNanos = Timer::getNanos();
+		if (workload.type == WorkloadType_SYSEX) {
+			sendSysexBurst(synth, blockNum);
+		} else if (workload.type == WorkloadType_PATCH_DUMP && blockNum % PATCH_DUMP_PERIOD_BLOCKS == 0) {
+			sendPatchDump(synth, blockNum / PATCH_DUMP_PERIOD_BLOCKS);
+		} else if (workload.type == WorkloadType_PCM && frameNum >= nextRetriggerFrame) {
+			playNotes(synth, workload, false);
+			playNotes(synth, workload, true);
+			nextRetriggerFrame += retriggerFrames;
+		}
+		synth.render(buffer, frames);
+		nanos += Timer::getNanos() - startNanos;
+		activePartialsSum += countActivePartials(synth, partialStates);
+		frameNum += frames;
+		blockNum++;
+	}
+
+	if (traceRecorder != NULL) {
+		// The workload names live as long as the recorder
+		synth.getTraceBuffer()->addCompleteEvent("bench", workload.name, traceStartNanos, "frames", totalFrames);
+		traceRecorder->setEnabled(false);
+	}
+	synth.getRenderProfile(result.profile);
+	synth.getVoiceStatistics(result.voiceStatistics);
+	delete[] partialStates;
+	delete[] buffer;
+	synth.close();
+
+	result.frames = totalFrames;
+	result.nanos = nanos;
+	result.averageActivePartials = blockNum == 0 ? 0.0 : activePartialsSum / blockNum;
+	return true;
+}
+
+static unsigned int makeWorkloads(Workload *workloads, unsigned int partialCount) {
+	unsigned int count = 0;
+	for (unsigned int partials = PARTIALS_PER_TIMBRE; partials < partialCount; partials <<= 1) {
+		workloads[count].type = WorkloadType_SYNTH;
+		workloads[count].partials = partials;
+		workloads[count].reverbMode = -1;
+		sprintf(workloads[count].name, "synth-%u", partials);
+		count++;
+	}
+	workloads[count].type = WorkloadType_SYNTH;
+	workloads[count].partials = partialCount;
+	workloads[count].reverbMode = -1;
+	sprintf(workloads[count].name, "synth-%u", partialCount);
+	count++;
+
+	workloads[count].type = WorkloadType_PCM;
+	workloads[count].partials = partialCount;
+	workloads[count].reverbMode = -1;
+	sprintf(workloads[count].name, "pcm-%u", partialCount);
+	count++;
+
+	workloads[count].type = WorkloadType_RING_MOD;
+	workloads[count].partials = partialCount;
+	workloads[count].reverbMode = -1;
+	sprintf(workloads[count].name, "ring-mod-%u", partialCount);
+	count++;
+
+	workloads[count].type = WorkloadType_SYSEX;
+	workloads[count].partials = partialCount / 2 < PARTIALS_PER_TIMBRE ? PARTIALS_PER_TIMBRE : partialCount / 2;
+	workloads[count].reverbMode = -1;
+	sprintf(workloads[count].name, "sysex-%u", SYSEX_PER_BLOCK);
+	count++;
+
+	workloads[count].type = WorkloadType_PATCH_DUMP;
+	workloads[count].partials = partialCount / 2 < PARTIALS_PER_TIMBRE ? PARTIALS_PER_TIMBRE : partialCount / 2;
+	workloads[count].reverbMode = -1;
+	sprintf(workloads[count].name, "patch-dump");
+	count++;
+
+	for (int reverbMode = REVERB_MODE_ROOM; reverbMode <= REVERB_MODE_TAP_DELAY; reverbMode++) {
+		workloads[count].type = WorkloadType_REVERB;
+		workloads[count].partials = 2 * PARTIALS_PER_TIMBRE;
+		workloads[count].reverbMode = reverbMode;
+		sprintf(workloads[count].name, "reverb-%s", REVERB_MODE_NAMES[reverbMode]);
+		count++;
+	}
+	return count;
+}
+
+static void printStages(const RenderProfile &profile) {
+	printf("    stages:");
+	for (int stage = 0; stage < RenderStage_COUNT; stage++) {
+		double share = profile.renderNanos > 0.0 ? 100.0 * profile.stageNanos[stage] / profile.renderNanos : 0.0;
+		printf(" %s %.1f%%", RENDER_STAGE_NAMES[stage], share);
+	}
+	printf(", %u slices, %.1f frames/slice\n", profile.renderSliceCount, profile.renderSliceCount == 0 ? 0.0 : double(profile.renderedSampleCount) / profile.renderSliceCount);
+}
+
+static void printVoiceStatistics(const VoiceStatistics &statistics) {
+	Bit32u polyAborts = 0;
+	for (int part = 0; part < 9; part++) {
+		polyAborts += statistics.polyAborts[part];
+	}
+	printf("    voices: %u peak partials, %u poly aborts, %u stalls", statistics.peakActivePartials, polyAborts, statistics.abortStallCount);
+	if (statistics.abortStallCount > 0) {
+		printf(" (%.1f samples average, %u max)", double(statistics.abortStallSamples) / statistics.abortStallCount, statistics.maxAbortStallSamples);
+	}
+	printf(", MIDI queue high-water mark %u, %u rejected", statistics.midiQueueHighWaterMark, statistics.rejectedMIDIEvents);
+	printf(", %u part refreshes (%u coalesced)\n", statistics.partRefreshes, statistics.coalescedPartRefreshes);
+}
+
+static bool openROM(FileStream &file, const char *romDir, const char *name1, const char *name2) {
+	if (file.open((std::string(romDir) + name1).c_str())) return true;
+	return file.open((std::string(romDir) + name2).c_str());
+}
+
+int main(int argc, char *argv[]) {
+	Options options;
+	if (!parseOptions(argc, argv, options)) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	FileStream controlROMFile;
+	FileStream pcmROMFile;
+	TestROMFile testControlROMFile(TestROMFile::CONTROL);
+	TestROMFile testPCMROMFile(TestROMFile::PCM);
+	const ROMImage *controlROMImage;
+	const ROMImage *pcmROMImage;
+	if (options.useTestROMs) {
+		controlROMImage = ROMImage::makeROMImage(&testControlROMFile);
+		pcmROMImage = ROMImage::makeROMImage(&testPCMROMFile);
+		if (controlROMImage->getROMInfo() == NULL || pcmROMImage->getROMInfo() == NULL) {
+			fprintf(stderr, "Synthetic test ROMs are not accepted, rebuild libmt32emu with libmt32emu_WITH_TEST_ROMS enabled.\n");
+			ROMImage::freeROMImage(controlROMImage);
+			ROMImage::freeROMImage(pcmROMImage);
+			return 1;
+		}
+	} else {
+		if (!openROM(controlROMFile, options.romDir, "CM32L_CONTROL.ROM", "MT32_CONTROL.ROM")) {
+			fprintf(stderr, "Control ROM not found.\n");
+			return 1;
+		}
+		if (!openROM(pcmROMFile, options.romDir, "CM32L_PCM.ROM", "MT32_PCM.ROM")) {
+			fprintf(stderr, "PCM ROM not found.\n");
+			return 1;
+		}
+		controlROMImage = ROMImage::makeROMImage(&controlROMFile);
+		pcmROMImage = ROMImage::makeROMImage(&pcmROMFile);
+	}
+
+	// Synth workloads double the partial count each step, add the fixed workloads and a little room to spare
+	Workload workloads[48];
+	unsigned int workloadCount = makeWorkloads(workloads, options.partialCount);
+
+	QuietReportHandler reportHandler;
+	Synth synth(&reportHandler);
+	TraceRecorder *traceRecorder = NULL;
+	if (options.traceFileName != NULL) {
+		traceRecorder = new TraceRecorder(TRACE_EVENTS_PER_BUFFER);
+		synth.setTraceBuffer(traceRecorder->createBuffer("Rendering"));
+	}
+	int exitCode = 0;
+	size_t filterLength = strlen(options.workloadFilter);
+
+	printf("%-12s %-5s %-16s %9s %10s %12s\n", "analog", "dac", "workload", "partials", "realtime", "ns/frame");
+	for (int analogOutputMode = AnalogOutputMode_DIGITAL_ONLY; analogOutputMode <= AnalogOutputMode_OVERSAMPLED && exitCode == 0; analogOutputMode++) {
+		if (options.analogOutputMode >= 0 && options.analogOutputMode != analogOutputMode) continue;
+		for (int dacInputMode = DACInputMode_NICE; dacInputMode <= DACInputMode_GENERATION2 && exitCode == 0; dacInputMode++) {
+			if (options.dacInputMode >= 0 && options.dacInputMode != dacInputMode) continue;
+			for (unsigned int i = 0; i < workloadCount; i++) {
+				if (strncmp(workloads[i].name, options.workloadFilter, filterLength) != 0) continue;
+				Result result;
+				if (!runWorkload(synth, traceRecorder, *controlROMImage, *pcmROMImage, options, AnalogOutputMode(analogOutputMode), DACInputMode(dacInputMode), workloads[i], result)) {
+					exitCode = 1;
+					break;
+				}
+				double seconds = result.nanos / 1e9;
+				double audioSeconds = options.duration;
+				printf("%-12s %-5s %-16s %9.1f %9.1fx %12.1f\n", ANALOG_OUTPUT_MODE_NAMES[analogOutputMode], DAC_INPUT_MODE_NAMES[dacInputMode], workloads[i].name,
+					result.averageActivePartials, seconds > 0.0 ? audioSeconds / seconds : 0.0, result.frames == 0 ? 0.0 : result.nanos / result.frames);
+				if (options.profileStages) printStages(result.profile);
+				if (options.voiceStatistics) printVoiceStatistics(result.voiceStatistics);
+				fflush(stdout);
+			}
+		}
+	}
+
+	if (RealtimeChecker::isAvailable()) {
+		printf("Realtime violations detected while rendering: %u\n", RealtimeChecker::getViolationCount());
+	}
+	if (traceRecorder != NULL) {
+		if (exitCode == 0) {
+			if (traceRecorder->writeJSON(options.traceFileName)) {
+				printf("Trace of %u events written to %s", traceRecorder->getEventCount(), options.traceFileName);
+				if (traceRecorder->getDroppedEventCount() > 0) printf(", %u events dropped as the buffer filled up", traceRecorder->getDroppedEventCount());
+				printf("\n");
+			} else {
+				fprintf(stderr, "Error writing trace file %s.\n", options.traceFileName);
+				exitCode = 1;
+			}
+		}
+		delete traceRecorder;
+	}
+	ROMImage::freeROMImage(controlROMImage);
+	ROMImage::freeROMImage(pcmROMImage);
+	return exitCode;
+}
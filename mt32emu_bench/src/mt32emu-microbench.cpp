@@ -0,0 +1,683 @@
+/* Copyright (C) 2011, 2012, 2013, 2014 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Microbenchmarks exercising the engine components in isolation.
+// As these reach into the library internals, the program is built against the library sources rather than the installed headers.
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "mt32emu.h"
+#include "mmath.h"
+#include "internals.h"
+#include "Analog.h"
+#include "BReverbModel.h"
+#include "MidiEventQueue.h"
+
+#include "TestROMGenerator.h"
+#include "Timer.h"
+
+using namespace MT32Emu;
+
+// Each benchmark is repeated this many times and the fastest repetition is reported.
+static const unsigned int REPETITIONS = 5;
+
+static const unsigned int DEFAULT_SAMPLE_COUNT = 1 << 20;
+static const unsigned int BLOCK_SIZE = 256;
+static const unsigned int PCM_WAVE_LENGTH = 4096;
+static const unsigned int MIDI_STREAM_EVENT_COUNT = 4096;
+
+static const char * const REVERB_MODE_NAMES[] = {"room", "hall", "plate", "tap-delay"};
+static const char * const ANALOG_OUTPUT_MODE_NAMES[] = {"null", "coarse", "accurate", "oversampled"};
+
+// Results of the computations are accumulated here, so that the compiler is unable to discard them.
+static volatile Bit32u sink;
+
+static Bit16s pcmWave[PCM_WAVE_LENGTH];
+
+struct Options {
+	const char *romDir;
+	unsigned int sampleCount;
+	const char *filter;
+};
+
+class QuietReportHandler : public ReportHandler {
+protected:
+	void printDebug(const char * /* fmt */, va_list /* list */) {}
+	void showLCDMessage(const char * /* message */) {}
+};
+
+class NullMidiStreamParser : public MidiStreamParser {
+public:
+	unsigned int eventCount;
+
+	NullMidiStreamParser() : eventCount(0) {}
+
+protected:
+	void handleShortMessage(const Bit32u message) {
+		sink += message;
+		eventCount++;
+	}
+
+	void handleSysex(const Bit8u stream[], const Bit32u length) {
+		sink += stream[length - 2];
+		eventCount++;
+	}
+
+	void handleSytemRealtimeMessage(const Bit8u realtime) {
+		sink += realtime;
+		eventCount++;
+	}
+
+	void printDebug(const char * /* debugMessage */) {}
+};
+
+// Common driver, the derived classes implement a single run over the given number of units.
+class Benchmark {
+public:
+	const char * const group;
+	const char * const name;
+
+	Benchmark(const char *useGroup, const char *useName) : group(useGroup), name(useName) {}
+	virtual ~Benchmark() {}
+
+	// Prepares the state for a run, excluded from the measurement.
+	virtual void setUp() {}
+
+	// Returns the number of units (samples or events) processed.
+	virtual unsigned int run(unsigned int sampleCount) = 0;
+
+	virtual void tearDown() {}
+
+	virtual const char *getUnitName() const {
+		return "sample";
+	}
+};
+
+class LA32PairBenchmark : public Benchmark {
+public:
+	enum Kind {
+		SQUARE,
+		SAWTOOTH,
+		PCM_LOOPED,
+		PCM_UNLOOPED,
+		RING_MODULATED
+	};
+
+private:
+	const Kind kind;
+	LA32PartialPair pair;
+
+	void init() {
+		pair.init(kind == RING_MODULATED, kind == RING_MODULATED);
+		switch (kind) {
+		case PCM_LOOPED:
+		case PCM_UNLOOPED:
+			pair.initPCM(LA32PartialPair::MASTER, pcmWave, PCM_WAVE_LENGTH, kind == PCM_LOOPED);
+			pair.deactivate(LA32PartialPair::SLAVE);
+			break;
+		case RING_MODULATED:
+			pair.initSynth(LA32PartialPair::MASTER, false, 128, 16);
+			pair.initSynth(LA32PartialPair::SLAVE, true, 64, 8);
+			break;
+		default:
+			pair.initSynth(LA32PartialPair::MASTER, kind == SAWTOOTH, 128, 16);
+			pair.deactivate(LA32PartialPair::SLAVE);
+			break;
+		}
+	}
+
+public:
+	LA32PairBenchmark(const char *useName, Kind useKind) : Benchmark("LA32PartialPair", useName), kind(useKind) {}
+
+	void setUp() {
+		init();
+	}
+
+	unsigned int run(unsigned int sampleCount) {
+		Bit32u acc = 0;
+		for (unsigned int i = 0; i < sampleCount; i++) {
+			// Sweeping amp, pitch and cutoff a little keeps the generator away from trivial steady states
+			Bit32u amp = 0x00C00000 + ((i & 0xFFF) << 10);
+			Bit16u pitch = Bit16u(0x8800 + (i & 0x7FF));
+			Bit32u cutoff = (120 + ((i >> 8) & 0x3F)) << 18;
+			pair.generateNextSample(LA32PartialPair::MASTER, amp, pitch, cutoff);
+			if (kind == RING_MODULATED) {
+				pair.generateNextSample(LA32PartialPair::SLAVE, amp, Bit16u(pitch + 0x400), cutoff);
+			}
+			acc += pair.nextOutSample();
+			if (!pair.isActive(LA32PartialPair::MASTER)) {
+				// One-shot PCM ran out, retrigger as a new partial would do
+				init();
+			}
+		}
+		sink += acc;
+		return sampleCount;
+	}
+};
+
+class LA32RampBenchmark : public Benchmark {
+private:
+	LA32Ramp ramp;
+
+public:
+	LA32RampBenchmark() : Benchmark("LA32Ramp", "ramp") {}
+
+	void setUp() {
+		ramp.reset();
+		ramp.startRamp(255, 0x10);
+	}
+
+	unsigned int run(unsigned int sampleCount) {
+		Bit32u acc = 0;
+		Bit8u target = 0;
+		for (unsigned int i = 0; i < sampleCount; i++) {
+			acc += ramp.nextValue();
+			if (ramp.checkInterrupt()) {
+				// Bounce between the extremes with varying rates, like a sequence of envelope phases
+				target = ~target;
+				ramp.startRamp(target, Bit8u((target ? 0x00 : 0x80) | (1 + (i & 0x3F))));
+			}
+		}
+		sink += acc;
+		return sampleCount;
+	}
+};
+
+// Owns the memory a standalone partial places its envelope generators into, PartialManager provides it from the arena otherwise.
+class EnvelopeStorage {
+private:
+	Bit8u * const storage;
+
+public:
+	EnvelopeStorage() : storage(new Bit8u[Partial::getEnvelopeStorageSize()]) {}
+
+	~EnvelopeStorage() {
+		delete[] storage;
+	}
+
+	void *get() const {
+		return storage;
+	}
+};
+
+// Sets up a partial with a synthetic timbre on an opened synth, so that TVA, TVP and TVF have everything they read from.
+class EnvelopeContext {
+private:
+	Part part;
+	Poly poly;
+	EnvelopeStorage envelopeStorage;
+	PatchCache cachebackup;
+	Partial partial;
+	PatchCache patchCache;
+	TimbreParam::PartialParam partialParam;
+
+public:
+	EnvelopeContext(Synth *synth) : part(synth, 0), partial(synth, 0, envelopeStorage.get(), &cachebackup) {
+		static const Bit8u PARTIAL_PARAM[] = {
+			36, 50, 11, 1, 0, 0, 50, 7,
+			2, 0, 0, 20, 30, 40, 50, 50, 55, 45, 50, 50,
+			60, 8, 0,
+			70, 12, 11, 64, 7, 60, 30, 0, 0, 5, 20, 30, 40, 50, 100, 80, 70, 60,
+			90, 50, 64, 12, 64, 12, 0, 0, 1, 20, 30, 40, 30, 100, 90, 80, 80
+		};
+		memcpy(&partialParam, PARTIAL_PARAM, sizeof(partialParam));
+		memset(&patchCache, 0, sizeof(patchCache));
+		patchCache.playPartial = true;
+		patchCache.partialCount = 1;
+		patchCache.sustain = true;
+		patchCache.srcPartial = partialParam;
+		patchCache.partialParam = &partialParam;
+
+		Partial *partials[4] = {&partial, NULL, NULL, NULL};
+		poly.setPart(&part);
+		poly.reset(60, 100, true, partials);
+		partial.activate(0);
+		partial.startPartial(&part, &poly, &patchCache, NULL, NULL);
+	}
+
+	const Part *getPart() const {
+		return &part;
+	}
+
+	const Partial *getPartial() const {
+		return &partial;
+	}
+
+	const TimbreParam::PartialParam *getPartialParam() const {
+		return &partialParam;
+	}
+};
+
+class EnvelopeBenchmark : public Benchmark {
+public:
+	enum Kind {
+		TVA_STEPPING,
+		TVP_STEPPING,
+		TVF_STEPPING
+	};
+
+private:
+	const Kind kind;
+	Synth * const synth;
+	EnvelopeContext *context;
+	LA32Ramp ramp;
+	TVA *tva;
+	TVP *tvp;
+	TVF *tvf;
+
+public:
+	EnvelopeBenchmark(const char *useName, Kind useKind, Synth *useSynth) : Benchmark("Envelope", useName), kind(useKind), synth(useSynth),
+		context(NULL), tva(NULL), tvp(NULL), tvf(NULL) {}
+
+	void setUp() {
+		context = new EnvelopeContext(synth);
+		tva = new TVA(context->getPartial(), &ramp);
+		tvp = new TVP(context->getPartial());
+		tvf = new TVF(context->getPartial(), &ramp);
+		ramp.reset();
+		tva->reset(context->getPart(), context->getPartialParam(), NULL);
+		tvp->reset(context->getPart(), context->getPartialParam());
+		tvf->reset(context->getPartialParam(), tvp->getBasePitch());
+	}
+
+	void tearDown() {
+		delete tvf;
+		delete tvp;
+		delete tva;
+		delete context;
+	}
+
+	unsigned int run(unsigned int sampleCount) {
+		Bit32u acc = 0;
+		for (unsigned int i = 0; i < sampleCount; i++) {
+			switch (kind) {
+			case TVA_STEPPING:
+				acc += ramp.nextValue();
+				if (ramp.checkInterrupt()) {
+					tva->handleInterrupt();
+				}
+				if ((i & 0x3FFF) == 0x2000) {
+					tva->startDecay();
+				} else if ((i & 0x3FFF) == 0) {
+					tva->reset(context->getPart(), context->getPartialParam(), NULL);
+				}
+				break;
+			case TVP_STEPPING:
+				acc += tvp->nextPitch();
+				if ((i & 0x3FFF) == 0x2000) {
+					tvp->startDecay();
+				} else if ((i & 0x3FFF) == 0) {
+					tvp->reset(context->getPart(), context->getPartialParam());
+				}
+				break;
+			case TVF_STEPPING:
+				acc += ramp.nextValue() + tvf->getBaseCutoff();
+				if (ramp.checkInterrupt()) {
+					tvf->handleInterrupt();
+				}
+				if ((i & 0x3FFF) == 0x2000) {
+					tvf->startDecay();
+				} else if ((i & 0x3FFF) == 0) {
+					tvf->reset(context->getPartialParam(), tvp->getBasePitch());
+				}
+				break;
+			}
+		}
+		sink += acc;
+		return sampleCount;
+	}
+};
+
+class ReverbBenchmark : public Benchmark {
+private:
+	const ReverbMode mode;
+	BReverbModel *model;
+	Sample inLeft[BLOCK_SIZE], inRight[BLOCK_SIZE], outLeft[BLOCK_SIZE], outRight[BLOCK_SIZE];
+
+public:
+	ReverbBenchmark(ReverbMode useMode) : Benchmark("BReverbModel", REVERB_MODE_NAMES[useMode]), mode(useMode), model(NULL) {
+		for (unsigned int i = 0; i < BLOCK_SIZE; i++) {
+			inLeft[i] = pcmWave[i];
+			inRight[i] = pcmWave[(i * 3) % PCM_WAVE_LENGTH];
+		}
+	}
+
+	void setUp() {
+		model = new BReverbModel(mode);
+		model->open();
+		model->setParameters(7, 7);
+	}
+
+	void tearDown() {
+		model->close();
+		delete model;
+	}
+
+	unsigned int run(unsigned int sampleCount) {
+		unsigned int blockCount = sampleCount / BLOCK_SIZE;
+		for (unsigned int i = 0; i < blockCount; i++) {
+			model->process(inLeft, inRight, outLeft, outRight, BLOCK_SIZE);
+		}
+		sink += Bit32u(outLeft[BLOCK_SIZE - 1] + outRight[BLOCK_SIZE - 1]);
+		return blockCount * BLOCK_SIZE;
+	}
+};
+
+// AbstractLowPassFilter implementations are private to Analog.cpp, so they are measured through Analog
+// which drives a pair of them. Cost of the gain stage is negligible in comparison.
+class LowPassFilterBenchmark : public Benchmark {
+private:
+	const AnalogOutputMode mode;
+	const ControlROMFeatureSet features;
+	Analog *analog;
+	Sample in[BLOCK_SIZE], silence[BLOCK_SIZE];
+	Sample out[2 * 3 * BLOCK_SIZE];
+
+public:
+	LowPassFilterBenchmark(AnalogOutputMode useMode) : Benchmark("LowPassFilter", ANALOG_OUTPUT_MODE_NAMES[useMode]), mode(useMode), features(false, false), analog(NULL) {
+		for (unsigned int i = 0; i < BLOCK_SIZE; i++) {
+			in[i] = pcmWave[i];
+			silence[i] = 0;
+		}
+	}
+
+	void setUp() {
+		analog = new Analog(mode, &features);
+		analog->setSynthOutputGain(1.0f);
+		analog->setReverbOutputGain(1.0f, false);
+	}
+
+	void tearDown() {
+		delete analog;
+	}
+
+	unsigned int run(unsigned int sampleCount) {
+		// Output length is chosen so that the filter never consumes more than BLOCK_SIZE input samples.
+		Bit32u outLength = BLOCK_SIZE * analog->getOutputSampleRate() / SAMPLE_RATE;
+		while (analog->getDACStreamsLength(outLength) > BLOCK_SIZE) {
+			outLength--;
+		}
+		unsigned int processed = 0;
+		while (processed < sampleCount) {
+			Sample *outStream = out;
+			analog->process(&outStream, in, in, silence, silence, in, in, outLength);
+			processed += outLength;
+		}
+		sink += Bit32u(out[0]);
+		return processed;
+	}
+};
+
+class MidiStreamParserBenchmark : public Benchmark {
+private:
+	Bit8u stream[MIDI_STREAM_EVENT_COUNT * 4];
+	Bit32u streamLength;
+	unsigned int streamEventCount;
+
+public:
+	MidiStreamParserBenchmark() : Benchmark("MidiStreamParser", "parseStream"), streamLength(0), streamEventCount(0) {
+		// A mix of note events with and without running status, controllers, short SysEx and realtime bytes
+		static const Bit8u SYSEX[] = {0xF0, 0x41, 0x10, 0x16, 0x12, 0x10, 0x00, 0x03, 0x05, 0x68, 0xF7};
+		while (streamLength + sizeof(SYSEX) + 4 <= sizeof(stream)) {
+			unsigned int n = streamEventCount;
+			switch (n % 8) {
+			case 0:
+				stream[streamLength++] = Bit8u(0x91 + (n & 7));
+				// Fall-through
+			case 1:
+			case 2:
+				stream[streamLength++] = Bit8u(36 + n % 60);
+				stream[streamLength++] = Bit8u(n & 0x7F);
+				break;
+			case 3:
+				stream[streamLength++] = 0xF8;
+				break;
+			case 4:
+				stream[streamLength++] = Bit8u(0xB1 + (n & 7));
+				stream[streamLength++] = 0x07;
+				stream[streamLength++] = Bit8u(n & 0x7F);
+				break;
+			case 5:
+				memcpy(stream + streamLength, SYSEX, sizeof(SYSEX));
+				streamLength += sizeof(SYSEX);
+				break;
+			default:
+				stream[streamLength++] = Bit8u(0xE1 + (n & 7));
+				stream[streamLength++] = Bit8u(n & 0x7F);
+				stream[streamLength++] = 0x40;
+				break;
+			}
+			streamEventCount++;
+		}
+	}
+
+	unsigned int run(unsigned int sampleCount) {
+		NullMidiStreamParser parser;
+		unsigned int passCount = sampleCount / streamEventCount + 1;
+		for (unsigned int i = 0; i < passCount; i++) {
+			parser.parseStream(stream, streamLength);
+		}
+		return parser.eventCount;
+	}
+
+	const char *getUnitName() const {
+		return "event";
+	}
+};
+
+class MidiEventQueueBenchmark : public Benchmark {
+private:
+	const bool sysex;
+	MidiEventQueue *queue;
+
+public:
+	MidiEventQueueBenchmark(const char *useName, bool useSysex) : Benchmark("MidiEventQueue", useName), sysex(useSysex), queue(NULL) {}
+
+	void setUp() {
+		queue = new MidiEventQueue;
+	}
+
+	void tearDown() {
+		delete queue;
+	}
+
+	unsigned int run(unsigned int sampleCount) {
+		static const Bit8u SYSEX[] = {0x41, 0x10, 0x16, 0x12, 0x10, 0x00, 0x03, 0x05, 0x68};
+		unsigned int eventCount = 0;
+		Bit32u timestamp = 0;
+		while (eventCount < sampleCount) {
+			// Fill the queue up and drain it completely, as a render pass would
+			while (!queue->isFull()) {
+				if (sysex) {
+					queue->pushSysex(SYSEX, sizeof(SYSEX), timestamp++);
+				} else {
+					queue->pushShortMessage(0x00403C91, timestamp++);
+				}
+			}
+			const MidiEvent *event;
+			while ((event = queue->peekMidiEvent()) != NULL) {
+				sink += event->timestamp;
+				queue->dropMidiEvent();
+				eventCount++;
+			}
+		}
+		return eventCount;
+	}
+
+	const char *getUnitName() const {
+		return "event";
+	}
+};
+
+static void printUsage(const char *cmd) {
+	fprintf(stderr, "Usage: %s [options]\n\n", cmd);
+	fprintf(stderr, "Measures the engine components in isolation and reports %s per sample or event.\n\n", Timer::hasCycleCounter() ? "TSC cycles" : "nanoseconds");
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "  -m, --rom-dir <directory>  Directory in which ROMs are stored (including trailing path separator),\n");
+	fprintf(stderr, "                             used by the envelope benchmarks only; the generated synthetic ROMs\n");
+	fprintf(stderr, "                             are used if omitted (requires libmt32emu_WITH_TEST_ROMS)\n");
+	fprintf(stderr, "  -n, --samples <count>      Number of samples or events processed per repetition (default: %u)\n", DEFAULT_SAMPLE_COUNT);
+	fprintf(stderr, "  -f, --filter <prefix>      Only run benchmarks whose group starts with the given prefix\n");
+	fprintf(stderr, "  -h, --help                 Show this help\n");
+}
+
+static bool parseOptions(int argc, char *argv[], Options &options) {
+	options.romDir = NULL;
+	options.sampleCount = DEFAULT_SAMPLE_COUNT;
+	options.filter = "";
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+			return false;
+		}
+		if (i + 1 == argc) {
+			fprintf(stderr, "Unknown option or missing argument: %s\n", arg);
+			return false;
+		}
+		const char *value = argv[++i];
+		if (strcmp(arg, "-m") == 0 || strcmp(arg, "--rom-dir") == 0) {
+			options.romDir = value;
+		} else if (strcmp(arg, "-n") == 0 || strcmp(arg, "--samples") == 0) {
+			char *end;
+			options.sampleCount = (unsigned int)strtoul(value, &end, 10);
+			if (*end != '\0' || options.sampleCount < BLOCK_SIZE) {
+				fprintf(stderr, "Invalid sample count: %s\n", value);
+				return false;
+			}
+		} else if (strcmp(arg, "-f") == 0 || strcmp(arg, "--filter") == 0) {
+			options.filter = value;
+		} else {
+			fprintf(stderr, "Unknown option: %s\n", arg);
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool openROM(FileStream &file, const char *romDir, const char *name1, const char *name2) {
+	if (file.open((std::string(romDir) + name1).c_str())) return true;
+	return file.open((std::string(romDir) + name2).c_str());
+}
+
+static void runBenchmark(Benchmark &benchmark, const Options &options) {
+	if (strncmp(benchmark.group, options.filter, strlen(options.filter)) != 0) return;
+	double bestCyclesPerUnit = 0.0;
+	for (unsigned int i = 0; i < REPETITIONS; i++) {
+		benchmark.setUp();
+		double startCycles = Timer::getCycles();
+		unsigned int units = benchmark.run(options.sampleCount);
+		double cycles = Timer::getCycles() - startCycles;
+		benchmark.tearDown();
+		double cyclesPerUnit = units == 0 ? 0.0 : cycles / units;
+		if (i == 0 || cyclesPerUnit < bestCyclesPerUnit) {
+			bestCyclesPerUnit = cyclesPerUnit;
+		}
+	}
+	printf("%-18s %-14s %12.2f %s/%s\n", benchmark.group, benchmark.name, bestCyclesPerUnit, Timer::hasCycleCounter() ? "cycles" : "ns", benchmark.getUnitName());
+	fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+	Options options;
+	if (!parseOptions(argc, argv, options)) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	for (unsigned int i = 0; i < PCM_WAVE_LENGTH; i++) {
+		// A decaying pair of partials resembles a recorded instrument sample closely enough
+		double t = double(i) / PCM_WAVE_LENGTH;
+		pcmWave[i] = Bit16s(20000.0 * exp(-2.0 * t) * (sin(2.0 * FLOAT_PI * 32.0 * t) + 0.3 * sin(2.0 * FLOAT_PI * 97.0 * t)) / 1.3);
+	}
+
+	LA32PairBenchmark square("square", LA32PairBenchmark::SQUARE);
+	LA32PairBenchmark sawtooth("sawtooth", LA32PairBenchmark::SAWTOOTH);
+	LA32PairBenchmark pcmLooped("pcm-looped", LA32PairBenchmark::PCM_LOOPED);
+	LA32PairBenchmark pcmUnlooped("pcm-unlooped", LA32PairBenchmark::PCM_UNLOOPED);
+	LA32PairBenchmark ringModulated("ring-modulated", LA32PairBenchmark::RING_MODULATED);
+	runBenchmark(square, options);
+	runBenchmark(sawtooth, options);
+	runBenchmark(pcmLooped, options);
+	runBenchmark(pcmUnlooped, options);
+	runBenchmark(ringModulated, options);
+
+	LA32RampBenchmark ramp;
+	runBenchmark(ramp, options);
+
+	{
+		FileStream controlROMFile;
+		FileStream pcmROMFile;
+		TestROMFile testControlROMFile(TestROMFile::CONTROL);
+		TestROMFile testPCMROMFile(TestROMFile::PCM);
+		const ROMImage *controlROMImage;
+		const ROMImage *pcmROMImage;
+		if (options.romDir != NULL) {
+			if (!openROM(controlROMFile, options.romDir, "CM32L_CONTROL.ROM", "MT32_CONTROL.ROM") || !openROM(pcmROMFile, options.romDir, "CM32L_PCM.ROM", "MT32_PCM.ROM")) {
+				fprintf(stderr, "ROMs not found.\n");
+				return 1;
+			}
+			controlROMImage = ROMImage::makeROMImage(&controlROMFile);
+			pcmROMImage = ROMImage::makeROMImage(&pcmROMFile);
+		} else {
+			controlROMImage = ROMImage::makeROMImage(&testControlROMFile);
+			pcmROMImage = ROMImage::makeROMImage(&testPCMROMFile);
+		}
+		QuietReportHandler reportHandler;
+		Synth synth(&reportHandler);
+		if (synth.open(*controlROMImage, *pcmROMImage)) {
+			EnvelopeBenchmark tva("TVA", EnvelopeBenchmark::TVA_STEPPING, &synth);
+			EnvelopeBenchmark tvp("TVP", EnvelopeBenchmark::TVP_STEPPING, &synth);
+			EnvelopeBenchmark tvf("TVF", EnvelopeBenchmark::TVF_STEPPING, &synth);
+			runBenchmark(tva, options);
+			runBenchmark(tvp, options);
+			runBenchmark(tvf, options);
+			synth.close();
+		} else if (options.romDir != NULL) {
+			fprintf(stderr, "Error opening synth.\n");
+			return 1;
+		} else {
+			fprintf(stderr, "Synthetic test ROMs are not accepted, skipping envelope benchmarks. Specify a ROM directory or rebuild libmt32emu with libmt32emu_WITH_TEST_ROMS enabled.\n");
+		}
+		ROMImage::freeROMImage(controlROMImage);
+		ROMImage::freeROMImage(pcmROMImage);
+	}
+
+	for (int mode = REVERB_MODE_ROOM; mode <= REVERB_MODE_TAP_DELAY; mode++) {
+		ReverbBenchmark reverb((ReverbMode)mode);
+		runBenchmark(reverb, options);
+	}
+
+	for (int mode = AnalogOutputMode_DIGITAL_ONLY; mode <= AnalogOutputMode_OVERSAMPLED; mode++) {
+		LowPassFilterBenchmark lpf((AnalogOutputMode)mode);
+		runBenchmark(lpf, options);
+	}
+
+	MidiStreamParserBenchmark parser;
+	runBenchmark(parser, options);
+
+	MidiEventQueueBenchmark queueShort("short", false);
+	MidiEventQueueBenchmark queueSysex("sysex", true);
+	runBenchmark(queueShort, options);
+	runBenchmark(queueSysex, options);
+
+	return 0;
+}
@@ -0,0 +1,52 @@
+/* Copyright (C) 2011, 2012, 2013, 2014 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Writes the synthetic test ROMs as MT32_CONTROL.ROM and MT32_PCM.ROM, so that any program using libmt32emu
+// built with MT32EMU_ACCEPT_TEST_ROMS can load them from a ROM directory.
+
+#include <cstdio>
+#include <string>
+
+#include "TestROMGenerator.h"
+
+static bool writeROM(const std::string &pathName, MT32Emu::File &file) {
+	FILE *out = fopen(pathName.c_str(), "wb");
+	if (out == NULL) {
+		fprintf(stderr, "Unable to open %s for writing.\n", pathName.c_str());
+		return false;
+	}
+	bool written = fwrite(file.getData(), 1, file.getSize(), out) == file.getSize();
+	if (fclose(out) != 0 || !written) {
+		fprintf(stderr, "Error writing %s.\n", pathName.c_str());
+		return false;
+	}
+	printf("%s: %s\n", pathName.c_str(), file.getSHA1());
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc > 2 || (argc == 2 && argv[1][0] == '-')) {
+		fprintf(stderr, "Usage: %s [<output directory, including trailing path separator>]\n", argv[0]);
+		return 1;
+	}
+	std::string romDir = argc == 2 ? argv[1] : "";
+	TestROMFile controlROMFile(TestROMFile::CONTROL);
+	TestROMFile pcmROMFile(TestROMFile::PCM);
+	if (!writeROM(romDir + "MT32_CONTROL.ROM", controlROMFile) || !writeROM(romDir + "MT32_PCM.ROM", pcmROMFile)) {
+		return 1;
+	}
+	return 0;
+}
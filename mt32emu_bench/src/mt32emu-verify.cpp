@@ -0,0 +1,634 @@
+/* Copyright (C) 2011, 2012, 2013, 2014 Dean Beeler, Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Differential verification of the rendered output. Since a program can only link a single libmt32emu,
+// the reference build records a capture of the output produced for a fixed MIDI stimulus, and the optimised build
+// renders the same stimulus and compares its output against the capture sample by sample.
+// Both the DAC entrance streams (renderStreams) and the analog output (render) are captured,
+// the former for every DAC input mode, the latter for every combination of DAC input and analog output mode.
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <mt32emu/mt32emu.h>
+
+#include "TestROMGenerator.h"
+
+using namespace MT32Emu;
+
+static const char CAPTURE_MAGIC[8] = {'M', 'T', '3', '2', 'V', 'R', 'F', 'Y'};
+static const Bit32u CAPTURE_VERSION = 1;
+static const Bit32u BYTE_ORDER_MARK = 0x01020304;
+
+static const double DEFAULT_DURATION = 4.0;
+
+// Number of frames at the DAC sample rate rendered per call. MIDI events are only sent between chunks,
+// and partial states are captured after each chunk, so this also sets the resolution of the divergence report.
+static const unsigned int CHUNK_FRAMES = 64;
+
+static const unsigned int STREAM_COUNT = 6;
+static const unsigned int PART_COUNT = 9;
+static const Bit8u RHYTHM_CHANNEL = 9;
+
+static const unsigned int TIMBRE_COMMON_SIZE = 14;
+static const unsigned int TIMBRE_PARTIAL_SIZE = 58;
+static const Bit32u TIMBRE_TEMP_ADDR = 0x040000;
+static const unsigned int TIMBRE_TEMP_SIZE = 246;
+static const Bit32u PATCH_TEMP_ADDR = 0x030000;
+static const unsigned int PATCH_TEMP_SIZE = 16;
+static const Bit32u SYSTEM_ADDR = 0x100000;
+
+static const char * const ANALOG_OUTPUT_MODE_NAMES[] = {"digital", "coarse", "accurate", "oversampled"};
+static const char * const DAC_INPUT_MODE_NAMES[] = {"nice", "pure", "gen1", "gen2"};
+static const char * const STREAM_NAMES[] = {"nonReverbLeft", "nonReverbRight", "reverbDryLeft", "reverbDryRight", "reverbWetLeft", "reverbWetRight"};
+static const char * const OUTPUT_CHANNEL_NAMES[] = {"left", "right"};
+static const char * const PARTIAL_STATE_NAMES[] = {"inactive", "attack", "sustain", "release"};
+
+enum RunType {
+	// Six streams at the DAC entrance as produced by renderStreams(), interleaved per frame.
+	RunType_STREAMS,
+	// Stereo analog output as produced by render().
+	RunType_OUTPUT
+};
+
+struct Options {
+	const char *romDir;
+	bool useTestROMs;
+	bool partRefreshCoalescing;
+	const char *recordFileName;
+	const char *compareFileName;
+	double duration;
+};
+
+struct CaptureHeader {
+	char magic[8];
+	Bit32u version;
+	Bit32u byteOrderMark;
+	Bit32u sampleSize;
+	Bit32u partialCount;
+	Bit32u chunkCount;
+	Bit32u runCount;
+	char controlROMDigest[41];
+	char pcmROMDigest[41];
+};
+
+struct RunHeader {
+	Bit32u runType;
+	Bit32u analogOutputMode;
+	Bit32u dacInputMode;
+	Bit32u framesPerChunk;
+	Bit32u channels;
+};
+
+class QuietReportHandler : public ReportHandler {
+protected:
+	void printDebug(const char * /* fmt */, va_list /* list */) {}
+	void showLCDMessage(const char * /* message */) {}
+};
+
+// Deterministic pseudo-random sequence, so that the stimulus does not depend on the C library in use.
+class StimulusRandom {
+private:
+	Bit32u state;
+
+public:
+	StimulusRandom() : state(0x4D543332) {}
+
+	unsigned int next(unsigned int range) {
+		state = state * 1103515245 + 12345;
+		return (state >> 16) % range;
+	}
+};
+
+static void printUsage(const char *cmd) {
+	fprintf(stderr, "Usage: %s [options] (-r <capture file> | -c <capture file>)\n\n", cmd);
+	fprintf(stderr, "Renders a fixed MIDI stimulus in every DAC input and analog output mode and either records the output\n");
+	fprintf(stderr, "as the reference, or verifies that it is bit-exact with a recorded reference.\n\n");
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "  -r, --record <file>        Record the output of this build as the reference\n");
+	fprintf(stderr, "  -c, --compare <file>       Compare the output of this build with the reference recorded before\n");
+	fprintf(stderr, "  -m, --rom-dir <directory>  Directory in which ROMs are stored (including trailing path separator)\n");
+	fprintf(stderr, "  -t, --test-roms            Use the generated synthetic ROMs rather than real ones (requires libmt32emu built with libmt32emu_WITH_TEST_ROMS)\n");
+	fprintf(stderr, "  -d, --duration <seconds>   Length of the stimulus when recording (default: %.1f)\n", DEFAULT_DURATION);
+	fprintf(stderr, "  -p, --coalesce-refreshes   Render with part refresh coalescing enabled, which must not change the output\n");
+	fprintf(stderr, "  -h, --help                 Show this help\n");
+}
+
+static bool parseOptions(int argc, char *argv[], Options &options) {
+	options.romDir = "";
+	options.useTestROMs = false;
+	options.partRefreshCoalescing = false;
+	options.recordFileName = NULL;
+	options.compareFileName = NULL;
+	options.duration = DEFAULT_DURATION;
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+			return false;
+		}
+		if (strcmp(arg, "-t") == 0 || strcmp(arg, "--test-roms") == 0) {
+			options.useTestROMs = true;
+			continue;
+		}
+		if (strcmp(arg, "-p") == 0 || strcmp(arg, "--coalesce-refreshes") == 0) {
+			options.partRefreshCoalescing = true;
+			continue;
+		}
+		if (i + 1 == argc) {
+			fprintf(stderr, "Unknown option or missing argument: %s\n", arg);
+			return false;
+		}
+		const char *value = argv[++i];
+		if (strcmp(arg, "-r") == 0 || strcmp(arg, "--record") == 0) {
+			options.recordFileName = value;
+		} else if (strcmp(arg, "-c") == 0 || strcmp(arg, "--compare") == 0) {
+			options.compareFileName = value;
+		} else if (strcmp(arg, "-m") == 0 || strcmp(arg, "--rom-dir") == 0) {
+			options.romDir = value;
+		} else if (strcmp(arg, "-d") == 0 || strcmp(arg, "--duration") == 0) {
+			options.duration = atof(value);
+			if (options.duration <= 0.0) {
+				fprintf(stderr, "Invalid duration: %s\n", value);
+				return false;
+			}
+		} else {
+			fprintf(stderr, "Unknown option: %s\n", arg);
+			return false;
+		}
+	}
+	if ((options.recordFileName == NULL) == (options.compareFileName == NULL)) {
+		fprintf(stderr, "Exactly one of --record and --compare must be specified.\n");
+		return false;
+	}
+	return true;
+}
+
+static void sendDT1(Synth &synth, Bit32u addr, const Bit8u *data, Bit32u len) {
+	Bit8u sysex[MAX_SYSEX_SIZE];
+	sysex[0] = 0xF0;
+	sysex[1] = SYSEX_MANUFACTURER_ROLAND;
+	sysex[2] = 0x10;
+	sysex[3] = SYSEX_MDL_MT32;
+	sysex[4] = SYSEX_CMD_DT1;
+	sysex[5] = Bit8u((addr >> 16) & 0x7F);
+	sysex[6] = Bit8u((addr >> 8) & 0x7F);
+	sysex[7] = Bit8u(addr & 0x7F);
+	memcpy(sysex + 8, data, len);
+	sysex[8 + len] = Synth::calcSysexChecksum(sysex + 5, len + 3);
+	sysex[9 + len] = 0xF7;
+	synth.playSysex(sysex, len + 10);
+}
+
+static void sendDT1(Synth &synth, Bit32u addr, Bit8u value) {
+	sendDT1(synth, addr, &value, 1);
+}
+
+// Converts a linear offset into the 7-bit SysEx address space.
+static Bit32u addSysexOffset(Bit32u addr, unsigned int offset) {
+	Bit32u linear = ((addr >> 16) << 14) | (((addr >> 8) & 0x7F) << 7) | (addr & 0x7F);
+	linear += offset;
+	return ((linear >> 14) << 16) | (((linear >> 7) & 0x7F) << 8) | (linear & 0x7F);
+}
+
+static Bit32u makeShortMessage(Bit8u status, Bit8u data1, Bit8u data2) {
+	return status | (data1 << 8) | (data2 << 16);
+}
+
+// Edits a random timbre parameter of a random part, keeping values within the documented range.
+// Structures, waveforms and PCM waves change, so that all the LA32 pair types and both PCM banks get exercised.
+static void sendTimbreEdit(Synth &synth, StimulusRandom &random) {
+	static const struct {
+		unsigned int offset;
+		unsigned int range;
+	} PARTIAL_PARAMS[] = {
+		{0, 97},   // WG pitch coarse
+		{1, 101},  // WG pitch fine
+		{4, 4},    // WG waveform, including the second PCM bank
+		{5, 128},  // WG PCM wave
+		{6, 101},  // WG pulse width
+		{21, 101}, // Pitch LFO depth
+		{23, 101}, // TVF cutoff
+		{24, 31},  // TVF resonance
+		{28, 101}, // TVF envelope depth
+		{41, 101}, // TVA level
+		{49, 101}, // TVA envelope time 1
+		{57, 101}  // TVA envelope level 4
+	};
+	unsigned int part = random.next(8);
+	Bit32u timbreAddr = addSysexOffset(TIMBRE_TEMP_ADDR, part * TIMBRE_TEMP_SIZE);
+	switch (random.next(4)) {
+	case 0:
+		// Partial structure 1&2 or 3&4
+		sendDT1(synth, addSysexOffset(timbreAddr, 10 + random.next(2)), Bit8u(random.next(13)));
+		break;
+	case 1:
+		// Partial mute, leaving at least one partial enabled
+		sendDT1(synth, addSysexOffset(timbreAddr, 12), Bit8u(1 + random.next(15)));
+		break;
+	default:
+		unsigned int param = random.next(sizeof(PARTIAL_PARAMS) / sizeof(PARTIAL_PARAMS[0]));
+		unsigned int offset = TIMBRE_COMMON_SIZE + random.next(4) * TIMBRE_PARTIAL_SIZE + PARTIAL_PARAMS[param].offset;
+		sendDT1(synth, addSysexOffset(timbreAddr, offset), Bit8u(random.next(PARTIAL_PARAMS[param].range)));
+		break;
+	}
+}
+
+static void sendSystemEdit(Synth &synth, StimulusRandom &random) {
+	switch (random.next(4)) {
+	case 0:
+		// Reverb mode, time and level at once
+		{
+			Bit8u reverb[3] = {Bit8u(random.next(4)), Bit8u(random.next(8)), Bit8u(random.next(8))};
+			sendDT1(synth, addSysexOffset(SYSTEM_ADDR, 1), reverb, 3);
+		}
+		break;
+	case 1:
+		// Master tune
+		sendDT1(synth, SYSTEM_ADDR, Bit8u(random.next(128)));
+		break;
+	case 2:
+		// Master volume
+		sendDT1(synth, addSysexOffset(SYSTEM_ADDR, 0x16), Bit8u(60 + random.next(41)));
+		break;
+	default:
+		// Patch temp key shift, fine tune, bender range or reverb switch of a random part
+		{
+			static const unsigned int OFFSETS[] = {2, 3, 4, 6};
+			static const unsigned int RANGES[] = {49, 101, 25, 2};
+			unsigned int param = random.next(4);
+			Bit32u addr = addSysexOffset(PATCH_TEMP_ADDR, random.next(8) * PATCH_TEMP_SIZE + OFFSETS[param]);
+			sendDT1(synth, addr, Bit8u(random.next(RANGES[param])));
+		}
+		break;
+	}
+}
+
+// Sends the MIDI events scheduled before the given chunk. The stimulus is dense enough to exceed the partial count
+// regularly, so that partial stealing and poly aborts are covered alongside the ordinary note lifecycle.
+static void playStimulus(Synth &synth, StimulusRandom &random, Bit32u chunk) {
+	if (chunk == 0) {
+		// Use the same program on every part initially, and a bit of everything on the rhythm part
+		for (Bit8u channel = 1; channel <= 8; channel++) {
+			synth.playMsg(makeShortMessage(0xC0 | channel, Bit8u(channel * 13), 0));
+		}
+	}
+	unsigned int eventCount = random.next(4);
+	for (unsigned int i = 0; i < eventCount; i++) {
+		Bit8u channel = Bit8u(random.next(10));
+		if (channel == 0) channel = RHYTHM_CHANNEL;
+		unsigned int eventType = random.next(100);
+		if (eventType < 45) {
+			Bit8u key = channel == RHYTHM_CHANNEL ? Bit8u(35 + random.next(42)) : Bit8u(24 + random.next(72));
+			synth.playMsg(makeShortMessage(0x90 | channel, key, Bit8u(1 + random.next(127))));
+		} else if (eventType < 80) {
+			Bit8u key = channel == RHYTHM_CHANNEL ? Bit8u(35 + random.next(42)) : Bit8u(24 + random.next(72));
+			synth.playMsg(makeShortMessage(0x80 | channel, key, 64));
+		} else if (eventType < 84) {
+			synth.playMsg(makeShortMessage(0xE0 | channel, Bit8u(random.next(128)), Bit8u(random.next(128))));
+		} else if (eventType < 88) {
+			// Modulation, volume, pan, expression
+			static const Bit8u CONTROLLERS[] = {1, 7, 10, 11};
+			synth.playMsg(makeShortMessage(0xB0 | channel, CONTROLLERS[random.next(4)], Bit8u(random.next(128))));
+		} else if (eventType < 91) {
+			// Hold pedal
+			synth.playMsg(makeShortMessage(0xB0 | channel, 64, random.next(2) ? 127 : 0));
+		} else if (eventType < 93) {
+			synth.playMsg(makeShortMessage(0xC0 | channel, Bit8u(random.next(128)), 0));
+		} else if (eventType < 98) {
+			sendTimbreEdit(synth, random);
+		} else if (eventType < 99) {
+			sendSystemEdit(synth, random);
+		} else {
+			// All notes off, releasing everything at once
+			synth.playMsg(makeShortMessage(0xB0 | channel, 123, 0));
+		}
+	}
+}
+
+static void getPartialStates(const Synth &synth, Bit8u *states) {
+	PartialState partialStates[256];
+	synth.getPartialStates(partialStates);
+	for (unsigned int i = 0; i < synth.getPartialCount(); i++) {
+		states[i] = Bit8u(partialStates[i]);
+	}
+}
+
+static void renderChunk(Synth &synth, const RunHeader &runHeader, Sample *samples) {
+	if (runHeader.runType == RunType_OUTPUT) {
+		synth.render(samples, runHeader.framesPerChunk);
+		return;
+	}
+	Sample streams[STREAM_COUNT][CHUNK_FRAMES];
+	synth.renderStreams(streams[0], streams[1], streams[2], streams[3], streams[4], streams[5], CHUNK_FRAMES);
+	for (unsigned int frame = 0; frame < CHUNK_FRAMES; frame++) {
+		for (unsigned int stream = 0; stream < STREAM_COUNT; stream++) {
+			*samples++ = streams[stream][frame];
+		}
+	}
+}
+
+static void describeRun(const RunHeader &runHeader, char *description) {
+	if (runHeader.runType == RunType_STREAMS) {
+		sprintf(description, "streams dac=%s", DAC_INPUT_MODE_NAMES[runHeader.dacInputMode]);
+	} else {
+		sprintf(description, "output  dac=%s analog=%s", DAC_INPUT_MODE_NAMES[runHeader.dacInputMode], ANALOG_OUTPUT_MODE_NAMES[runHeader.analogOutputMode]);
+	}
+}
+
+static void printPartialStates(const char *label, const Bit8u *states, unsigned int partialCount) {
+	printf("    %s partials:", label);
+	bool anyActive = false;
+	for (unsigned int i = 0; i < partialCount; i++) {
+		if (states[i] != PartialState_INACTIVE) {
+			printf(" #%u:%s", i, PARTIAL_STATE_NAMES[states[i]]);
+			anyActive = true;
+		}
+	}
+	printf(anyActive ? "\n" : " none active\n");
+}
+
+static void printPlayingNotes(const Synth &synth) {
+	printf("    playing notes:");
+	bool anyPlaying = false;
+	Bit8u keys[256];
+	Bit8u velocities[256];
+	for (unsigned int part = 0; part < PART_COUNT; part++) {
+		unsigned int noteCount = synth.getPlayingNotes(part, keys, velocities);
+		if (noteCount == 0) continue;
+		if (part < 8) {
+			printf(" part %u [", part + 1);
+		} else {
+			printf(" rhythm [");
+		}
+		for (unsigned int i = 0; i < noteCount; i++) {
+			printf(i == 0 ? "%u" : " %u", keys[i]);
+		}
+		printf("]");
+		anyPlaying = true;
+	}
+	printf(anyPlaying ? "\n" : " none\n");
+}
+
+// Renders one run, then either appends it to the capture or verifies it against the capture.
+// Returns false on I/O errors only, the divergence is reported via the diverged flag.
+static bool processRun(Synth &synth, const ROMImage &controlROMImage, const ROMImage &pcmROMImage, const CaptureHeader &captureHeader, const RunHeader &runHeader, FILE *file, bool record, bool &diverged) {
+	char description[64];
+	describeRun(runHeader, description);
+	if (!synth.open(controlROMImage, pcmROMImage, DEFAULT_MAX_PARTIALS, AnalogOutputMode(runHeader.analogOutputMode))) {
+		fprintf(stderr, "Error opening synth.\n");
+		return false;
+	}
+	synth.setDACInputMode(DACInputMode(runHeader.dacInputMode));
+
+	unsigned int samplesPerChunk = runHeader.framesPerChunk * runHeader.channels;
+	Sample *samples = new Sample[samplesPerChunk];
+	Sample *referenceSamples = new Sample[samplesPerChunk];
+	Bit8u states[256];
+	Bit8u referenceStates[256];
+	bool stateDiverged = false;
+	bool ok = true;
+	diverged = false;
+	StimulusRandom random;
+
+	for (Bit32u chunk = 0; chunk < captureHeader.chunkCount; chunk++) {
+		playStimulus(synth, random, chunk);
+		renderChunk(synth, runHeader, samples);
+		getPartialStates(synth, states);
+		if (record) {
+			if (fwrite(states, 1, captureHeader.partialCount, file) != captureHeader.partialCount
+				|| fwrite(samples, sizeof(Sample), samplesPerChunk, file) != samplesPerChunk) {
+				fprintf(stderr, "Error writing capture.\n");
+				ok = false;
+				break;
+			}
+			continue;
+		}
+		if (fread(referenceStates, 1, captureHeader.partialCount, file) != captureHeader.partialCount
+			|| fread(referenceSamples, sizeof(Sample), samplesPerChunk, file) != samplesPerChunk) {
+			fprintf(stderr, "Unexpected end of capture.\n");
+			ok = false;
+			break;
+		}
+		if (!stateDiverged && memcmp(states, referenceStates, captureHeader.partialCount) != 0) {
+			// Envelope phases may diverge before the output does, the first such chunk is the best hint at the cause
+			stateDiverged = true;
+			for (unsigned int i = 0; i < captureHeader.partialCount; i++) {
+				if (states[i] == referenceStates[i]) continue;
+				printf("%s: partial #%u first diverges in chunk %u (frames %u-%u): reference %s, actual %s\n", description, i, chunk,
+					chunk * runHeader.framesPerChunk, (chunk + 1) * runHeader.framesPerChunk - 1, PARTIAL_STATE_NAMES[referenceStates[i]], PARTIAL_STATE_NAMES[states[i]]);
+				break;
+			}
+		}
+		if (memcmp(samples, referenceSamples, samplesPerChunk * sizeof(Sample)) == 0) continue;
+		unsigned int sampleIx = 0;
+		while (memcmp(&samples[sampleIx], &referenceSamples[sampleIx], sizeof(Sample)) == 0) sampleIx++;
+		unsigned int frame = chunk * runHeader.framesPerChunk + sampleIx / runHeader.channels;
+		const char *channelName = runHeader.runType == RunType_STREAMS ? STREAM_NAMES[sampleIx % runHeader.channels] : OUTPUT_CHANNEL_NAMES[sampleIx % runHeader.channels];
+		printf("%s: FAILED, first divergence at frame %u (%.4f s) in %s: reference %g, actual %g\n", description, frame,
+			double(frame) / synth.getStereoOutputSampleRate(), channelName, double(referenceSamples[sampleIx]), double(samples[sampleIx]));
+		printPartialStates("reference", referenceStates, captureHeader.partialCount);
+		printPartialStates("actual   ", states, captureHeader.partialCount);
+		printPlayingNotes(synth);
+		diverged = true;
+		// Skip the rest of this run in the capture
+		long remaining = long(captureHeader.chunkCount - chunk - 1) * long(captureHeader.partialCount + samplesPerChunk * sizeof(Sample));
+		if (fseek(file, remaining, SEEK_CUR) != 0) {
+			fprintf(stderr, "Error seeking capture.\n");
+			ok = false;
+		}
+		break;
+	}
+	if (ok && !diverged) {
+		printf("%s: %s\n", description, record ? "recorded" : "OK");
+	}
+	fflush(stdout);
+	delete[] samples;
+	delete[] referenceSamples;
+	synth.close();
+	return ok;
+}
+
+static bool openROM(FileStream &file, const char *romDir, const char *name1, const char *name2) {
+	if (file.open((std::string(romDir) + name1).c_str())) return true;
+	return file.open((std::string(romDir) + name2).c_str());
+}
+
+static unsigned int makeRuns(RunHeader *runs) {
+	unsigned int runCount = 0;
+	for (int dacInputMode = DACInputMode_NICE; dacInputMode <= DACInputMode_GENERATION2; dacInputMode++) {
+		RunHeader &run = runs[runCount++];
+		run.runType = RunType_STREAMS;
+		run.analogOutputMode = AnalogOutputMode_DIGITAL_ONLY;
+		run.dacInputMode = dacInputMode;
+		run.framesPerChunk = CHUNK_FRAMES;
+		run.channels = STREAM_COUNT;
+	}
+	for (int analogOutputMode = AnalogOutputMode_DIGITAL_ONLY; analogOutputMode <= AnalogOutputMode_OVERSAMPLED; analogOutputMode++) {
+		for (int dacInputMode = DACInputMode_NICE; dacInputMode <= DACInputMode_GENERATION2; dacInputMode++) {
+			RunHeader &run = runs[runCount++];
+			run.runType = RunType_OUTPUT;
+			run.analogOutputMode = analogOutputMode;
+			run.dacInputMode = dacInputMode;
+			// Filled in when recording, according to the output sample rate
+			run.framesPerChunk = 0;
+			run.channels = 2;
+		}
+	}
+	return runCount;
+}
+
+// Processes all the runs. Returns the exit code.
+static int verify(const Options &options, const ROMImage &controlROMImage, const ROMImage &pcmROMImage) {
+	bool record = options.recordFileName != NULL;
+	const char *fileName = record ? options.recordFileName : options.compareFileName;
+	FILE *file = fopen(fileName, record ? "wb" : "rb");
+	if (file == NULL) {
+		fprintf(stderr, "Unable to open capture file %s.\n", fileName);
+		return 1;
+	}
+
+	RunHeader runs[32];
+	CaptureHeader captureHeader;
+	memset(&captureHeader, 0, sizeof(captureHeader));
+	if (record) {
+		memcpy(captureHeader.magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+		captureHeader.version = CAPTURE_VERSION;
+		captureHeader.byteOrderMark = BYTE_ORDER_MARK;
+		captureHeader.sampleSize = sizeof(Sample);
+		captureHeader.partialCount = DEFAULT_MAX_PARTIALS;
+		captureHeader.chunkCount = Bit32u(options.duration * SAMPLE_RATE / CHUNK_FRAMES);
+		captureHeader.runCount = makeRuns(runs);
+		strncpy(captureHeader.controlROMDigest, controlROMImage.getROMInfo()->sha1Digest, 40);
+		strncpy(captureHeader.pcmROMDigest, pcmROMImage.getROMInfo()->sha1Digest, 40);
+		if (fwrite(&captureHeader, sizeof(captureHeader), 1, file) != 1) {
+			fprintf(stderr, "Error writing capture.\n");
+			fclose(file);
+			return 1;
+		}
+	} else {
+		if (fread(&captureHeader, sizeof(captureHeader), 1, file) != 1 || memcmp(captureHeader.magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0
+			|| captureHeader.version != CAPTURE_VERSION || captureHeader.byteOrderMark != BYTE_ORDER_MARK || captureHeader.runCount > 32) {
+			fprintf(stderr, "%s is not a capture recorded by this tool on this platform.\n", fileName);
+			fclose(file);
+			return 1;
+		}
+		if (captureHeader.sampleSize != sizeof(Sample) || captureHeader.partialCount != DEFAULT_MAX_PARTIALS) {
+			fprintf(stderr, "The capture was recorded by a build with a different sample format or partial count.\n");
+			fclose(file);
+			return 1;
+		}
+		if (strcmp(captureHeader.controlROMDigest, controlROMImage.getROMInfo()->sha1Digest) != 0
+			|| strcmp(captureHeader.pcmROMDigest, pcmROMImage.getROMInfo()->sha1Digest) != 0) {
+			fprintf(stderr, "The capture was recorded with different ROMs.\n");
+			fclose(file);
+			return 1;
+		}
+	}
+
+	QuietReportHandler reportHandler;
+	Synth synth(&reportHandler);
+	synth.setPartRefreshCoalescingEnabled(options.partRefreshCoalescing);
+	unsigned int failedRuns = 0;
+	int exitCode = 0;
+	for (unsigned int i = 0; i < captureHeader.runCount; i++) {
+		RunHeader &runHeader = runs[i];
+		if (record) {
+			if (runHeader.framesPerChunk == 0) {
+				// The accurate and oversampled modes upsample the output, chunks must stay aligned with the DAC chunks to keep the stimulus timing identical
+				AnalogOutputMode mode = AnalogOutputMode(runHeader.analogOutputMode);
+				runHeader.framesPerChunk = CHUNK_FRAMES * Synth::getStereoOutputSampleRate(mode) / SAMPLE_RATE;
+			}
+			if (fwrite(&runHeader, sizeof(runHeader), 1, file) != 1) {
+				fprintf(stderr, "Error writing capture.\n");
+				exitCode = 1;
+				break;
+			}
+		} else if (fread(&runHeader, sizeof(runHeader), 1, file) != 1) {
+			fprintf(stderr, "Unexpected end of capture.\n");
+			exitCode = 1;
+			break;
+		}
+		bool diverged;
+		if (!processRun(synth, controlROMImage, pcmROMImage, captureHeader, runHeader, file, record, diverged)) {
+			exitCode = 1;
+			break;
+		}
+		if (diverged) failedRuns++;
+	}
+	if (fclose(file) != 0 && record) {
+		fprintf(stderr, "Error writing capture.\n");
+		exitCode = 1;
+	}
+	if (exitCode == 0 && !record) {
+		if (failedRuns == 0) {
+			printf("All %u runs are bit-exact with the reference.\n", captureHeader.runCount);
+		} else {
+			printf("%u of %u runs diverge from the reference.\n", failedRuns, captureHeader.runCount);
+			exitCode = 2;
+		}
+	}
+	return exitCode;
+}
+
+int main(int argc, char *argv[]) {
+	Options options;
+	if (!parseOptions(argc, argv, options)) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	FileStream controlROMFile;
+	FileStream pcmROMFile;
+	TestROMFile testControlROMFile(TestROMFile::CONTROL);
+	TestROMFile testPCMROMFile(TestROMFile::PCM);
+	const ROMImage *controlROMImage;
+	const ROMImage *pcmROMImage;
+	if (options.useTestROMs) {
+		controlROMImage = ROMImage::makeROMImage(&testControlROMFile);
+		pcmROMImage = ROMImage::makeROMImage(&testPCMROMFile);
+	} else {
+		if (!openROM(controlROMFile, options.romDir, "CM32L_CONTROL.ROM", "MT32_CONTROL.ROM")) {
+			fprintf(stderr, "Control ROM not found.\n");
+			return 1;
+		}
+		if (!openROM(pcmROMFile, options.romDir, "CM32L_PCM.ROM", "MT32_PCM.ROM")) {
+			fprintf(stderr, "PCM ROM not found.\n");
+			return 1;
+		}
+		controlROMImage = ROMImage::makeROMImage(&controlROMFile);
+		pcmROMImage = ROMImage::makeROMImage(&pcmROMFile);
+	}
+
+	int exitCode;
+	if (controlROMImage->getROMInfo() == NULL || pcmROMImage->getROMInfo() == NULL) {
+		if (options.useTestROMs) {
+			fprintf(stderr, "Synthetic test ROMs are not accepted, rebuild libmt32emu with libmt32emu_WITH_TEST_ROMS enabled.\n");
+		} else {
+			fprintf(stderr, "Unknown ROMs.\n");
+		}
+		exitCode = 1;
+	} else {
+		exitCode = verify(options, *controlROMImage, *pcmROMImage);
+	}
+
+	ROMImage::freeROMImage(controlROMImage);
+	ROMImage::freeROMImage(pcmROMImage);
+	return exitCode;
+}
@@ -159,7 +159,7 @@ void AudioFileWriter::run() {
 						eventPushed = synth->playMIDIShortMessage(e.getShortMessage(), nextEventFrames);
 						break;
 					case SYSEX:
-						eventPushed = synth->playMIDISysex(e.getSysexData(), e.getSysexLen(), nextEventFrames);
+						eventPushed = synth->playMIDISysex(midiEvents.getSysexData(e), e.getSysexLen(), nextEventFrames);
 						break;
 					case SET_TEMPO:
 						midiTick = parsers[parserIx].getMidiTick(e.getShortMessage());
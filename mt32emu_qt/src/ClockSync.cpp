@@ -14,12 +14,27 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cmath>
+
 #include <QDebug>
+#include <mt32emu/mt32emu.h>
 
 #include "ClockSync.h"
 #include "MasterClock.h"
 
-ClockSync::ClockSync() : performResetOnNextSync(true) {
+static const double TWO_PI = 6.283185307179586;
+// Nearly critically damped loop response with little overshoot
+static const double LOOP_DAMPING = 0.707;
+// An offset error greater than this many standard deviations is treated as an outlier
+static const double LOOP_OUTLIER_SIGMAS = 4.0;
+// Errors below this are never treated as outliers, otherwise a very quiet clock would reject its own jitter
+static const double LOOP_MIN_OUTLIER_NANOS = 1e6;
+// A step in the offset which persists for this many samples is followed rather than rejected
+static const uint LOOP_MAX_OUTLIER_COUNT = 16;
+// Weight of a new sample in the smoothed squared error
+static const double LOOP_ERROR_VARIANCE_WEIGHT = 0.01;
+
+ClockSync::ClockSync() : performResetOnNextSync(true), traceBuffer(NULL), loopNaturalFrequency(0.0) {
 	periodicResetNanos = 2 * MasterClock::NANOS_PER_SECOND;
 	emergencyResetThresholdNanos = 200 * MasterClock::NANOS_PER_MILLISECOND;
 }
@@ -37,18 +52,40 @@ void ClockSync::setParams(MasterClockNanos useEmergencyResetThresholdNanos, Mast
 	emergencyResetThresholdNanos = useEmergencyResetThresholdNanos;
 }
 
+void ClockSync::setLoopBandwidth(double bandwidthHz) {
+	loopNaturalFrequency = TWO_PI * bandwidthHz;
+	scheduleReset();
+}
+
+void ClockSync::setTraceBuffer(MT32Emu::TraceBuffer *useTraceBuffer) {
+	traceBuffer = useTraceBuffer;
+}
+
+void ClockSync::reset(MasterClockNanos masterNow, MasterClockNanos externalNow) {
+	masterStart = masterNow;
+	externalStart = externalNow;
+	baseOffset = externalNow - masterNow;
+	offsetSum = 0;
+	syncCount = 0;
+	drift = 0;
+	loopOffset = double(baseOffset);
+	loopErrorVariance = LOOP_MIN_OUTLIER_NANOS * LOOP_MIN_OUTLIER_NANOS;
+	loopOutlierCount = 0;
+	qDebug() << "ClockSync: reset" << externalNow * 1e-6 << masterNow * 1e-6 << baseOffset * 1e-6 << getDrift();
+	if (traceBuffer != NULL && traceBuffer->isEnabled()) traceBuffer->addInstantEvent("timing", "clockSyncReset", "baseOffsetMillis", baseOffset * 1e-6);
+	performResetOnNextSync = false;
+}
+
 MasterClockNanos ClockSync::sync(MasterClockNanos masterNow, MasterClockNanos externalNow) {
 	if (performResetOnNextSync) {
-		masterStart = masterNow;
-		externalStart = externalNow;
-		baseOffset = externalNow - masterNow;
-		offsetSum = 0;
-		syncCount = 0;
-		drift = 0;
-		qDebug() << "ClockSync: reset" << externalNow * 1e-6 << masterNow * 1e-6 << baseOffset * 1e-6 << getDrift();
-		performResetOnNextSync = false;
+		reset(masterNow, externalNow);
 		return masterNow;
 	}
+	if (loopNaturalFrequency > 0.0) return syncLoop(masterNow, externalNow);
+	return syncBlockAverage(masterNow, externalNow);
+}
+
+MasterClockNanos ClockSync::syncBlockAverage(MasterClockNanos masterNow, MasterClockNanos externalNow) {
 	MasterClockNanos masterElapsed = masterNow - masterStart;
 	MasterClockNanos externalElapsed = externalNow - externalStart;
 
@@ -59,6 +96,7 @@ MasterClockNanos ClockSync::sync(MasterClockNanos masterNow, MasterClockNanos ex
 	MasterClockNanos currentOffset = baseOffset + MasterClockNanos(externalElapsed * drift);
 	if (emergencyResetThresholdNanos < qAbs(deltaOffset)) {
 		scheduleReset();
+		if (traceBuffer != NULL && traceBuffer->isEnabled()) traceBuffer->addInstantEvent("timing", "clockSyncEmergencyReset", "deltaOffsetMillis", deltaOffset * 1e-6);
 	}
 	if (periodicResetNanos < masterElapsed) {
 		MasterClockNanos newBaseOffset = baseOffset + offsetSum / syncCount;
@@ -68,9 +106,42 @@ MasterClockNanos ClockSync::sync(MasterClockNanos masterNow, MasterClockNanos ex
 		baseOffset = currentOffset;
 		offsetSum = 0;
 		syncCount = 0;
+		if (traceBuffer != NULL && traceBuffer->isEnabled()) traceBuffer->addCounterEvent("timing", "clockSyncDrift", getDrift());
 #if 0
 		qDebug() << "ClockSync: offset delta" << (newBaseOffset - baseOffset) * 1e-6 << "drift" << getDrift();
 #endif
 	}
 	return externalNow - currentOffset;
 }
+
+MasterClockNanos ClockSync::syncLoop(MasterClockNanos masterNow, MasterClockNanos externalNow) {
+	double externalElapsedSeconds = double(externalNow - externalStart) / MasterClock::NANOS_PER_SECOND;
+	externalStart = externalNow;
+	masterStart = masterNow;
+
+	// Second-order loop: the offset is predicted using the drift, the prediction error corrects both
+	double predictedOffset = loopOffset + drift * externalElapsedSeconds * MasterClock::NANOS_PER_SECOND;
+	double error = double(externalNow - masterNow) - predictedOffset;
+	if (emergencyResetThresholdNanos < qAbs(error)) {
+		scheduleReset();
+		if (traceBuffer != NULL && traceBuffer->isEnabled()) traceBuffer->addInstantEvent("timing", "clockSyncEmergencyReset", "deltaOffsetMillis", error * 1e-6);
+	}
+	double outlierThreshold = qMax(LOOP_MIN_OUTLIER_NANOS, LOOP_OUTLIER_SIGMAS * sqrt(loopErrorVariance));
+	if (outlierThreshold < qAbs(error) && ++loopOutlierCount < LOOP_MAX_OUTLIER_COUNT) {
+		// Coast on the prediction
+		loopOffset = predictedOffset;
+		if (traceBuffer != NULL && traceBuffer->isEnabled()) traceBuffer->addInstantEvent("timing", "clockSyncOutlier", "deltaOffsetMillis", error * 1e-6);
+		return externalNow - MasterClockNanos(loopOffset);
+	}
+	loopOutlierCount = 0;
+	loopErrorVariance += LOOP_ERROR_VARIANCE_WEIGHT * (error * error - loopErrorVariance);
+
+	// The gains are limited so that a long gap between samples can't make the loop unstable
+	double offsetGain = qMin(1.0, 2.0 * LOOP_DAMPING * loopNaturalFrequency * externalElapsedSeconds);
+	double driftGain = qMin(1.0, loopNaturalFrequency * loopNaturalFrequency * externalElapsedSeconds);
+	loopOffset = predictedOffset + offsetGain * error;
+	drift += driftGain * error / MasterClock::NANOS_PER_SECOND;
+	baseOffset = MasterClockNanos(loopOffset);
+	if (traceBuffer != NULL && traceBuffer->isEnabled()) traceBuffer->addCounterEvent("timing", "clockSyncDrift", getDrift());
+	return externalNow - baseOffset;
+}
@@ -5,6 +5,10 @@
 
 #include "MasterClock.h"
 
+namespace MT32Emu {
+class TraceBuffer;
+}
+
 class ClockSync {
 private:
 	bool performResetOnNextSync;
@@ -30,6 +34,27 @@ private:
 	// The reset isn't performed immediately to avoid syncing on a random fluctuation
 	MasterClockNanos emergencyResetThresholdNanos;
 
+	// Receives the synchronisation decisions, NULL unless tracing
+	MT32Emu::TraceBuffer *traceBuffer;
+
+	// Natural frequency of the phase-locked loop estimator in rad/s, 0 selects the block average estimator above.
+	// The loop tracks the offset and the drift continuously and rejects outliers rather than resetting on them.
+	double loopNaturalFrequency;
+
+	// The offset (external minus master) predicted by the loop at externalStart
+	double loopOffset;
+
+	// Smoothed squared offset error, used to detect outliers
+	double loopErrorVariance;
+
+	// Number of consecutive samples rejected as outliers. A step which persists for LOOP_MAX_OUTLIER_COUNT samples
+	// is accepted and the loop starts following it, only steps beyond the emergency reset threshold force a reset
+	uint loopOutlierCount;
+
+	void reset(MasterClockNanos masterNow, MasterClockNanos externalNow);
+	MasterClockNanos syncBlockAverage(MasterClockNanos masterNow, MasterClockNanos externalNow);
+	MasterClockNanos syncLoop(MasterClockNanos masterNow, MasterClockNanos externalNow);
+
 public:
 	ClockSync();
 
@@ -38,6 +63,10 @@ public:
 	double getDrift();
 
 	void setParams(MasterClockNanos useEmergencyResetThresholdNanos, MasterClockNanos usePeriodicResetNanos);
+	// Selects the phase-locked loop estimator with the given bandwidth in Hz, or the block average estimator when 0.
+	// The periodic reset interval only concerns the block average estimator.
+	void setLoopBandwidth(double bandwidthHz);
+	void setTraceBuffer(MT32Emu::TraceBuffer *traceBuffer);
 };
 
 #endif
@@ -59,6 +59,7 @@
 void Master::init() {
 	stopping = false;
 	maxSessions = 0;
+	traceRecorder = NULL;
 
 	moveToThread(QCoreApplication::instance()->thread());
 
@@ -110,6 +111,18 @@ void Master::aboutToQuit() {
 		delete audioDriverIt.next();
 		audioDriverIt.remove();
 	}
+
+	if (traceRecorder != NULL) {
+		traceRecorder->setEnabled(false);
+		if (traceRecorder->writeJSON(traceFileName.toLocal8Bit().constData())) {
+			qDebug() << "Trace written to" << traceFileName << "events:" << traceRecorder->getEventCount() << "dropped:" << traceRecorder->getDroppedEventCount();
+		} else {
+			qDebug() << "Failed to write trace to" << traceFileName;
+		}
+		releasedTraceBuffers.clear();
+		delete traceRecorder;
+		traceRecorder = NULL;
+	}
 	return;
 }
 
@@ -192,6 +205,10 @@ void Master::showCommandLineHelp() {
 		"	during this run only.\n"
 		"-max_sessions <number of sessions>\n"
 		"	exit after this number of MIDI sessions are finished.\n"
+		"-trace <file>\n"
+		"	record rendering, MIDI and audio output events of synths\n"
+		"	opened since then and write them to the file in Chrome trace\n"
+		"	event format upon exit.\n"
 		"\n"
 		"Commands:\n"
 		"play <SMF file...>\n"
@@ -227,6 +244,17 @@ void Master::processCommandLine(QStringList args) {
 				QMessageBox::warning(NULL, "Error", "The maximum number of sessions must be specified in command line with \"-max_sessions\" option.");
 				showCommandLineHelp();
 			}
+		} else if (QString::compare(command, "-trace", Qt::CaseInsensitive) == 0) {
+			if (args.count() > argIx) {
+				traceFileName = args.at(argIx++);
+				if (traceRecorder == NULL) {
+					traceRecorder = new MT32Emu::TraceRecorder;
+					traceRecorder->setEnabled(true);
+				}
+			} else {
+				QMessageBox::warning(NULL, "Error", "The trace file name must be specified in command line with \"-trace\" option.");
+				showCommandLineHelp();
+			}
 		} else {
 			QMessageBox::warning(NULL, "Error", "Illegal command line option " + command + " specified.");
 			showCommandLineHelp();
@@ -562,6 +590,20 @@ void Master::setAudioFileWriterSynth(const QSynth *qSynth) {
 	audioFileWriterSynth = qSynth;
 }
 
+MT32Emu::TraceBuffer *Master::createTraceBuffer(const QString &threadName) {
+	QMutexLocker locker(&traceMutex);
+	if (traceRecorder == NULL) return NULL;
+	if (releasedTraceBuffers.contains(threadName)) return releasedTraceBuffers.take(threadName);
+	return traceRecorder->createBuffer(threadName.toUtf8().constData());
+}
+
+void Master::releaseTraceBuffer(const QString &threadName, MT32Emu::TraceBuffer *traceBuffer) {
+	if (traceBuffer == NULL) return;
+	QMutexLocker locker(&traceMutex);
+	if (traceRecorder == NULL) return;
+	releasedTraceBuffers.insert(threadName, traceBuffer);
+}
+
 void Master::isSupportedDropEvent(QDropEvent *e) {
 	if (!e->mimeData()->hasUrls()) {
 		e->ignore();
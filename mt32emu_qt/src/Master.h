@@ -34,6 +34,12 @@ private:
 	bool stopping;
 	unsigned int maxSessions;
 
+	MT32Emu::TraceRecorder *traceRecorder;
+	QString traceFileName;
+	QMutex traceMutex;
+	// Buffers no longer in use, keyed by the thread name. The recorder owns them, so they are reused rather than freed.
+	QMultiHash<QString, MT32Emu::TraceBuffer *> releasedTraceBuffers;
+
 	void init();
 	~Master();
 
@@ -73,6 +79,11 @@ public:
 	void setMidiPortProperties(MidiPropertiesDialog *mpd, MidiSession *midiSession);
 	QString getDefaultROMSearchPath();
 	void setAudioFileWriterSynth(const QSynth *);
+	// Returns a new buffer for recording the events of a thread when tracing is requested in command line, NULL otherwise.
+	// May be called from any thread.
+	MT32Emu::TraceBuffer *createTraceBuffer(const QString &threadName);
+	// Makes the buffer available to subsequent createTraceBuffer() calls with the same thread name. The recorded events are retained.
+	void releaseTraceBuffer(const QString &threadName, MT32Emu::TraceBuffer *traceBuffer);
 
 private slots:
 	void createMidiSession(MidiSession **returnVal, MidiDriver *midiDriver, QString name);
@@ -14,6 +14,8 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+
 #include "MidiParser.h"
 #include "MasterClock.h"
 
@@ -29,248 +31,276 @@ static const char trackID[] = "MTrk";
  */
 static const uint MAX_SYSEX_LENGTH = 256;
 
-bool MidiParser::readFile(char *data, qint64 len) {
-	qint64 readLen = file.read(data, len);
-	if (readLen == len) return true;
-	qDebug() << "MidiParser: Error reading file";
+// An entry of the min-heap used to merge the tracks of a format 1 file. The entries are ordered by the time of the next event,
+// the lower track index goes first for simultaneous events.
+struct MergeEntry {
+	SynthTimestamp time;
+	uint trackIx;
+};
+
+static bool isLaterEvent(const MergeEntry &a, const MergeEntry &b) {
+	if (a.time != b.time) return a.time > b.time;
+	return a.trackIx > b.trackIx;
+}
+
+static bool reportTruncatedTrack(const uchar * &data, const uchar *end) {
+	qDebug() << "MidiParser: Unexpected end of track data, file is probably corrupted.";
+	data = end;
 	return false;
 }
 
 bool MidiParser::parseHeader() {
-	char header[8];
-	if (!readFile(header, 8)) return false;
-	if ((uchar)header[0] == 0xF0) {
+	if (fileSize < 8) {
+		qDebug() << "MidiParser: Error reading file";
+		return false;
+	}
+	if (fileData[0] == 0xF0) {
 		format = 0xF0;
 		numberOfTracks = 1;
 		division = 500;
 		return true;
 	}
-	if (memcmp(header, headerID, 8) != 0) {
+	if (memcmp(fileData, headerID, 8) != 0) {
 		qDebug() << "MidiParser: Wrong MIDI header";
 		return false;
 	}
-	if (!readFile(header, 6)) return false;
-	format = qFromBigEndian<quint16>((uchar *)&header[0]);
-	numberOfTracks = qFromBigEndian<quint16>((uchar *)&header[2]);
-	division = qFromBigEndian<qint16>((uchar *)&header[4]);
+	if (fileSize < 14) {
+		qDebug() << "MidiParser: Error reading file";
+		return false;
+	}
+	format = qFromBigEndian<quint16>(&fileData[8]);
+	numberOfTracks = qFromBigEndian<quint16>(&fileData[10]);
+	division = qFromBigEndian<qint16>(&fileData[12]);
+	filePos = 14;
 	return true;
 }
 
-bool MidiParser::parseTrack(QMidiEventList &midiEventList) {
-	char header[8];
+bool MidiParser::findTrack(TrackCursor &track) {
 	forever {
-		if (!readFile(header, 8)) return false;
+		if (fileSize - filePos < 8) {
+			qDebug() << "MidiParser: Error reading file";
+			return false;
+		}
+		const uchar *header = &fileData[filePos];
+		quint32 dataLen = qFromBigEndian<quint32>(&header[4]);
+		filePos += 8;
+		if (fileSize - filePos < dataLen) {
+			qDebug() << "MidiParser: Error in data chunk";
+			return false;
+		}
 		if (memcmp(header, trackID, 4) == 0) {
-			break;
-		} else {
-			qDebug() << "MidiParser: Wrong MIDI track signature, skipping unknown data chunk";
-			quint32 dataLen = qFromBigEndian<quint32>((uchar *)&header[4]);
-			if (file.seek(file.pos() + dataLen)) {
-				qDebug() << "MidiParser: Error in data chunk";
-				return false;
-			}
+			track.data = &fileData[filePos];
+			track.end = track.data + dataLen;
+			track.runningStatus = 0;
+			track.time = 0;
+			filePos += dataLen;
+			return true;
 		}
+		qDebug() << "MidiParser: Wrong MIDI track signature, skipping unknown data chunk";
+		filePos += dataLen;
 	}
-	quint32 trackLen = qFromBigEndian<quint32>((uchar *)&header[4]);
-	char *trackData = new char[trackLen];
-	if (!readFile(trackData, trackLen)) {
-		delete trackData;
+}
+
+bool MidiParser::readDeltaTime(TrackCursor &track) {
+	if (track.end <= track.data) {
+		if (track.runningStatus != 0x2F) {
+			qDebug() << "MidiParser: End-of-track Meta-event isn't the last event, file is probably corrupted.";
+		}
 		return false;
 	}
+	quint32 deltaTime;
+	if (!parseVarLenInt(track.data, track.end, deltaTime)) return reportTruncatedTrack(track.data, track.end);
+	track.time += deltaTime;
+	return true;
+}
 
-	// Reserve memory for MIDI events, approx. 3 bytes per event
-	midiEventList.reserve(trackLen / 3);
-	qDebug() << "MidiParser: Memory reservation" << trackLen / 3;
-
-	// Parsing actual MIDI events
-	unsigned int runningStatus = 0;
-	const uchar *data = (uchar *)trackData;
-	QVector<uchar> sysexBuffer(MAX_SYSEX_LENGTH);
-	while(data < (uchar *)trackData + trackLen) {
-		SynthTimestamp time = parseVarLenInt(data);
-		quint32 message = 0;
-		const uchar status = *data;
-		if (status & 0x80) {
-			// It's normal status byte
-			if (0xF0 <= status) {
-				// It's a System event
-				if (status == 0xF0) {
-					// It's a SysEx event
-					runningStatus = 0; // SysEx clears running status
-					sysexBuffer[0] = status;
-					quint32 sysexLength = parseVarLenInt(++data);
-					if (MAX_SYSEX_LENGTH <= sysexLength) {
-						qDebug() << "MidiParser: Warning: too long sysex encountered, it may cause problems with real hardware. Sysex length:" << sysexLength + 1;
-						if (sysexBuffer.size() <= (int)sysexLength) {
-							sysexBuffer.resize(sysexLength + 1);
-						}
-					}
-					memcpy(&sysexBuffer[1], data, sysexLength);
-					data += sysexLength;
-					midiEventList.newMidiEvent().assignSysex(time, sysexBuffer.constData(), sysexLength + 1);
-					continue;
-				} else if (status == 0xF7) {
-					// It's either a SysEx Continuation event or an escaped System event
-					qDebug() << "MidiParser: Fragmented SysEx / escape, unsupported";
-					quint32 len = parseVarLenInt(++data);
-					data += len;
-				} else if (status == 0xFF) {
-					// It's a Meta-event
-					runningStatus = 0; // Meta-event clears running status
-					uint metaType = *(++data);
-					quint32 len = parseVarLenInt(++data);
-					if (metaType == 0x2F) {
-						qDebug() << "MidiParser: End-of-track Meta-event";
-						if (time > 0) {
-							// Assign a special marker event to end the track in time
-							qDebug() << "MidiParser: Adding sync event for" << time << "divisions";
-							midiEventList.newMidiEvent().assignSyncMessage(time);
-						}
-						runningStatus = 0x2F;
-						break;
-					} else if (metaType == 0x51) {
-						uint newTempo = qFromBigEndian<quint32>(data) >> 8;
-						midiEventList.newMidiEvent().assignSetTempoMessage(time, newTempo);
-						qDebug() << "MidiParser: Meta-event: Set tempo:" << newTempo;
-						data += len;
-						continue;
-					} else {
-						qDebug() << "MidiParser: Meta-event code" << metaType << "unsupported";
+// Parses the event the track cursor points to (after the delta-time) and appends it to midiEventList if supported.
+// Returns false when the track has ended.
+bool MidiParser::parseEvent(TrackCursor &track, SynthTimestamp time) {
+	const uchar * &data = track.data;
+	if (track.end <= data) return reportTruncatedTrack(data, track.end);
+	quint32 message = 0;
+	const uchar status = *data;
+	if (status & 0x80) {
+		// It's normal status byte
+		if (0xF0 <= status) {
+			// It's a System event
+			if (status == 0xF0) {
+				// It's a SysEx event
+				track.runningStatus = 0; // SysEx clears running status
+				quint32 sysexLength;
+				if (!parseVarLenInt(++data, track.end, sysexLength) || quint32(track.end - data) < sysexLength) return reportTruncatedTrack(data, track.end);
+				if (MAX_SYSEX_LENGTH <= sysexLength) {
+					qDebug() << "MidiParser: Warning: too long sysex encountered, it may cause problems with real hardware. Sysex length:" << sysexLength + 1;
+				}
+				// The status byte isn't included in the stored SysEx data
+				uchar *sysexData = midiEventList.newSysexEvent(time, sysexLength + 1);
+				sysexData[0] = status;
+				memcpy(&sysexData[1], data, sysexLength);
+				data += sysexLength;
+				return true;
+			} else if (status == 0xF7) {
+				// It's either a SysEx Continuation event or an escaped System event
+				qDebug() << "MidiParser: Fragmented SysEx / escape, unsupported";
+				quint32 len;
+				if (!parseVarLenInt(++data, track.end, len) || quint32(track.end - data) < len) return reportTruncatedTrack(data, track.end);
+				data += len;
+			} else if (status == 0xFF) {
+				// It's a Meta-event
+				track.runningStatus = 0; // Meta-event clears running status
+				if (track.end - data < 2) return reportTruncatedTrack(data, track.end);
+				uint metaType = *(++data);
+				quint32 len;
+				if (!parseVarLenInt(++data, track.end, len) || quint32(track.end - data) < len) return reportTruncatedTrack(data, track.end);
+				if (metaType == 0x2F) {
+					qDebug() << "MidiParser: End-of-track Meta-event";
+					if (time > 0) {
+						// Assign a special marker event to end the track in time
+						qDebug() << "MidiParser: Adding sync event for" << time << "divisions";
+						midiEventList.newMidiEvent().assignSyncMessage(time);
 					}
+					track.runningStatus = 0x2F;
+					return false;
+				} else if (metaType == 0x51 && len >= 3) {
+					uint newTempo = (data[0] << 16) | (data[1] << 8) | data[2];
+					midiEventList.newMidiEvent().assignSetTempoMessage(time, newTempo);
+					qDebug() << "MidiParser: Meta-event: Set tempo:" << newTempo;
 					data += len;
+					return true;
 				} else {
-					qDebug() << "MidiParser: Unsupported event" << status;
-					data++;
-				}
-				if (time > 0) {
-					// The event is unsupported. Nevertheless, assign a special marker event to retain timing information
-					qDebug() << "MidiParser: Adding sync event for" << time << "divisions";
-					midiEventList.newMidiEvent().assignSyncMessage(time);
+					qDebug() << "MidiParser: Meta-event code" << metaType << "unsupported";
 				}
-				continue;
-			} else if ((status & 0xE0) == 0xC0) {
-				// It's a short message with one data byte
-				message = qFromLittleEndian<quint16>(data);
-				data += 2;
+				data += len;
 			} else {
-				// It's a short message with two data bytes
-				message = qFromLittleEndian<quint32>(data) & 0xFFFFFF;
-				data += 3;
-			}
-			runningStatus = status;
-		} else {
-			// Handle running status
-			if ((runningStatus & 0x80) == 0) {
-				qDebug() << "MidiParser: First MIDI event must have status byte";
+				qDebug() << "MidiParser: Unsupported event" << status;
 				data++;
-				continue;
 			}
-			if ((runningStatus & 0xE0) == 0xC0) {
-				// It's a short message with one data byte
-				message = runningStatus | ((quint32)*data << 8);
-				data++;
-			} else {
-				// It's a short message with two data bytes
-				message = runningStatus | ((quint32)qFromLittleEndian<quint16>(data) << 8);
-				data += 2;
+			if (time > 0) {
+				// The event is unsupported. Nevertheless, assign a special marker event to retain timing information
+				qDebug() << "MidiParser: Adding sync event for" << time << "divisions";
+				midiEventList.newMidiEvent().assignSyncMessage(time);
 			}
+			return true;
+		} else if ((status & 0xE0) == 0xC0) {
+			// It's a short message with one data byte
+			if (track.end - data < 2) return reportTruncatedTrack(data, track.end);
+			message = status | ((quint32)data[1] << 8);
+			data += 2;
+		} else {
+			// It's a short message with two data bytes
+			if (track.end - data < 3) return reportTruncatedTrack(data, track.end);
+			message = status | ((quint32)data[1] << 8) | ((quint32)data[2] << 16);
+			data += 3;
+		}
+		track.runningStatus = status;
+	} else {
+		// Handle running status
+		if ((track.runningStatus & 0x80) == 0) {
+			qDebug() << "MidiParser: First MIDI event must have status byte";
+			data++;
+			return true;
+		}
+		if ((track.runningStatus & 0xE0) == 0xC0) {
+			// It's a short message with one data byte
+			message = track.runningStatus | ((quint32)data[0] << 8);
+			data++;
+		} else {
+			// It's a short message with two data bytes
+			if (track.end - data < 2) return reportTruncatedTrack(data, track.end);
+			message = track.runningStatus | ((quint32)data[0] << 8) | ((quint32)data[1] << 16);
+			data += 2;
 		}
-		midiEventList.newMidiEvent().assignShortMessage(time, message);
-	}
-	if (runningStatus != 0x2F) {
-		qDebug() << "MidiParser: End-of-track Meta-event isn't the last event, file is probably corrupted.";
 	}
-	delete trackData;
-	qDebug() << "MidiParser: Parsed" << midiEventList.count() << "MIDI events";
+	midiEventList.newMidiEvent().assignShortMessage(time, message);
 	return true;
 }
 
-quint32 MidiParser::parseVarLenInt(const uchar * &data) {
-	quint32 value = 0;
-	for (int i = 0; i < 3; i++) {
-		value = (value << 7) | (*data & 0x7F);
-		if ((*data & 0x80) == 0) break;
-		data++;
+bool MidiParser::parseTrack() {
+	TrackCursor track;
+	if (!findTrack(track)) return false;
+
+	// Reserve memory for MIDI events, approx. 3 bytes per event
+	int initialEventCount = midiEventList.count();
+	midiEventList.reserve(initialEventCount + int(track.end - track.data) / 3);
+
+	// Events are appended with delta-times, unsupported events just add their delta-time to the next one
+	SynthTimestamp lastEventTime = 0;
+	while (readDeltaTime(track)) {
+		int eventCount = midiEventList.count();
+		bool trackContinues = parseEvent(track, track.time - lastEventTime);
+		if (eventCount < midiEventList.count()) lastEventTime = track.time;
+		if (!trackContinues) break;
 	}
-	if (*(data++) & 0x80) qDebug() << "MidiParser: Variable length entity must be no more than 4 bytes long";
-	return value;
+	qDebug() << "MidiParser: Parsed" << midiEventList.count() - initialEventCount << "MIDI events";
+	return true;
 }
 
-void MidiParser::mergeMidiEventLists(QVector<QMidiEventList> &trackList) {
-	int totalEventCount = 0;
-
-	// Remove empty tracks & allocate memory exactly needed
-	for (int i = trackList.count() - 1; i >=0; i--) {
-		int eventCount = trackList.at(i).count();
-		if (eventCount == 0) {
-			trackList.remove(i);
-		} else {
-			totalEventCount += eventCount;
+// Parses all the tracks of a format 1 file at once, always taking the earliest pending event from a min-heap of track cursors.
+// This takes O(events * log(tracks)) and puts each event straight into midiEventList without intermediate per-track lists.
+bool MidiParser::mergeTracks() {
+	QVector<TrackCursor> tracks(numberOfTracks);
+	QVector<MergeEntry> heap;
+	heap.reserve(numberOfTracks);
+	qint64 totalTrackLength = 0;
+	for (uint i = 0; i < numberOfTracks; i++) {
+		if (!findTrack(tracks[i])) return false;
+		totalTrackLength += tracks[i].end - tracks[i].data;
+		if (readDeltaTime(tracks[i])) {
+			MergeEntry entry = {tracks[i].time, i};
+			heap.append(entry);
 		}
 	}
-	midiEventList.reserve(totalEventCount);
-	qDebug() << "MidiParser: Expected" << totalEventCount << "events";
 
-	// Append events from all the tracks to the output list in sequence
-	QVarLengthArray<int> currentIx(trackList.count());	            // The index of the event to be added next
-	QVarLengthArray<SynthTimestamp> currentTime(trackList.count()); // The time in MIDI ticks of the event to be added next
-	for (int i = 0; i < trackList.count(); i++) {
-		currentIx[i] = 0;
-		currentTime[i] = trackList.at(i).at(0).getTimestamp();
-	}
-	SynthTimestamp lastEventTime = 0; // Timestamp of the last added event
-	forever {
-		int trackIx = -1;
-		SynthTimestamp nextEventTime = 0x10000000;
+	// Reserve memory for MIDI events, approx. 3 bytes per event
+	midiEventList.reserve(int(totalTrackLength / 3));
+	qDebug() << "MidiParser: Memory reservation" << totalTrackLength / 3;
 
-		// Find lowest track index with earliest event
-		for (int i = 0; i < trackList.count(); i++) {
-			if (trackList.at(i).count() <= currentIx[i]) continue;
-			if (currentTime[i] < nextEventTime) {
-				nextEventTime = currentTime[i];
-				trackIx = i;
-			}
-		}
-		if (trackIx == -1) break;
-		const QMidiEvent *e = &trackList.at(trackIx).at(currentIx[trackIx]);
-		forever {
-			midiEventList.append(*e);
-			midiEventList.last().setTimestamp(nextEventTime - lastEventTime);
-			lastEventTime = nextEventTime;
-			if (trackList.at(trackIx).count() <= ++currentIx[trackIx]) break;
-			e = &trackList.at(trackIx).at(currentIx[trackIx]);
-			SynthTimestamp nextDeltaTime = e->getTimestamp();
-			if (nextDeltaTime != 0) {
-				currentTime[trackIx] += nextDeltaTime;
-				break;
-			}
+	std::make_heap(heap.begin(), heap.end(), isLaterEvent);
+	SynthTimestamp lastEventTime = 0; // Timestamp of the last added event
+	while (!heap.isEmpty()) {
+		std::pop_heap(heap.begin(), heap.end(), isLaterEvent);
+		MergeEntry &entry = heap.last();
+		TrackCursor &track = tracks[entry.trackIx];
+		int eventCount = midiEventList.count();
+		bool trackContinues = parseEvent(track, track.time - lastEventTime);
+		if (eventCount < midiEventList.count()) lastEventTime = track.time;
+		if (trackContinues && readDeltaTime(track)) {
+			entry.time = track.time;
+			std::push_heap(heap.begin(), heap.end(), isLaterEvent);
+		} else {
+			heap.removeLast();
 		}
 	}
-	qDebug() << "MidiParser: Actually" << midiEventList.count() << "events";
+	qDebug() << "MidiParser: Merged" << midiEventList.count() << "events from" << numberOfTracks << "tracks";
+	return true;
 }
 
-bool MidiParser::parseSysex() {
-	qint64 fileSize = file.size();
-	file.seek(0);
-	char *fileData = new char[fileSize];
-	if (!readFile(fileData, fileSize)) {
-		delete fileData;
-		return false;
+// Returns false if the data ends before the last byte of the variable length entity.
+bool MidiParser::parseVarLenInt(const uchar * &data, const uchar *end, quint32 &value) {
+	value = 0;
+	for (int i = 0; i < 4; i++) {
+		if (end <= data) return false;
+		const uchar byte = *(data++);
+		value = (value << 7) | (byte & 0x7F);
+		if ((byte & 0x80) == 0) return true;
 	}
+	qDebug() << "MidiParser: Variable length entity must be no more than 4 bytes long";
+	return true;
+}
+
+bool MidiParser::parseSysex() {
 	int sysexBeginIx = -1;
-	uchar *data = (uchar *)fileData;
 	for (int i = 0; i < fileSize; i++) {
-		if (data[i] == 0xF0) {
+		if (fileData[i] == 0xF0) {
 			sysexBeginIx = i;
 		}
-		if (sysexBeginIx != -1 && data[i] == 0xF7) {
+		if (sysexBeginIx != -1 && fileData[i] == 0xF7) {
 			int sysexLen = i - sysexBeginIx + 1;
-			midiEventList.newMidiEvent().assignSysex(1, &data[sysexBeginIx], sysexLen);
+			memcpy(midiEventList.newSysexEvent(1, sysexLen), &fileData[sysexBeginIx], sysexLen);
 			sysexBeginIx = -1;
 		}
 	}
 	qDebug() << "MidiParser: Loaded sysex events:" << midiEventList.count();
-	delete fileData;
 	return true;
 }
 
@@ -284,25 +314,18 @@ bool MidiParser::doParse() {
 				qDebug() << "MidiParser: MIDI file format error: MIDI files format 0 must have 1 MIDI track, not" << numberOfTracks;
 				return false;
 			}
-			return parseTrack(midiEventList);
+			return parseTrack();
 		case 1:
 			if (numberOfTracks > 0) {
-				QVector<QMidiEventList> trackList(numberOfTracks);
-				for (uint i = 0; i < numberOfTracks; i++) {
-					qDebug() << "MidiParser: Parsing & merging MIDI track" << i + 1;
-					if (!parseTrack(trackList[i])) return false;
-				}
-				mergeMidiEventLists(trackList);
-				return true;
+				qDebug() << "MidiParser: Parsing & merging" << numberOfTracks << "MIDI tracks";
+				return mergeTracks();
 			}
 			qDebug() << "MidiParser: MIDI file format error: MIDI files format 1 must have at least 1 MIDI track";
 			return false;
 		case 2:
 			for (uint i = 0; i < numberOfTracks; i++) {
 				qDebug() << "MidiParser: Parsing & appending MIDI track" << i + 1;
-				QMidiEventList list;
-				if (!parseTrack(list)) return false;
-				midiEventList += list;
+				if (!parseTrack()) return false;
 			}
 			return true;
 		default:
@@ -313,10 +336,24 @@ bool MidiParser::doParse() {
 
 bool MidiParser::parse(const QString fileName) {
 	midiEventList.clear();
-	file.setFileName(fileName);
-	file.open(QIODevice::ReadOnly);
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly)) {
+		qDebug() << "MidiParser: Error opening file";
+		return false;
+	}
+	fileSize = file.size();
+	fileData = file.map(0, fileSize);
+	if (fileData == NULL) {
+		fileBuffer = file.readAll();
+		fileData = (const uchar *)fileBuffer.constData();
+		fileSize = fileBuffer.size();
+	}
+	filePos = 0;
 	bool parseResult = doParse();
+	// Closing the file also removes the mapping
 	file.close();
+	fileBuffer.clear();
+	fileData = NULL;
 	return parseResult;
 }
 
@@ -17,19 +17,36 @@ public:
 	void addChannelsReset();
 
 private:
-	QFile file;
+	// Parsing state of a single track, the events are read straight from the file mapping as they are needed
+	struct TrackCursor {
+		const uchar *data;
+		const uchar *end;
+		uint runningStatus;
+		// Absolute time of the next event in MIDI ticks
+		SynthTimestamp time;
+	};
+
+	// Implicitly shared, so copies of a parser are cheap and can be handed over between threads
 	QMidiEventList midiEventList;
 
+	// The file contents, either memory-mapped or read into fileBuffer if mapping isn't possible
+	const uchar *fileData;
+	qint64 fileSize;
+	qint64 filePos;
+	QByteArray fileBuffer;
+
 	unsigned int format;
 	unsigned int numberOfTracks;
 	int division;
 
-	static quint32 parseVarLenInt(const uchar * &data);
+	static bool parseVarLenInt(const uchar * &data, const uchar *end, quint32 &value);
 
-	bool readFile(char *data, qint64 len);
 	bool parseHeader();
-	bool parseTrack(QMidiEventList &midiEventList);
-	void mergeMidiEventLists(QVector<QMidiEventList> &tracks);
+	bool findTrack(TrackCursor &track);
+	bool readDeltaTime(TrackCursor &track);
+	bool parseEvent(TrackCursor &track, SynthTimestamp deltaTime);
+	bool parseTrack();
+	bool mergeTracks();
 	bool parseSysex();
 	bool doParse();
 };
@@ -19,6 +19,8 @@
 
 #include "MidiPlayerDialog.h"
 
+static const int PREFETCH_FILE_COUNT = 2;
+
 MidiPlayerDialog::MidiPlayerDialog(Master *master, QWidget *parent) : QDialog(parent), ui(new Ui::MidiPlayerDialog), smfDriver(master), advancePlayList(false), rowPlaying(-1) {
 	ui->setupUi(this);
 	ui->playButton->setEnabled(false);
@@ -176,6 +178,12 @@ void MidiPlayerDialog::handlePlaybackFinished() {
 	}
 	advancePlayList = true;
 	smfDriver.start(ui->playList->currentItem()->text());
+	// Have the next files parsed while this one plays, so that they start without a gap
+	QStringList upcomingFileNames;
+	for (int row = ui->playList->currentRow() + 1; row < ui->playList->count() && upcomingFileNames.size() < PREFETCH_FILE_COUNT; row++) {
+		upcomingFileNames.append(ui->playList->item(row)->text());
+	}
+	smfDriver.prefetch(upcomingFileNames);
 	if (Master::getInstance()->getSettings()->value("Master/showConnectionBalloons", "1").toBool()) {
 		emit playbackStarted("Playing MIDI file", QFileInfo(ui->playList->currentItem()->text()).fileName());
 	}
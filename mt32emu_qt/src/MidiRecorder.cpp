@@ -20,6 +20,7 @@ static const char headerID[] = "MThd\x00\x00\x00\x06";
 static const char trackID[] = "MTrk";
 static const MasterClockNanos DEFAULT_NANOS_PER_QUARTER_NOTE = 500000000;
 static const uint MEMORY_RESERVE = 16384;
+static const uint SYSEX_MEMORY_RESERVE = 65536;
 
 MidiRecorder::MidiRecorder() : startNanos(0), endNanos(0) {
 }
@@ -29,6 +30,7 @@ void MidiRecorder::startRecording() {
 	endNanos = -1;
 	midiEventList.clear();
 	midiEventList.reserve(MEMORY_RESERVE);
+	midiEventList.reserveSysexStorage(SYSEX_MEMORY_RESERVE);
 }
 
 void MidiRecorder::recordShortMessage(quint32 msg, MasterClockNanos midiNanos) {
@@ -39,7 +41,7 @@ void MidiRecorder::recordShortMessage(quint32 msg, MasterClockNanos midiNanos) {
 
 void MidiRecorder::recordSysex(const uchar *sysexData, quint32 sysexLen, MasterClockNanos midiNanos) {
 	if (isRecording()) {
-		midiEventList.newMidiEvent().assignSysex(midiNanos, sysexData, sysexLen);
+		memcpy(midiEventList.newSysexEvent(midiNanos, sysexLen), sysexData, sysexLen);
 	}
 }
 
@@ -101,9 +103,9 @@ bool MidiRecorder::writeTrack(MasterClockNanos midiTick) {
 		eventTicks += deltaTicks;
 		writeVarLenInt(data, deltaTicks);
 
-		uchar *sysexData = evt.getSysexData();
-		if (sysexData != NULL) {
+		if (evt.getType() == SYSEX) {
 			// Process Sysex
+			const uchar *sysexData = midiEventList.getSysexData(evt);
 			quint32 sysexLen = evt.getSysexLen();
 			if (sysexLen < 4 || sysexData[0] != 0xF0 || sysexData[sysexLen - 1] != 0xF7) {
 				// Invalid sysex, skipping
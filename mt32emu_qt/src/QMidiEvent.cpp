@@ -16,37 +16,15 @@
 
 #include "QMidiEvent.h"
 
-#include <cstring>
-
 using namespace MT32Emu;
 
 QMidiEvent::QMidiEvent() {
 	type = SHORT_MESSAGE;
 	msg = 0;
 	sysexLen = 0;
-	sysexData = NULL;
-};
-
-QMidiEvent::QMidiEvent(const QMidiEvent &copyOf) {
-	timestamp = copyOf.timestamp;
-	type = copyOf.type;
-	msg = copyOf.msg;
-	if (type == SYSEX && copyOf.sysexData != NULL) {
-		sysexLen = copyOf.sysexLen;
-		sysexData = new uchar[sysexLen];
-		memcpy(sysexData, copyOf.sysexData, sysexLen);
-	} else {
-		sysexLen = 0;
-		sysexData = NULL;
-	}
+	sysexOffset = 0;
 };
 
-QMidiEvent::~QMidiEvent() {
-	if (sysexData != 0) {
-		delete[] sysexData;
-	}
-}
-
 SynthTimestamp QMidiEvent::getTimestamp() const {
 	return timestamp;
 }
@@ -55,10 +33,6 @@ MidiEventType QMidiEvent::getType() const {
 	return type;
 }
 
-unsigned char *QMidiEvent::getSysexData() const {
-	return sysexData;
-}
-
 Bit32u QMidiEvent::getShortMessage() const {
 	return msg;
 }
@@ -76,19 +50,6 @@ void QMidiEvent::assignShortMessage(SynthTimestamp newTimestamp, Bit32u newMsg)
 	type = SHORT_MESSAGE;
 	msg = newMsg;
 	sysexLen = 0;
-	delete[] sysexData;
-	sysexData = NULL;
-}
-
-void QMidiEvent::assignSysex(SynthTimestamp newTimestamp, unsigned char const * const newSysexData, Bit32u newSysexLen) {
-	timestamp = newTimestamp;
-	type = SYSEX;
-	msg = 0;
-	sysexLen = newSysexLen;
-	delete[] sysexData;
-	Bit8u *copy = new Bit8u[newSysexLen];
-	memcpy(copy, newSysexData, newSysexLen);
-	sysexData = copy;
 }
 
 void QMidiEvent::assignSetTempoMessage(SynthTimestamp newTimestamp, MT32Emu::Bit32u newTempo) {
@@ -96,8 +57,6 @@ void QMidiEvent::assignSetTempoMessage(SynthTimestamp newTimestamp, MT32Emu::Bit
 	type = SET_TEMPO;
 	msg = newTempo;
 	sysexLen = 0;
-	delete[] sysexData;
-	sysexData = NULL;
 }
 
 void QMidiEvent::assignSyncMessage(SynthTimestamp newTimestamp) {
@@ -105,11 +64,34 @@ void QMidiEvent::assignSyncMessage(SynthTimestamp newTimestamp) {
 	type = SYNC;
 	msg = 0;
 	sysexLen = 0;
-	delete[] sysexData;
-	sysexData = NULL;
 }
 
 QMidiEvent &QMidiEventList::newMidiEvent() {
 	resize(size() + 1);
 	return last();
 }
+
+Bit8u *QMidiEventList::newSysexEvent(SynthTimestamp timestamp, Bit32u sysexLen) {
+	QMidiEvent &midiEvent = newMidiEvent();
+	midiEvent.timestamp = timestamp;
+	midiEvent.type = SYSEX;
+	midiEvent.msg = 0;
+	midiEvent.sysexLen = sysexLen;
+	midiEvent.sysexOffset = Bit32u(sysexArena.size());
+	// QByteArray grows geometrically, so appending is amortised constant time
+	sysexArena.resize(sysexArena.size() + int(sysexLen));
+	return (Bit8u *)sysexArena.data() + midiEvent.sysexOffset;
+}
+
+const Bit8u *QMidiEventList::getSysexData(const QMidiEvent &midiEvent) const {
+	return (const Bit8u *)sysexArena.constData() + midiEvent.sysexOffset;
+}
+
+void QMidiEventList::reserveSysexStorage(int size) {
+	sysexArena.reserve(size);
+}
+
+void QMidiEventList::clear() {
+	QVector<QMidiEvent>::clear();
+	sysexArena.clear();
+}
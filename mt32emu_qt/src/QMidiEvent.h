@@ -3,6 +3,7 @@
 
 #include <QtGlobal>
 #include <QVector>
+#include <QByteArray>
 
 #include <mt32emu/mt32emu.h>
 
@@ -17,35 +18,49 @@ enum MidiEventType {
 
 typedef MasterClockNanos SynthTimestamp;
 
+// Trivially copyable, so that lists of events are moved around with plain memory copies.
+// The SysEx payload is stored in the arena of the owning QMidiEventList and referenced by offset.
 class QMidiEvent {
 private:
 	SynthTimestamp timestamp;
 	MidiEventType type;
 	MT32Emu::Bit32u msg;
 	MT32Emu::Bit32u sysexLen;
-	unsigned char *sysexData;
+	MT32Emu::Bit32u sysexOffset;
+
+	friend class QMidiEventList;
 
 public:
 	QMidiEvent();
-	QMidiEvent(const QMidiEvent &copyOf);
-	~QMidiEvent();
 
 	SynthTimestamp getTimestamp() const;
 	MidiEventType getType() const;
 	MT32Emu::Bit32u getShortMessage() const;
 	MT32Emu::Bit32u getSysexLen() const;
-	unsigned char *getSysexData() const;
 
 	void setTimestamp(SynthTimestamp newTimestamp);
 	void assignShortMessage(SynthTimestamp newTimestamp, MT32Emu::Bit32u newMsg);
-	void assignSysex(SynthTimestamp newTimestamp, unsigned char const * const newSysexData, MT32Emu::Bit32u newSysexLen);
 	void assignSetTempoMessage(SynthTimestamp newTimestamp, MT32Emu::Bit32u newTempo);
 	void assignSyncMessage(SynthTimestamp newTimestamp);
 };
 
+Q_DECLARE_TYPEINFO(QMidiEvent, Q_MOVABLE_TYPE);
+
+// SysEx payloads of all the events are appended to a single bump arena, so adding a SysEx event costs no allocation
+// unless the arena has to grow, and neither growing nor copying the list copies the payloads one by one.
+// Both the events and the arena are implicitly shared.
 class QMidiEventList : public QVector<QMidiEvent> {
+private:
+	QByteArray sysexArena;
+
 public:
 	QMidiEvent &newMidiEvent();
+	// Appends a SysEx event and returns the storage for its payload to be filled in,
+	// the pointer is only valid until the list is modified next time
+	MT32Emu::Bit8u *newSysexEvent(SynthTimestamp timestamp, MT32Emu::Bit32u sysexLen);
+	const MT32Emu::Bit8u *getSysexData(const QMidiEvent &midiEvent) const;
+	void reserveSysexStorage(int size);
+	void clear();
 };
 
 #endif
@@ -31,8 +31,55 @@
 
 using namespace MT32Emu;
 
-QReportHandler::QReportHandler(QObject *parent) : QObject(parent) {
+// Triple buffers keep the index of the middle slot along with the flag set when the producer swaps a new slot in
+static const int TRIPLE_BUFFER_INDEX_MASK = 3;
+static const int TRIPLE_BUFFER_UPDATED = 4;
+
+// States of QSynth::renderGate
+static const int RENDER_GATE_FREE = 0;
+static const int RENDER_GATE_RENDERING = 1;
+static const int RENDER_GATE_EXCLUSIVE = 2;
+
+// When the control command ring is full, or the commands pushed must take effect before proceeding, the producer waits
+// this long for the rendering thread to apply them before concluding that rendering is stalled
+static const ulong CONTROL_COMMAND_WAIT_MILLIS = 1;
+static const uint MAX_CONTROL_COMMAND_WAITS = 100;
+
+// Writing to the reset memory region resets the synth like the hardware does, without reopening it
+static const Bit8u RESET_SYSEX[] = {0x7F, 0x00, 0x00, 0x00};
+
+QReportHandler::QReportHandler(QObject *parent) : QObject(parent),
+	publishedEventsExchange(1), backPublishedEventsIndex(0), frontPublishedEventsIndex(2)
+{
 	connect(this, SIGNAL(balloonMessageAppeared(const QString &, const QString &)), Master::getInstance(), SLOT(showBalloon(const QString &, const QString &)));
+	memset(&pendingEvents, 0, sizeof pendingEvents);
+	memset(publishedEvents, 0, sizeof publishedEvents);
+	memset(&deliveredEvents, 0, sizeof deliveredEvents);
+	int deliveryInterval = Master::getInstance()->getSettings()->value("Master/reportEventsDeliveryInterval", 0).toInt();
+	coalescing = deliveryInterval > 0;
+	if (coalescing) {
+		connect(&deliveryTimer, SIGNAL(timeout()), SLOT(deliverEvents()));
+		deliveryTimer.start(deliveryInterval);
+	}
+}
+
+void QReportHandler::publishEvents() {
+	publishedEvents[backPublishedEventsIndex] = pendingEvents;
+	backPublishedEventsIndex = publishedEventsExchange.fetchAndStoreAcqRel(backPublishedEventsIndex | TRIPLE_BUFFER_UPDATED) & TRIPLE_BUFFER_INDEX_MASK;
+}
+
+void QReportHandler::deliverEvents() {
+	if ((publishedEventsExchange.loadAcquire() & TRIPLE_BUFFER_UPDATED) == 0) return;
+	frontPublishedEventsIndex = publishedEventsExchange.fetchAndStoreAcqRel(frontPublishedEventsIndex) & TRIPLE_BUFFER_INDEX_MASK;
+	const ReportedEvents &events = publishedEvents[frontPublishedEventsIndex];
+	if (events.midiMessageCount != deliveredEvents.midiMessageCount) emit midiMessagePlayed();
+	for (int partNum = 0; partNum < 9; partNum++) {
+		if (events.polyStateChangeCounts[partNum] != deliveredEvents.polyStateChangeCounts[partNum]) emit polyStateChanged(partNum);
+		if (events.programChangeCounts[partNum] != deliveredEvents.programChangeCounts[partNum]) {
+			emit programChanged(partNum, events.timbreGroups[partNum], QString().fromLocal8Bit(events.patchNames[partNum]));
+		}
+	}
+	deliveredEvents = events;
 }
 
 void QReportHandler::showLCDMessage(const char *message) {
@@ -52,6 +99,11 @@ void QReportHandler::onErrorPCMROM() {
 }
 
 void QReportHandler::onMIDIMessagePlayed() {
+	if (coalescing) {
+		pendingEvents.midiMessageCount++;
+		publishEvents();
+		return;
+	}
 	emit midiMessagePlayed();
 }
 
@@ -83,10 +135,22 @@ void QReportHandler::onNewReverbLevel(Bit8u level) {
 }
 
 void QReportHandler::onPolyStateChanged(int partNum) {
+	if (coalescing) {
+		pendingEvents.polyStateChangeCounts[partNum]++;
+		publishEvents();
+		return;
+	}
 	emit polyStateChanged(partNum);
 }
 
 void QReportHandler::onProgramChanged(int partNum, int timbreGroup, const char patchName[]) {
+	if (coalescing) {
+		pendingEvents.programChangeCounts[partNum]++;
+		pendingEvents.timbreGroups[partNum] = timbreGroup;
+		qstrncpy(pendingEvents.patchNames[partNum], patchName, sizeof pendingEvents.patchNames[partNum]);
+		publishEvents();
+		return;
+	}
 	emit programChanged(partNum, timbreGroup, QString().fromLocal8Bit(patchName));
 }
 
@@ -99,11 +163,22 @@ void QSynth::convertSamplesFromNativeEndian(Bit16s *buffer, uint sampleCount, QS
 }
 
 QSynth::QSynth(QObject *parent) :
-	QObject(parent), state(SynthState_CLOSED), midiMutex(QMutex::Recursive),
-	controlROMImage(NULL), pcmROMImage(NULL), reportHandler(this), sampleRateConverter(NULL)
+	QObject(parent), state(SynthState_CLOSED), midiMutex(QMutex::Recursive), renderGate(RENDER_GATE_FREE), skippedFrameCount(0),
+	controlROMImage(NULL), pcmROMImage(NULL), reportHandler(this), sampleRateConverter(NULL),
+	renderTraceBuffer(NULL), midiTraceBuffer(NULL),
+	stateSnapshotExchange(1), backStateSnapshotIndex(0), frontStateSnapshotIndex(2),
+	controlCommandsReadIndex(0), controlCommandsWriteIndex(0), controlCommandsPushedCount(0), controlCommandsAppliedCount(0)
 {
+	memset(stateSnapshots, 0, sizeof stateSnapshots);
 	synthMutex = new QMutex(QMutex::Recursive);
 	synth = new Synth(&reportHandler);
+	outputGain = synth->getOutputGain();
+	reverbOutputGain = synth->getReverbOutputGain();
+	reverbEnabled = synth->isReverbEnabled();
+	reverbOverridden = synth->isReverbOverridden();
+	reversedStereoEnabled = synth->isReversedStereoEnabled();
+	midiDelayMode = synth->getMIDIDelayMode();
+	emuDACInputMode = synth->getDACInputMode();
 }
 
 QSynth::~QSynth() {
@@ -117,33 +192,51 @@ bool QSynth::isOpen() const {
 	return state == SynthState_OPEN;
 }
 
-void QSynth::flushMIDIQueue() {
-	midiMutex.lock();
+// Gives the calling thread exclusive access to the synth, waiting for the block being rendered to complete if any.
+// Meanwhile, render() outputs silence rather than waiting in turn. Not reentrant.
+void QSynth::lockSynth() {
 	synthMutex->lock();
-	// Drain synth's queue first
-	synth->flushMIDIQueue();
+	while (!renderGate.testAndSetAcquire(RENDER_GATE_FREE, RENDER_GATE_EXCLUSIVE)) {
+		QThread::yieldCurrentThread();
+	}
+}
+
+void QSynth::unlockSynth() {
+	renderGate.storeRelease(RENDER_GATE_FREE);
 	synthMutex->unlock();
+}
+
+// The synth's queue is flushed or discarded by the rendering thread at the start of the next audio block, so audio doesn't drop out.
+// Meanwhile, midiMutex keeps the events arriving from other threads out of the queue.
+void QSynth::flushMIDIQueue() {
+	midiMutex.lock();
+	ControlCommand command;
+	command.type = ControlCommandType_FLUSH_MIDI_QUEUE;
+	if (pushControlCommand(command)) waitForControlCommands();
 	midiMutex.unlock();
 }
 
+void QSynth::discardMIDIQueue() {
+	midiMutex.lock();
+	ControlCommand command;
+	command.type = ControlCommandType_DISCARD_MIDI_QUEUE;
+	if (pushControlCommand(command)) waitForControlCommands();
+	midiMutex.unlock();
+}
+
+// The immediate messages are played by the rendering thread at the start of the next audio block,
+// after any commands pushed before and ahead of the enqueued MIDI events
 void QSynth::playMIDIShortMessageNow(Bit32u msg) {
-	synthMutex->lock();
-	if (!isOpen()) {
-		synthMutex->unlock();
-		return;
-	}
-	synth->playMsgNow(msg);
-	synthMutex->unlock();
+	ControlCommand command;
+	command.type = ControlCommandType_PLAY_MSG_NOW;
+	command.intValue = int(msg);
+	pushControlCommand(command);
 }
 
-void QSynth::playMIDISysexNow(const Bit8u *sysex, Bit32u sysexLen) {
-	synthMutex->lock();
-	if (!isOpen()) {
-		synthMutex->unlock();
-		return;
-	}
-	synth->playSysexNow(sysex, sysexLen);
-	synthMutex->unlock();
+// Returns false if the synth is closed or the message is longer than the synth accepts
+bool QSynth::playMIDISysexNow(const Bit8u *sysex, Bit32u sysexLen) {
+	if (ControlCommand::MAX_SYSEX_LENGTH < sysexLen) return false;
+	return pushSysexControlCommand(ControlCommandType_PLAY_SYSEX_NOW, sysex, sysexLen);
 }
 
 bool QSynth::playMIDIShortMessage(Bit32u msg, quint64 timestamp) {
@@ -153,6 +246,9 @@ bool QSynth::playMIDIShortMessage(Bit32u msg, quint64 timestamp) {
 		return false;
 	}
 	bool eventPushed = synth->playMsg(msg, convertOutputToSynthTimestamp(timestamp));
+	if (midiTraceBuffer != NULL && midiTraceBuffer->isEnabled()) {
+		midiTraceBuffer->addInstantEvent("midi", eventPushed ? "shortMessage" : "shortMessageRejected", "status", msg & 0xFF, "timestamp", timestamp);
+	}
 	midiMutex.unlock();
 	return eventPushed;
 }
@@ -164,30 +260,45 @@ bool QSynth::playMIDISysex(const Bit8u *sysex, Bit32u sysexLen, quint64 timestam
 		return false;
 	}
 	bool eventPushed = synth->playSysex(sysex, sysexLen, convertOutputToSynthTimestamp(timestamp));
+	if (midiTraceBuffer != NULL && midiTraceBuffer->isEnabled()) {
+		midiTraceBuffer->addInstantEvent("midi", eventPushed ? "sysex" : "sysexRejected", "length", sysexLen, "timestamp", timestamp);
+	}
 	midiMutex.unlock();
 	return eventPushed;
 }
 
 Bit32u QSynth::convertOutputToSynthTimestamp(quint64 timestamp) {
-	return Bit32u(timestamp * sampleRateRatio);
+	quint64 skippedFrames = uint(skippedFrameCount.loadAcquire());
+	return Bit32u((timestamp > skippedFrames ? timestamp - skippedFrames : 0) * sampleRateRatio);
 }
 
 void QSynth::render(Bit16s *buffer, uint length) {
-	synthMutex->lock();
+	RealtimeChecker::Section realtimeSection("QSynth::render");
+	if (!renderGate.testAndSetAcquire(RENDER_GATE_FREE, RENDER_GATE_RENDERING)) {
+		// Another thread holds the synth exclusively, see lockSynth()
+		if (renderTraceBuffer != NULL && renderTraceBuffer->isEnabled()) renderTraceBuffer->addInstantEvent("lock", "renderGateBusy", "frames", length);
+		skippedFrameCount.fetchAndAddRelease(length);
+		memset(buffer, 0, length << 2);
+		emit audioBlockRendered();
+		return;
+	}
 	if (!isOpen()) {
-		synthMutex->unlock();
+		renderGate.storeRelease(RENDER_GATE_FREE);
 
 		// Synth is closed, simply erase buffer content
 		memset(buffer, 0, length << 2);
 		emit audioBlockRendered();
 		return;
 	}
+	applyControlCommands();
 #if MT32EMU_USE_FLOAT_SAMPLES
 	float fBuf[2 * MAX_SAMPLES_PER_RUN];
 	while (0 < length) {
 		uint framesToRender = qMin(length, MAX_SAMPLES_PER_RUN);
 		if (sampleRateConverter != NULL) {
+			synth->startResamplingStage();
 			sampleRateConverter->getOutputSamples(fBuf, framesToRender);
+			synth->endResamplingStage();
 		} else {
 			synth->render(fBuf, framesToRender);
 		}
@@ -198,15 +309,38 @@ void QSynth::render(Bit16s *buffer, uint length) {
 	}
 #else
 	if (sampleRateConverter != NULL) {
+		synth->startResamplingStage();
 		sampleRateConverter->getOutputSamples(buffer, length);
+		synth->endResamplingStage();
 	} else {
 		synth->render(buffer, length);
 	}
 #endif
-	synthMutex->unlock();
+	publishStateSnapshot();
+	renderGate.storeRelease(RENDER_GATE_FREE);
 	emit audioBlockRendered();
 }
 
+void QSynth::publishStateSnapshot() {
+	SynthStateSnapshot &snapshot = stateSnapshots[backStateSnapshotIndex];
+	snapshot.partialCount = synth->getPartialCount();
+	synth->getPartStates(snapshot.partStates);
+	synth->getPartialStates(snapshot.partialStates);
+	for (unsigned int partNumber = 0; partNumber < 9; partNumber++) {
+		snapshot.playingNoteCounts[partNumber] = synth->getPlayingNotes(partNumber, snapshot.keysOfPlayingNotes[partNumber], snapshot.velocitiesOfPlayingNotes[partNumber]);
+		qstrncpy(snapshot.patchNames[partNumber], synth->getPatchName(partNumber), sizeof snapshot.patchNames[partNumber]);
+	}
+	snapshot.active = synth->isActive();
+	backStateSnapshotIndex = stateSnapshotExchange.fetchAndStoreAcqRel(backStateSnapshotIndex | TRIPLE_BUFFER_UPDATED) & TRIPLE_BUFFER_INDEX_MASK;
+}
+
+const SynthStateSnapshot &QSynth::getStateSnapshot() const {
+	if (stateSnapshotExchange.loadAcquire() & TRIPLE_BUFFER_UPDATED) {
+		frontStateSnapshotIndex = stateSnapshotExchange.fetchAndStoreAcqRel(frontStateSnapshotIndex) & TRIPLE_BUFFER_INDEX_MASK;
+	}
+	return stateSnapshots[frontStateSnapshotIndex];
+}
+
 bool QSynth::open(uint targetSampleRate, SampleRateConverter::SRCQuality srcQuality, const QString useSynthProfileName) {
 	if (isOpen()) {
 		return true;
@@ -225,17 +359,31 @@ bool QSynth::open(uint targetSampleRate, SampleRateConverter::SRCQuality srcQual
 	actualAnalogOutputMode = synthProfile.analogOutputMode;
 	static const char *ANALOG_OUTPUT_MODES[] = {"Digital only", "Coarse", "Accurate"};
 	qDebug() << "Using Analogue output mode:" << ANALOG_OUTPUT_MODES[actualAnalogOutputMode];
+	if (renderTraceBuffer == NULL) {
+		// The buffers are only created when tracing is requested, and are kept for the lifetime of the recorder
+		renderTraceBuffer = Master::getInstance()->createTraceBuffer("Synth rendering");
+		midiTraceBuffer = Master::getInstance()->createTraceBuffer("Synth MIDI input");
+	}
+	synth->setTraceBuffer(renderTraceBuffer);
+	synth->setPartRefreshCoalescingEnabled(Master::getInstance()->getSettings()->value("Master/partRefreshCoalescing", false).toBool());
+	synth->setInaudiblePartialCullingEnabled(Master::getInstance()->getSettings()->value("Master/inaudiblePartialCulling", false).toBool());
+	synth->setRenderProfilingEnabled(Master::getInstance()->getSettings()->value("Master/renderProfiling", false).toBool());
 	if (synth->open(*controlROMImage, *pcmROMImage, actualAnalogOutputMode)) {
-		setState(SynthState_OPEN);
-		reportHandler.onDeviceReconfig();
-		setSynthProfile(synthProfile, synthProfileName);
-		if (engageChannel1OnOpen) resetMIDIChannelsAssignment(true);
+		// render() doesn't touch the synth until the state changes, so everything it uses is set up before
 		if (targetSampleRate > 0 && targetSampleRate != getSynthSampleRate()) {
 			sampleRateConverter = SampleRateConverter::createSampleRateConverter(synth, targetSampleRate, srcQuality);
 			sampleRateRatio = SAMPLE_RATE / (double)targetSampleRate;
 		} else {
 			sampleRateRatio = SAMPLE_RATE / (double)getSynthSampleRate();
 		}
+		// The GUI may query the snapshot as soon as the state changes
+		publishStateSnapshot();
+		// The new synth and the audio stream started anew both count the frames from 0
+		skippedFrameCount.storeRelease(0);
+		setState(SynthState_OPEN);
+		reportHandler.onDeviceReconfig();
+		setSynthProfile(synthProfile, synthProfileName);
+		if (engageChannel1OnOpen) resetMIDIChannelsAssignment(true);
 		return true;
 	}
 	// We're now in a partially-open state - better to properly close.
@@ -245,56 +393,160 @@ bool QSynth::open(uint targetSampleRate, SampleRateConverter::SRCQuality srcQual
 	return false;
 }
 
-void QSynth::setMasterVolume(int masterVolume) {
-	Bit8u sysex[] = {0x10, 0x00, 0x16, (Bit8u)masterVolume};
-
-	synthMutex->lock();
-	if (!isOpen()) {
-		synthMutex->unlock();
-		return;
+// Returns false if the synth is closed, the command is dropped then
+bool QSynth::pushControlCommand(const ControlCommand &command) {
+	for (uint wait = 0;; wait++) {
+		controlMutex.lock();
+		if (!isOpen()) {
+			controlMutex.unlock();
+			return false;
+		}
+		int writeIndex = controlCommandsWriteIndex.loadAcquire();
+		int nextWriteIndex = (writeIndex + 1) % CONTROL_COMMAND_QUEUE_SIZE;
+		if (nextWriteIndex == controlCommandsReadIndex.loadAcquire()) {
+			if (wait < MAX_CONTROL_COMMAND_WAITS) {
+				// The rendering thread drains the ring at the next block boundary, let other producers proceed meanwhile
+				controlMutex.unlock();
+				QThread::msleep(CONTROL_COMMAND_WAIT_MILLIS);
+				continue;
+			}
+			// Audio rendering must be stalled, so apply the pending commands here rather than drop any
+			lockSynth();
+			if (isOpen()) applyControlCommands();
+			unlockSynth();
+		}
+		controlCommands[writeIndex] = command;
+		controlCommandsWriteIndex.storeRelease(nextWriteIndex);
+		controlCommandsPushedCount++;
+		controlMutex.unlock();
+		return true;
 	}
-	synth->writeSysex(16, sysex, 4);
-	synthMutex->unlock();
 }
 
-void QSynth::setOutputGain(float outputGain) {
-	synthMutex->lock();
-	if (!isOpen()) {
-		synthMutex->unlock();
-		return;
-	}
-	synth->setOutputGain(outputGain);
-	synthMutex->unlock();
+bool QSynth::pushSysexControlCommand(ControlCommandType type, const Bit8u *sysex, uint sysexLength) {
+	ControlCommand command;
+	command.type = type;
+	memcpy(command.sysex, sysex, sysexLength);
+	command.sysexLength = sysexLength;
+	return pushControlCommand(command);
 }
 
-void QSynth::setReverbOutputGain(float reverbOutputGain) {
-	synthMutex->lock();
-	if (!isOpen()) {
-		synthMutex->unlock();
-		return;
+// Waits until the commands pushed so far are applied by the rendering thread, or applies them here if rendering is stalled
+void QSynth::waitForControlCommands() {
+	controlMutex.lock();
+	uint pushedCount = controlCommandsPushedCount;
+	controlMutex.unlock();
+	for (uint wait = 0; wait < MAX_CONTROL_COMMAND_WAITS; wait++) {
+		if (int(pushedCount - uint(controlCommandsAppliedCount.loadAcquire())) <= 0) return;
+		QThread::msleep(CONTROL_COMMAND_WAIT_MILLIS);
 	}
-	synth->setReverbOutputGain(reverbOutputGain);
-	synthMutex->unlock();
+	controlMutex.lock();
+	if (isOpen()) {
+		lockSynth();
+		applyControlCommands();
+		unlockSynth();
+	}
+	controlMutex.unlock();
 }
 
-void QSynth::setReverbEnabled(bool reverbEnabled) {
-	synthMutex->lock();
-	if (!isOpen()) {
-		synthMutex->unlock();
-		return;
+void QSynth::applyControlCommands() {
+	int readIndex = controlCommandsReadIndex.loadAcquire();
+	int writeIndex = controlCommandsWriteIndex.loadAcquire();
+	int appliedCount = 0;
+	while (readIndex != writeIndex) {
+		applyControlCommand(controlCommands[readIndex]);
+		readIndex = (readIndex + 1) % CONTROL_COMMAND_QUEUE_SIZE;
+		appliedCount++;
+	}
+	controlCommandsReadIndex.storeRelease(readIndex);
+	controlCommandsAppliedCount.fetchAndAddRelease(appliedCount);
+}
+
+void QSynth::applyControlCommand(const ControlCommand &command) {
+	switch (command.type) {
+	case ControlCommandType_SET_OUTPUT_GAIN:
+		synth->setOutputGain(command.floatValue);
+		break;
+	case ControlCommandType_SET_REVERB_OUTPUT_GAIN:
+		synth->setReverbOutputGain(command.floatValue);
+		break;
+	case ControlCommandType_SET_REVERB_ENABLED:
+		synth->setReverbEnabled(command.intValue != 0);
+		break;
+	case ControlCommandType_SET_REVERB_OVERRIDDEN:
+		synth->setReverbOverridden(command.intValue != 0);
+		break;
+	case ControlCommandType_SET_REVERSED_STEREO_ENABLED:
+		synth->setReversedStereoEnabled(command.intValue != 0);
+		break;
+	case ControlCommandType_SET_REVERB_COMPATIBILITY_MODE:
+		synth->setReverbCompatibilityMode(command.intValue != 0);
+		break;
+	case ControlCommandType_SET_MIDI_DELAY_MODE:
+		synth->setMIDIDelayMode(MIDIDelayMode(command.intValue));
+		break;
+	case ControlCommandType_SET_DAC_INPUT_MODE:
+		synth->setDACInputMode(DACInputMode(command.intValue));
+		break;
+	case ControlCommandType_WRITE_SYSEX:
+		synth->writeSysex(16, command.sysex, command.sysexLength);
+		break;
+	case ControlCommandType_WRITE_REVERB_SYSEX:
+		// The reverb settings are written bypassing the override and remain overridden
+		synth->setReverbOverridden(false);
+		synth->writeSysex(16, command.sysex, command.sysexLength);
+		synth->setReverbOverridden(true);
+		break;
+	case ControlCommandType_PLAY_MSG_NOW:
+		synth->playMsgNow(Bit32u(command.intValue));
+		break;
+	case ControlCommandType_PLAY_SYSEX_NOW:
+		synth->playSysexNow(command.sysex, command.sysexLength);
+		break;
+	case ControlCommandType_FLUSH_MIDI_QUEUE:
+		synth->flushMIDIQueue();
+		break;
+	case ControlCommandType_DISCARD_MIDI_QUEUE:
+		synth->discardMIDIQueue();
+		break;
 	}
-	synth->setReverbEnabled(reverbEnabled);
-	synthMutex->unlock();
 }
 
-void QSynth::setReverbOverridden(bool reverbOverridden) {
-	synthMutex->lock();
-	if (!isOpen()) {
-		synthMutex->unlock();
-		return;
-	}
-	synth->setReverbOverridden(reverbOverridden);
-	synthMutex->unlock();
+void QSynth::setMasterVolume(int masterVolume) {
+	Bit8u sysex[] = {0x10, 0x00, 0x16, (Bit8u)masterVolume};
+	pushSysexControlCommand(ControlCommandType_WRITE_SYSEX, sysex, sizeof(sysex));
+}
+
+void QSynth::setOutputGain(float useOutputGain) {
+	outputGain = useOutputGain;
+	ControlCommand command;
+	command.type = ControlCommandType_SET_OUTPUT_GAIN;
+	command.floatValue = useOutputGain;
+	pushControlCommand(command);
+}
+
+void QSynth::setReverbOutputGain(float useReverbOutputGain) {
+	reverbOutputGain = useReverbOutputGain;
+	ControlCommand command;
+	command.type = ControlCommandType_SET_REVERB_OUTPUT_GAIN;
+	command.floatValue = useReverbOutputGain;
+	pushControlCommand(command);
+}
+
+void QSynth::setReverbEnabled(bool useReverbEnabled) {
+	reverbEnabled = useReverbEnabled;
+	ControlCommand command;
+	command.type = ControlCommandType_SET_REVERB_ENABLED;
+	command.intValue = useReverbEnabled;
+	pushControlCommand(command);
+}
+
+void QSynth::setReverbOverridden(bool useReverbOverridden) {
+	reverbOverridden = useReverbOverridden;
+	ControlCommand command;
+	command.type = ControlCommandType_SET_REVERB_OVERRIDDEN;
+	command.intValue = useReverbOverridden;
+	pushControlCommand(command);
 }
 
 void QSynth::setReverbSettings(int reverbMode, int reverbTime, int reverbLevel) {
@@ -302,38 +554,22 @@ void QSynth::setReverbSettings(int reverbMode, int reverbTime, int reverbLevel)
 	this->reverbTime = reverbTime;
 	this->reverbLevel = reverbLevel;
 	Bit8u sysex[] = {0x10, 0x00, 0x01, (Bit8u)reverbMode, (Bit8u)reverbTime, (Bit8u)reverbLevel};
-
-	synthMutex->lock();
-	if (!isOpen()) {
-		synthMutex->unlock();
-		return;
-	}
-	synth->setReverbOverridden(false);
-	synth->writeSysex(16, sysex, 6);
-	synth->setReverbOverridden(true);
-	synthMutex->unlock();
+	if (isOpen()) reverbOverridden = true;
+	pushSysexControlCommand(ControlCommandType_WRITE_REVERB_SYSEX, sysex, sizeof(sysex));
 }
 
 void QSynth::setReversedStereoEnabled(bool enabled) {
-	synthMutex->lock();
-	if (!isOpen()) {
-		synthMutex->unlock();
-		return;
-	}
-	synth->setReversedStereoEnabled(enabled);
-	synthMutex->unlock();
+	reversedStereoEnabled = enabled;
+	ControlCommand command;
+	command.type = ControlCommandType_SET_REVERSED_STEREO_ENABLED;
+	command.intValue = enabled;
+	pushControlCommand(command);
 }
 
 void QSynth::resetMIDIChannelsAssignment(bool engageChannel1) {
 	static const Bit8u sysexStandardChannelAssignment[] = {0x10, 0x00, 0x0d, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09};
 	static const Bit8u sysexChannel1EngagedAssignment[] = {0x10, 0x00, 0x0d, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x09};
-	synthMutex->lock();
-	if (!isOpen()) {
-		synthMutex->unlock();
-		return;
-	}
-	synth->writeSysex(16, engageChannel1 ? sysexChannel1EngagedAssignment : sysexStandardChannelAssignment, sizeof(sysexStandardChannelAssignment));
-	synthMutex->unlock();
+	pushSysexControlCommand(ControlCommandType_WRITE_SYSEX, engageChannel1 ? sysexChannel1EngagedAssignment : sysexStandardChannelAssignment, sizeof(sysexStandardChannelAssignment));
 }
 
 void QSynth::setInitialMIDIChannelsAssignment(bool engageChannel1) {
@@ -342,39 +578,33 @@ void QSynth::setInitialMIDIChannelsAssignment(bool engageChannel1) {
 
 void QSynth::setReverbCompatibilityMode(ReverbCompatibilityMode useReverbCompatibilityMode) {
 	reverbCompatibilityMode = useReverbCompatibilityMode;
-	synthMutex->lock();
-	if (!isOpen()) {
-		synthMutex->unlock();
-		return;
-	}
+	if (!isOpen()) return;
 	bool mt32CompatibleReverb;
 	if (useReverbCompatibilityMode == ReverbCompatibilityMode_DEFAULT) {
 		mt32CompatibleReverb = controlROMImage->getROMInfo()->controlROMFeatures->isDefaultReverbMT32Compatible();
 	} else {
 		mt32CompatibleReverb = useReverbCompatibilityMode == ReverbCompatibilityMode_MT32;
 	}
-	synth->setReverbCompatibilityMode(mt32CompatibleReverb);
-	synthMutex->unlock();
+	ControlCommand command;
+	command.type = ControlCommandType_SET_REVERB_COMPATIBILITY_MODE;
+	command.intValue = mt32CompatibleReverb;
+	pushControlCommand(command);
 }
 
-void QSynth::setMIDIDelayMode(MIDIDelayMode midiDelayMode) {
-	synthMutex->lock();
-	if (!isOpen()) {
-		synthMutex->unlock();
-		return;
-	}
-	synth->setMIDIDelayMode(midiDelayMode);
-	synthMutex->unlock();
+void QSynth::setMIDIDelayMode(MIDIDelayMode useMIDIDelayMode) {
+	midiDelayMode = useMIDIDelayMode;
+	ControlCommand command;
+	command.type = ControlCommandType_SET_MIDI_DELAY_MODE;
+	command.intValue = useMIDIDelayMode;
+	pushControlCommand(command);
 }
 
-void QSynth::setDACInputMode(DACInputMode emuDACInputMode) {
-	synthMutex->lock();
-	if (!isOpen()) {
-		synthMutex->unlock();
-		return;
-	}
-	synth->setDACInputMode(emuDACInputMode);
-	synthMutex->unlock();
+void QSynth::setDACInputMode(DACInputMode useEmuDACInputMode) {
+	emuDACInputMode = useEmuDACInputMode;
+	ControlCommand command;
+	command.type = ControlCommandType_SET_DAC_INPUT_MODE;
+	command.intValue = useEmuDACInputMode;
+	pushControlCommand(command);
 }
 
 void QSynth::setAnalogOutputMode(MT32Emu::AnalogOutputMode useAnalogOutputMode) {
@@ -382,41 +612,36 @@ void QSynth::setAnalogOutputMode(MT32Emu::AnalogOutputMode useAnalogOutputMode)
 }
 
 const QString QSynth::getPatchName(int partNum) const {
-	synthMutex->lock();
-	QString name = isOpen() ? QString().fromLocal8Bit(synth->getPatchName(partNum)) : QString("Channel %1").arg(partNum + 1);
-	synthMutex->unlock();
-	return name;
+	if (!isOpen()) return QString("Channel %1").arg(partNum + 1);
+	return QString().fromLocal8Bit(getStateSnapshot().patchNames[partNum]);
 }
 
 void QSynth::getPartStates(bool *partStates) const {
-	synthMutex->lock();
 	if (isOpen()) {
-		synth->getPartStates(partStates);
+		const SynthStateSnapshot &snapshot = getStateSnapshot();
+		memcpy(partStates, snapshot.partStates, sizeof snapshot.partStates);
 	}
-	synthMutex->unlock();
 }
 
 void QSynth::getPartialStates(MT32Emu::PartialState *partialStates) const {
-	synthMutex->lock();
 	if (isOpen()) {
-		synth->getPartialStates(partialStates);
+		const SynthStateSnapshot &snapshot = getStateSnapshot();
+		memcpy(partialStates, snapshot.partialStates, snapshot.partialCount * sizeof(PartialState));
 	}
-	synthMutex->unlock();
 }
 
 unsigned int QSynth::getPlayingNotes(unsigned int partNumber, Bit8u *keys, Bit8u *velocities) const {
-	unsigned int playingNotes = 0;
-	synthMutex->lock();
-	playingNotes = synth->getPlayingNotes(partNumber, keys, velocities);
-	synthMutex->unlock();
+	if (!isOpen()) return 0;
+	const SynthStateSnapshot &snapshot = getStateSnapshot();
+	unsigned int playingNotes = snapshot.playingNoteCounts[partNumber];
+	memcpy(keys, snapshot.keysOfPlayingNotes[partNumber], playingNotes);
+	memcpy(velocities, snapshot.velocitiesOfPlayingNotes[partNumber], playingNotes);
 	return playingNotes;
 }
 
+// The partial count only changes when the synth is opened, which happens in the calling thread
 unsigned int QSynth::getPartialCount() const {
-	synthMutex->lock();
-	unsigned int partialCount = synth->getPartialCount();
-	synthMutex->unlock();
-	return partialCount;
+	return synth->getPartialCount();
 }
 
 unsigned int QSynth::getSynthSampleRate() const {
@@ -424,23 +649,23 @@ unsigned int QSynth::getSynthSampleRate() const {
 }
 
 bool QSynth::isActive() const {
-	synthMutex->lock();
-	if (!isOpen()) {
-		synthMutex->unlock();
-		return false;
-	}
-	bool result = synth->isActive();
-	synthMutex->unlock();
-	return result;
+	return isOpen() && getStateSnapshot().active;
 }
 
 bool QSynth::reset() {
 	if (!isOpen()) return true;
+	pushSysexControlCommand(ControlCommandType_WRITE_SYSEX, RESET_SYSEX, sizeof(RESET_SYSEX));
+	return true;
+}
+
+// Reopens the synth with the current ROM images, which is only needed when they change
+bool QSynth::reopen() {
+	if (!isOpen()) return true;
 
 	setState(SynthState_CLOSING);
 
 	midiMutex.lock();
-	synthMutex->lock();
+	lockSynth();
 	synth->close();
 	// Do not delete synth here to keep the rendered frame counter value, audioStream is also alive during reset
 	if (!synth->open(*controlROMImage, *pcmROMImage, actualAnalogOutputMode)) {
@@ -448,12 +673,13 @@ bool QSynth::reset() {
 		synth->close(true);
 		delete synth;
 		synth = new Synth(&reportHandler);
-		synthMutex->unlock();
+		unlockSynth();
 		midiMutex.unlock();
 		setState(SynthState_CLOSED);
 		return false;
 	}
-	synthMutex->unlock();
+	publishStateSnapshot();
+	unlockSynth();
 	midiMutex.unlock();
 	reportHandler.onDeviceReconfig();
 
@@ -471,7 +697,12 @@ void QSynth::close() {
 	if (!isOpen()) return;
 	setState(SynthState_CLOSING);
 	midiMutex.lock();
-	synthMutex->lock();
+	controlMutex.lock();
+	lockSynth();
+	// Pending control commands are void, the values requested are reapplied from the profile on open
+	controlCommandsReadIndex.storeRelease(controlCommandsWriteIndex.loadAcquire());
+	controlCommandsAppliedCount.storeRelease(int(controlCommandsPushedCount));
+	if (synth->isRenderProfilingEnabled()) logRenderProfile();
 	synth->close();
 	// This effectively resets rendered frame counter, audioStream is also going down
 	delete synth;
@@ -480,33 +711,43 @@ void QSynth::close() {
 		delete sampleRateConverter;
 		sampleRateConverter = NULL;
 	}
-	synthMutex->unlock();
+	unlockSynth();
+	controlMutex.unlock();
 	midiMutex.unlock();
 	setState(SynthState_CLOSED);
 	freeROMImages();
 }
 
+void QSynth::logRenderProfile() const {
+	static const char * const RENDER_STAGE_NAMES[] = {"MIDI dispatch", "partials", "LA32 output", "reverb", "output conversion", "analog", "resampling"};
+	RenderProfile profile;
+	synth->getRenderProfile(profile);
+	qDebug() << "QSynth: Render profile:" << profile.renderCalls << "render calls," << profile.renderNanos * 1e-6 << "ms,"
+		<< profile.renderSliceCount << "slices," << profile.renderedSampleCount << "samples";
+	for (int stage = 0; stage < RenderStage_COUNT; stage++) {
+		qDebug() << "QSynth: Stage" << RENDER_STAGE_NAMES[stage] << ":" << profile.stageNanos[stage] * 1e-6 << "ms in" << profile.stageCalls[stage] << "calls";
+	}
+}
+
 void QSynth::getSynthProfile(SynthProfile &synthProfile) const {
-	synthMutex->lock();
 	synthProfile.romDir = romDir;
 	synthProfile.controlROMFileName = controlROMFileName;
 	synthProfile.pcmROMFileName = pcmROMFileName;
 	synthProfile.controlROMImage = controlROMImage;
 	synthProfile.pcmROMImage = pcmROMImage;
-	synthProfile.emuDACInputMode = synth->getDACInputMode();
-	synthProfile.midiDelayMode = synth->getMIDIDelayMode();
+	synthProfile.emuDACInputMode = emuDACInputMode;
+	synthProfile.midiDelayMode = midiDelayMode;
 	synthProfile.analogOutputMode = analogOutputMode;
 	synthProfile.reverbCompatibilityMode = reverbCompatibilityMode;
-	synthProfile.outputGain = synth->getOutputGain();
-	synthProfile.reverbOutputGain = synth->getReverbOutputGain();
-	synthProfile.reverbEnabled = synth->isReverbEnabled();
-	synthProfile.reverbOverridden = synth->isReverbOverridden();
+	synthProfile.outputGain = outputGain;
+	synthProfile.reverbOutputGain = reverbOutputGain;
+	synthProfile.reverbEnabled = reverbEnabled;
+	synthProfile.reverbOverridden = reverbOverridden;
 	synthProfile.reverbMode = reverbMode;
 	synthProfile.reverbTime = reverbTime;
 	synthProfile.reverbLevel = reverbLevel;
-	synthProfile.reversedStereoEnabled = synth->isReversedStereoEnabled();
+	synthProfile.reversedStereoEnabled = reversedStereoEnabled;
 	synthProfile.engageChannel1OnOpen = engageChannel1OnOpen;
-	synthMutex->unlock();
 }
 
 void QSynth::setSynthProfile(const SynthProfile &synthProfile, QString useSynthProfileName) {
@@ -525,7 +766,7 @@ void QSynth::setSynthProfile(const SynthProfile &synthProfile, QString useSynthP
 			freeROMImages();
 			controlROMImage = synthProfile.controlROMImage;
 			pcmROMImage = synthProfile.pcmROMImage;
-			reset();
+			reopen();
 		}
 	}
 	setReverbCompatibilityMode(synthProfile.reverbCompatibilityMode);
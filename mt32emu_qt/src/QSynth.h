@@ -39,11 +39,80 @@ struct SynthProfile {
 	bool engageChannel1OnOpen;
 };
 
+enum ControlCommandType {
+	ControlCommandType_SET_OUTPUT_GAIN,
+	ControlCommandType_SET_REVERB_OUTPUT_GAIN,
+	ControlCommandType_SET_REVERB_ENABLED,
+	ControlCommandType_SET_REVERB_OVERRIDDEN,
+	ControlCommandType_SET_REVERSED_STEREO_ENABLED,
+	ControlCommandType_SET_REVERB_COMPATIBILITY_MODE,
+	ControlCommandType_SET_MIDI_DELAY_MODE,
+	ControlCommandType_SET_DAC_INPUT_MODE,
+	ControlCommandType_WRITE_SYSEX,
+	ControlCommandType_WRITE_REVERB_SYSEX,
+	ControlCommandType_PLAY_MSG_NOW,
+	ControlCommandType_PLAY_SYSEX_NOW,
+	ControlCommandType_FLUSH_MIDI_QUEUE,
+	ControlCommandType_DISCARD_MIDI_QUEUE
+};
+
+// Parameter change or immediate MIDI message requested by another thread, applied by the rendering thread at the start of the next audio block
+struct ControlCommand {
+	static const uint MAX_SYSEX_LENGTH = MT32Emu::MAX_SYSEX_SIZE;
+
+	ControlCommandType type;
+	float floatValue;
+	int intValue;
+	MT32Emu::Bit8u sysex[MAX_SYSEX_LENGTH];
+	uint sysexLength;
+};
+
 class SampleRateConverter;
 
+// State of the synth captured by the rendering thread at the end of an audio block, for display purposes.
+// QSynth always opens the synth with DEFAULT_MAX_PARTIALS partials.
+struct SynthStateSnapshot {
+	unsigned int partialCount;
+	bool partStates[9];
+	MT32Emu::PartialState partialStates[MT32Emu::DEFAULT_MAX_PARTIALS];
+	unsigned int playingNoteCounts[9];
+	MT32Emu::Bit8u keysOfPlayingNotes[9][MT32Emu::DEFAULT_MAX_PARTIALS];
+	MT32Emu::Bit8u velocitiesOfPlayingNotes[9][MT32Emu::DEFAULT_MAX_PARTIALS];
+	char patchNames[9][11];
+	bool active;
+};
+
+// Notifications reported by the synth, accumulated since QReportHandler creation
+struct ReportedEvents {
+	uint midiMessageCount;
+	uint polyStateChangeCounts[9];
+	uint programChangeCounts[9];
+	int timbreGroups[9];
+	char patchNames[9][11];
+};
+
 class QReportHandler : public QObject, public MT32Emu::ReportHandler {
 	Q_OBJECT
 
+private:
+	// When coalescing is enabled (setting Master/reportEventsDeliveryInterval is non-zero), the frequent notifications
+	// (MIDI message played, poly state and program changes) are not signalled immediately from the synth thread.
+	// They are accumulated in pendingEvents and published via a triple buffer (like the synth state snapshots in QSynth),
+	// then the GUI thread signals the parts changed since the previous delivery at the configured interval.
+	bool coalescing;
+	ReportedEvents pendingEvents;
+	ReportedEvents publishedEvents[3];
+	QAtomicInt publishedEventsExchange;
+	int backPublishedEventsIndex;
+	int frontPublishedEventsIndex;
+	ReportedEvents deliveredEvents;
+	QTimer deliveryTimer;
+
+	void publishEvents();
+
+private slots:
+	void deliverEvents();
+
 public:
 	QReportHandler(QObject *parent = NULL);
 	void showLCDMessage(const char *message);
@@ -76,10 +145,23 @@ class QSynth : public QObject {
 friend class QReportHandler;
 
 private:
+	static const int CONTROL_COMMAND_QUEUE_SIZE = 64;
+
 	volatile SynthState state;
 
 	QMutex midiMutex;
+	// Serialises the threads which need the synth exclusively (the open/close transitions and other rare operations),
+	// never taken by the rendering thread. See lockSynth().
 	QMutex *synthMutex;
+	// Set to RENDER_GATE_RENDERING by render() for the duration of a block, and to RENDER_GATE_EXCLUSIVE by lockSynth().
+	// render() never waits for it, the block is silent while the synth is held exclusively.
+	QAtomicInt renderGate;
+	// Number of output frames render() filled with silence as the gate was busy. The synth does not advance meanwhile,
+	// so this is subtracted from the MIDI timestamps to keep them aligned with the rendered frames.
+	QAtomicInt skippedFrameCount;
+	// Serialises the threads pushing control commands, never taken by the rendering thread.
+	// When needed along with midiMutex, it must be locked after midiMutex.
+	QMutex controlMutex;
 
 	QDir romDir;
 	QString controlROMFileName;
@@ -94,6 +176,15 @@ private:
 	ReverbCompatibilityMode reverbCompatibilityMode;
 	bool engageChannel1OnOpen;
 
+	// Values last requested via the setters, they take effect in the synth once the corresponding commands are applied
+	float outputGain;
+	float reverbOutputGain;
+	bool reverbEnabled;
+	bool reverbOverridden;
+	bool reversedStereoEnabled;
+	MT32Emu::MIDIDelayMode midiDelayMode;
+	MT32Emu::DACInputMode emuDACInputMode;
+
 	MT32Emu::Synth *synth;
 	QReportHandler reportHandler;
 	QString synthProfileName;
@@ -101,9 +192,43 @@ private:
 	double sampleRateRatio;
 	SampleRateConverter *sampleRateConverter;
 
+	// Filled under synthMutex (by the rendering thread mostly) and under midiMutex respectively, NULL unless tracing
+	MT32Emu::TraceBuffer *renderTraceBuffer;
+	MT32Emu::TraceBuffer *midiTraceBuffer;
+
+	// Triple buffer of state snapshots. The rendering thread fills the back snapshot and swaps it with the middle one,
+	// the GUI thread swaps the middle snapshot with the front one when it has been updated. Neither side ever waits.
+	// The exchange holds the index of the middle snapshot plus TRIPLE_BUFFER_UPDATED flag.
+	SynthStateSnapshot stateSnapshots[3];
+	mutable QAtomicInt stateSnapshotExchange;
+	int backStateSnapshotIndex;
+	mutable int frontStateSnapshotIndex;
+
+	// Single-consumer ring of pending parameter changes and MIDI queue operations. The rendering thread drains it at block boundaries
+	// without locking, so that moving a slider or stopping playback never stalls audio. When the ring is full, or the producer waits for
+	// the commands to take effect (see waitForControlCommands()) and rendering is stalled, it applies the pending commands itself via lockSynth().
+	ControlCommand controlCommands[CONTROL_COMMAND_QUEUE_SIZE];
+	QAtomicInt controlCommandsReadIndex;
+	QAtomicInt controlCommandsWriteIndex;
+	// Total numbers of the commands pushed (under controlMutex) and applied, they only serve to wait for the commands to take effect
+	uint controlCommandsPushedCount;
+	QAtomicInt controlCommandsAppliedCount;
+
 	void setState(SynthState newState);
+	void lockSynth();
+	void unlockSynth();
+	bool reopen();
 	void freeROMImages();
 	MT32Emu::Bit32u convertOutputToSynthTimestamp(quint64 timestamp);
+	void publishStateSnapshot();
+	// Dumps the data collected by the synth render profiler (enabled by setting Master/renderProfiling) to the debug output
+	void logRenderProfile() const;
+	const SynthStateSnapshot &getStateSnapshot() const;
+	bool pushControlCommand(const ControlCommand &command);
+	bool pushSysexControlCommand(ControlCommandType type, const MT32Emu::Bit8u *sysex, uint sysexLength);
+	void waitForControlCommands();
+	void applyControlCommands();
+	void applyControlCommand(const ControlCommand &command);
 
 public:
 	static void convertSamplesFromNativeEndian(MT32Emu::Bit16s *buffer, uint sampleCount, QSysInfo::Endian targetByteOrder);
@@ -116,8 +241,9 @@ public:
 	bool reset();
 
 	void flushMIDIQueue();
+	void discardMIDIQueue();
 	void playMIDIShortMessageNow(MT32Emu::Bit32u msg);
-	void playMIDISysexNow(const MT32Emu::Bit8u *sysex, MT32Emu::Bit32u sysexLen);
+	bool playMIDISysexNow(const MT32Emu::Bit8u *sysex, MT32Emu::Bit32u sysexLen);
 	bool playMIDIShortMessage(MT32Emu::Bit32u msg, quint64 timestamp);
 	bool playMIDISysex(const MT32Emu::Bit8u *sysex, MT32Emu::Bit32u sysexLen, quint64 timestamp);
 	void render(MT32Emu::Bit16s *buffer, uint length);
@@ -140,13 +266,17 @@ public:
 	void setMIDIDelayMode(MT32Emu::MIDIDelayMode midiDelayMode);
 	void setDACInputMode(MT32Emu::DACInputMode emuDACInputMode);
 	void setAnalogOutputMode(MT32Emu::AnalogOutputMode analogOutputMode);
+
+	// These are served from the latest state snapshot published by render() and never wait for it,
+	// though they must only be called from a single thread (normally the GUI thread)
 	const QString getPatchName(int partNum) const;
 	void getPartStates(bool *partStates) const;
 	void getPartialStates(MT32Emu::PartialState *partialStates) const;
 	unsigned int getPlayingNotes(unsigned int partNumber, MT32Emu::Bit8u *keys, MT32Emu::Bit8u *velocities) const;
+	bool isActive() const;
+
 	unsigned int getPartialCount() const;
 	unsigned int getSynthSampleRate() const;
-	bool isActive() const;
 
 signals:
 	void stateChanged(SynthState state);
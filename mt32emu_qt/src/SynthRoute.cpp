@@ -215,12 +215,16 @@ void SynthRoute::flushMIDIQueue() {
 	qSynth.flushMIDIQueue();
 }
 
+void SynthRoute::discardMIDIQueue() {
+	qSynth.discardMIDIQueue();
+}
+
 void SynthRoute::playMIDIShortMessageNow(Bit32u msg) {
 	qSynth.playMIDIShortMessageNow(msg);
 }
 
-void SynthRoute::playMIDISysexNow(const Bit8u *sysex, Bit32u sysexLen) {
-	qSynth.playMIDISysexNow(sysex, sysexLen);
+bool SynthRoute::playMIDISysexNow(const Bit8u *sysex, Bit32u sysexLen) {
+	return qSynth.playMIDISysexNow(sysex, sysexLen);
 }
 
 bool SynthRoute::playMIDIShortMessage(Bit32u msg, quint64 timestamp) {
@@ -50,8 +50,9 @@ public:
 	unsigned int getPartialCount() const;
 
 	void flushMIDIQueue();
+	void discardMIDIQueue();
 	void playMIDIShortMessageNow(MT32Emu::Bit32u msg);
-	void playMIDISysexNow(const MT32Emu::Bit8u *sysex, MT32Emu::Bit32u sysexLen);
+	bool playMIDISysexNow(const MT32Emu::Bit8u *sysex, MT32Emu::Bit32u sysexLen);
 	bool playMIDIShortMessage(MT32Emu::Bit32u msg, quint64 timestamp);
 	bool playMIDISysex(const MT32Emu::Bit8u *sysex, MT32Emu::Bit32u sysexLen, quint64 timestamp);
 	bool pushMIDIShortMessage(MT32Emu::Bit32u msg, MasterClockNanos midiNanos);
@@ -133,7 +133,8 @@ void SynthWidget::on_audioPropertiesButton_clicked()
 	apd.setCheckText((device->driver.id == "waveout") ? "Use ring buffer renderer" : "Use advanced timing");
 	apd.setData(driverSettings);
 	if (QDialog::Accepted == apd.exec()) {
-		AudioDriverSettings newDriverSettings;
+		// Settings not exposed in the dialog are kept
+		AudioDriverSettings newDriverSettings = driverSettings;
 		apd.getData(newDriverSettings);
 		device->driver.setAudioSettings(newDriverSettings);
 	}
@@ -0,0 +1,95 @@
+/* Copyright (C) 2011, 2012, 2013, 2014 Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QDebug>
+
+#include "AdaptiveLatencyController.h"
+
+// No narrowing happens for this long after the latency was last widened
+static const MasterClockNanos NARROWING_HOLD_NANOS = 10 * MasterClock::NANOS_PER_SECOND;
+// While narrowing, the target latency shrinks by the elapsed time divided by this, i.e. 10 ms per second
+static const quint32 NARROWING_RATE_DIVISOR = 100;
+// The peaks decay by this factor per report, so that a spike is forgotten after a few thousand chunks
+static const double PEAK_DECAY = 0.999;
+
+AdaptiveLatencyController::AdaptiveLatencyController(quint32 useMinFrames, quint32 useMaxFrames, quint32 useChunkFrames, quint32 useSampleRate) :
+	minFrames(useMinFrames), maxFrames(useMaxFrames), chunkFrames(useChunkFrames), sampleRate(useSampleRate),
+	targetFrames(useMaxFrames), peakRenderFrames(0.0), peakJitterFrames(0.0)
+{
+	// Start safe, narrow down once the stream has proved stable
+	lastWideningNanos = MasterClock::getClockNanos();
+	lastNarrowingNanos = lastWideningNanos;
+}
+
+quint32 AdaptiveLatencyController::getFloorFrames() const {
+	quint32 floorFrames = chunkFrames + quint32(2.0 * (peakRenderFrames + peakJitterFrames));
+	return qBound(minFrames, floorFrames, maxFrames);
+}
+
+void AdaptiveLatencyController::setTargetFrames(quint32 newTargetFrames) {
+	if (targetFrames == newTargetFrames) return;
+	qDebug() << "AudioStream: Adaptive latency" << targetFrames << "->" << newTargetFrames << "frames";
+	targetFrames = newTargetFrames;
+}
+
+void AdaptiveLatencyController::reportUnderrun(MasterClockNanos nanosNow) {
+	lastWideningNanos = nanosNow;
+	setTargetFrames(qMin(maxFrames, targetFrames + qMax(targetFrames / 2, chunkFrames)));
+}
+
+void AdaptiveLatencyController::reportRenderTime(MasterClockNanos renderNanos) {
+	double renderFrames = double(renderNanos) * sampleRate / MasterClock::NANOS_PER_SECOND;
+	peakRenderFrames = qMax(renderFrames, peakRenderFrames * PEAK_DECAY);
+}
+
+void AdaptiveLatencyController::reportJitter(quint32 jitterFrames) {
+	peakJitterFrames = qMax(double(jitterFrames), peakJitterFrames * PEAK_DECAY);
+}
+
+void AdaptiveLatencyController::update(MasterClockNanos nanosNow) {
+	quint32 floorFrames = getFloorFrames();
+	if (targetFrames < floorFrames) {
+		lastWideningNanos = nanosNow;
+		setTargetFrames(floorFrames);
+		return;
+	}
+	if (targetFrames == floorFrames) return;
+	if ((nanosNow - lastWideningNanos) < NARROWING_HOLD_NANOS) {
+		lastNarrowingNanos = nanosNow;
+		return;
+	}
+	// The MIDI delay follows the target, it must shrink slower than the time passes to keep the MIDI events in order.
+	// Fractions of a frame accumulate until the next call, and a single step never exceeds a chunk.
+	quint64 elapsedFrames = quint64(nanosNow - lastNarrowingNanos) * sampleRate / MasterClock::NANOS_PER_SECOND;
+	quint32 stepFrames = quint32(qMin(elapsedFrames / NARROWING_RATE_DIVISOR, quint64(chunkFrames)));
+	if (stepFrames == 0) return;
+	lastNarrowingNanos = nanosNow;
+	quint32 newTargetFrames = qMax(floorFrames, targetFrames - qMin(stepFrames, targetFrames));
+	if (newTargetFrames == floorFrames) {
+		setTargetFrames(newTargetFrames);
+	} else {
+		// Not logged while ramping, the change is reported once the floor is reached or the latency widens
+		targetFrames = newTargetFrames;
+	}
+}
+
+quint32 AdaptiveLatencyController::getTargetFrames() const {
+	return targetFrames;
+}
+
+quint32 AdaptiveLatencyController::getChunkFrames() const {
+	return chunkFrames;
+}
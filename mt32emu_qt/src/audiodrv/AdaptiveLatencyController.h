@@ -0,0 +1,46 @@
+#ifndef ADAPTIVE_LATENCY_CONTROLLER_H
+#define ADAPTIVE_LATENCY_CONTROLLER_H
+
+#include <QtGlobal>
+
+#include "../MasterClock.h"
+
+// Chooses the amount of audio to keep queued in the device buffer at runtime, within the bounds given.
+// The target latency widens at once by a half upon an underrun, and never goes below a floor derived from the chunk size,
+// the recent peak rendering time and the jitter of the play position estimation. After a quiet hold period,
+// it narrows as a slow ramp, by a few frames per processing cycle and never more than a chunk at once, so that
+// the MIDI delay which follows it shrinks slower than the time passes and the relative order of MIDI events is preserved.
+// Neither direction causes an audible glitch: widening merely renders a few chunks in a row, narrowing lets the device buffer drain for a while.
+// All the methods are intended to be called from the audio processing thread.
+class AdaptiveLatencyController {
+private:
+	const quint32 minFrames;
+	const quint32 maxFrames;
+	const quint32 chunkFrames;
+	const quint32 sampleRate;
+
+	quint32 targetFrames;
+	// Decaying peaks of the rendering time per chunk and of the play position jitter, in frames
+	double peakRenderFrames;
+	double peakJitterFrames;
+	MasterClockNanos lastWideningNanos;
+	MasterClockNanos lastNarrowingNanos;
+
+	quint32 getFloorFrames() const;
+	void setTargetFrames(quint32 newTargetFrames);
+
+public:
+	AdaptiveLatencyController(quint32 minFrames, quint32 maxFrames, quint32 chunkFrames, quint32 sampleRate);
+
+	void reportUnderrun(MasterClockNanos nanosNow);
+	void reportRenderTime(MasterClockNanos renderNanos);
+	void reportJitter(quint32 jitterFrames);
+
+	// Applies the narrowing policy, to be called once per processing cycle
+	void update(MasterClockNanos nanosNow);
+
+	quint32 getTargetFrames() const;
+	quint32 getChunkFrames() const;
+};
+
+#endif
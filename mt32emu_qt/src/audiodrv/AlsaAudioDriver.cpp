@@ -60,10 +60,14 @@ void *AlsaAudioStream::processingThread(void *userData) {
 			}
 		}
 		audioStream.updateTimeInfo(nanosNow, framesInAudioBuffer);
-		audioStream.synth.render(audioStream.buffer, audioStream.bufferSize);
+		if (audioStream.waitForLatencyTarget(nanosNow, framesInAudioBuffer)) continue;
+		audioStream.renderAudio(audioStream.buffer, audioStream.bufferSize);
+		double writeStartNanos = audioStream.startTracingAudioWrite();
 		error = snd_pcm_writei(audioStream.stream, audioStream.buffer, audioStream.bufferSize);
+		audioStream.traceAudioWrite(writeStartNanos, audioStream.bufferSize);
 		if (error < 0) {
 			qDebug() << "snd_pcm_writei failed:" << snd_strerror(error) << "-> recovering...";
+			if (error == -EPIPE) audioStream.reportUnderrun();
 			error = snd_pcm_recover(audioStream.stream, error, 0);
 			if (error != 0) {
 				qDebug() << "snd_pcm_recover failed:" << snd_strerror(error) << "-> closing...";
@@ -149,9 +153,12 @@ bool AlsaAudioStream::start(const char *deviceID) {
 		}
 		initFrames -= bufferSize;
 	}
+	startRenderAhead(bufferSize);
+	startLatencyControl(bufferSize);
 	error = pthread_create(&processingThreadID, NULL, processingThread, this);
 	if (error != 0) {
 		processingThreadID = 0;
+		stopRenderAhead();
 		qDebug() << "ALSA audio: Processing Thread creation failed:" << error;
 		snd_pcm_close(stream);
 		stream = NULL;
@@ -169,6 +176,7 @@ void AlsaAudioStream::close() {
 			pthread_join(processingThreadID, NULL);
 			stopProcessing = false;
 			processingThreadID = 0;
+			stopRenderAhead();
 		}
 		error = snd_pcm_close(stream);
 		stream = NULL;
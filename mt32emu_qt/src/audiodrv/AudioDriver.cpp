@@ -18,11 +18,74 @@
 #include <QSettings>
 #include "../Master.h"
 #include "../ClockSync.h"
+#include "../QSynth.h"
+#include "AdaptiveLatencyController.h"
 
 static const MasterClockNanos MINIMUM_TIMEINFO_UPDATE_NANOS = 10 * MasterClock::NANOS_PER_MILLISECOND;
+static const unsigned long RENDER_AHEAD_POLL_MICROS = 500;
+static const char TRACE_THREAD_NAME[] = "Audio output";
+
+RenderAheadBuffer::RenderAheadBuffer(QSynth &useSynth, quint32 useAheadFrames, quint32 useChunkFrames, MT32Emu::TraceBuffer *useTraceBuffer) :
+	synth(useSynth), aheadFrames(useAheadFrames), chunkFrames(useChunkFrames), ringFrames(useAheadFrames + useChunkFrames + 1),
+	ring(new MT32Emu::Bit16s[/* channels */ 2 * ringFrames]), readPosition(0), writePosition(0), stopRendering(false),
+	traceBuffer(useTraceBuffer)
+{
+	start(QThread::TimeCriticalPriority);
+}
+
+RenderAheadBuffer::~RenderAheadBuffer() {
+	stopRendering = true;
+	wait();
+	delete[] ring;
+}
+
+void RenderAheadBuffer::run() {
+	qDebug() << "AudioStream: Render-ahead thread started, frames ahead:" << aheadFrames;
+	while (!stopRendering) {
+		quint32 writePos = writePosition.loadAcquire();
+		quint32 fillFrames = (writePos + ringFrames - readPosition.loadAcquire()) % ringFrames;
+		if (fillFrames >= aheadFrames) {
+			QThread::usleep(RENDER_AHEAD_POLL_MICROS);
+			continue;
+		}
+		quint32 frameCount = qMin(qMin(chunkFrames, aheadFrames - fillFrames), ringFrames - writePos);
+		synth.render(ring + 2 * writePos, frameCount);
+		writePosition.storeRelease((writePos + frameCount) % ringFrames);
+	}
+	qDebug() << "AudioStream: Render-ahead thread stopped";
+}
+
+void RenderAheadBuffer::read(MT32Emu::Bit16s *buffer, quint32 frameCount) {
+	if (traceBuffer != NULL && traceBuffer->isEnabled()) {
+		traceBuffer->addCounterEvent("audio", "renderAheadFill", getFillFrames());
+	}
+	while (frameCount > 0) {
+		quint32 readPos = readPosition.loadAcquire();
+		quint32 fillFrames = (writePosition.loadAcquire() + ringFrames - readPos) % ringFrames;
+		if (fillFrames == 0) {
+			// Underrun, the rendering thread falls behind. Waiting keeps the output in sync with the MIDI timestamps.
+			QThread::usleep(RENDER_AHEAD_POLL_MICROS);
+			continue;
+		}
+		quint32 framesToCopy = qMin(qMin(frameCount, fillFrames), ringFrames - readPos);
+		memcpy(buffer, ring + 2 * readPos, framesToCopy * 2 * sizeof(MT32Emu::Bit16s));
+		readPosition.storeRelease((readPos + framesToCopy) % ringFrames);
+		buffer += 2 * framesToCopy;
+		frameCount -= framesToCopy;
+	}
+}
+
+quint32 RenderAheadBuffer::getAheadFrames() const {
+	return aheadFrames;
+}
+
+quint32 RenderAheadBuffer::getFillFrames() const {
+	return (writePosition.loadAcquire() + ringFrames - readPosition.loadAcquire()) % ringFrames;
+}
 
 AudioStream::AudioStream(const AudioDriverSettings &useSettings, QSynth &useSynth, const quint32 useSampleRate) :
-	synth(useSynth), sampleRate(useSampleRate), settings(useSettings), renderedFramesCount(0)
+	synth(useSynth), sampleRate(useSampleRate), settings(useSettings), renderedFramesCount(0), renderAheadBuffer(NULL),
+	latencyController(NULL), lateMIDIEventCount(0)
 {
 	audioLatencyFrames = settings.audioLatency * sampleRate / MasterClock::MILLIS_PER_SECOND;
 	midiLatencyFrames = settings.midiLatency * sampleRate / MasterClock::MILLIS_PER_SECOND;
@@ -31,7 +94,10 @@ AudioStream::AudioStream(const AudioDriverSettings &useSettings, QSynth &useSynt
 		midiLatencyFrames += audioLatencyFrames;
 	} else {
 		clockSync = new ClockSync;
+		if (settings.clockSyncBandwidth > 0.0) clockSync->setLoopBandwidth(settings.clockSyncBandwidth);
 	}
+	traceBuffer = Master::getInstance()->createTraceBuffer(TRACE_THREAD_NAME);
+	if (clockSync != NULL) clockSync->setTraceBuffer(traceBuffer);
 	timeInfoIx = 0;
 	timeInfo[0].lastPlayedNanos = MasterClock::getClockNanos();
 	timeInfo[0].lastPlayedFramesCount = renderedFramesCount;
@@ -40,9 +106,12 @@ AudioStream::AudioStream(const AudioDriverSettings &useSettings, QSynth &useSynt
 }
 
 AudioStream::~AudioStream() {
+	stopRenderAhead();
+	delete latencyController;
 	if (clockSync != NULL) {
 		delete clockSync;
 	}
+	Master::getInstance()->releaseTraceBuffer(TRACE_THREAD_NAME, traceBuffer);
 }
 
 // Intended to be called from MIDI receiving thread
@@ -55,9 +124,13 @@ quint64 AudioStream::estimateMIDITimestamp(const MasterClockNanos refNanos) {
 	}
 	quint64 refFrameOffset = quint64(((midiNanos - timeInfo[i].lastPlayedNanos) * timeInfo[i].actualSampleRate) / MasterClock::NANOS_PER_SECOND);
 	quint64 timestamp = timeInfo[i].lastPlayedFramesCount + refFrameOffset + midiLatencyFrames;
-	qint64 delay = qint64(timestamp - renderedFramesCount);
+	// The synth may have rendered some frames ahead of those written to the device
+	quint64 synthFramesCount = renderedFramesCount;
+	if (renderAheadBuffer != NULL) synthFramesCount += renderAheadBuffer->getFillFrames();
+	qint64 delay = qint64(timestamp - synthFramesCount);
 	if (delay < 0) {
-		qDebug() << "L" << renderedFramesCount << timestamp << delay;
+		qDebug() << "L" << synthFramesCount << timestamp << delay;
+		lateMIDIEventCount.fetchAndAddRelaxed(1);
 	}
 	return timestamp;
 }
@@ -67,6 +140,9 @@ void AudioStream::updateTimeInfo(const MasterClockNanos measuredNanos, const qui
 	qDebug() << "R" << renderedFramesCount - timeInfo[timeInfoIx].lastPlayedFramesCount
 					<< (measuredNanos - timeInfo[timeInfoIx].lastPlayedNanos) * 1e-6;
 #endif
+	if (traceBuffer != NULL && traceBuffer->isEnabled() && settings.advancedTiming) {
+		traceBuffer->addCounterEvent("audio", "framesInAudioBuffer", framesInAudioBuffer);
+	}
 	if ((measuredNanos - timeInfo[timeInfoIx].lastPlayedNanos) < MINIMUM_TIMEINFO_UPDATE_NANOS) {
 		// If callbacks are coming too quickly, we cannot benefit from that, it just makes our timing estimation worse...
 		// Moreover, we should be able to adjust lastPlayedFramesCount increasing speed as it counts in samples
@@ -87,9 +163,16 @@ void AudioStream::updateTimeInfo(const MasterClockNanos measuredNanos, const qui
 		// Ensure lastPlayedFramesCount is monotonically increasing and has no jumps
 		quint64 newPlayedFramesCount = timeInfo[timeInfoIx].lastPlayedFramesCount + quint64(timeInfo[timeInfoIx].actualSampleRate * secondsElapsed + 0.5);
 
+		if (latencyController != NULL) {
+			latencyController->reportJitter(quint32(qAbs(qint64(estimatedNewPlayedFramesCount - newPlayedFramesCount))));
+		}
+
 		// If the estimation goes too far - do reset
 		if (qAbs(qint64(estimatedNewPlayedFramesCount - newPlayedFramesCount)) > (qint64)audioLatencyFrames) {
 			qDebug() << "AudioStream: Estimated play position is way off:" << qint64(estimatedNewPlayedFramesCount - newPlayedFramesCount) << "-> resetting...";
+			if (traceBuffer != NULL && traceBuffer->isEnabled()) {
+				traceBuffer->addInstantEvent("timing", "playPositionReset", "offsetFrames", double(qint64(estimatedNewPlayedFramesCount - newPlayedFramesCount)));
+			}
 			timeInfo[nextTimeInfoIx].lastPlayedNanos = measuredNanos;
 			timeInfo[nextTimeInfoIx].lastPlayedFramesCount = estimatedNewPlayedFramesCount;
 			timeInfo[nextTimeInfoIx].actualSampleRate = sampleRate;
@@ -124,6 +207,75 @@ void AudioStream::updateTimeInfo(const MasterClockNanos measuredNanos, const qui
 	timeInfoIx = nextTimeInfoIx;
 }
 
+double AudioStream::startTracingAudioWrite() const {
+	return (traceBuffer != NULL && traceBuffer->isEnabled()) ? MT32Emu::TraceRecorder::getNanos() : 0.0;
+}
+
+void AudioStream::traceAudioWrite(double startNanos, quint32 frameCount) const {
+	if (startNanos != 0.0) traceBuffer->addCompleteEvent("audio", "write", startNanos, "frames", frameCount);
+}
+
+void AudioStream::startRenderAhead(quint32 chunkFrames) {
+	if (settings.renderAhead == 0 || renderAheadBuffer != NULL) return;
+	quint32 aheadFrames = settings.renderAhead * sampleRate / MasterClock::MILLIS_PER_SECOND;
+	// MIDI events must be timestamped beyond the frames already rendered ahead
+	midiLatencyFrames += aheadFrames;
+	renderAheadBuffer = new RenderAheadBuffer(synth, aheadFrames, chunkFrames, traceBuffer);
+}
+
+void AudioStream::stopRenderAhead() {
+	if (renderAheadBuffer == NULL) return;
+	midiLatencyFrames -= renderAheadBuffer->getAheadFrames();
+	delete renderAheadBuffer;
+	renderAheadBuffer = NULL;
+}
+
+void AudioStream::renderAudio(MT32Emu::Bit16s *buffer, quint32 frameCount) {
+	if (renderAheadBuffer != NULL) {
+		renderAheadBuffer->read(buffer, frameCount);
+	} else if (latencyController != NULL) {
+		MasterClockNanos renderStartNanos = MasterClock::getClockNanos();
+		synth.render(buffer, frameCount);
+		latencyController->reportRenderTime(MasterClock::getClockNanos() - renderStartNanos);
+	} else {
+		synth.render(buffer, frameCount);
+	}
+}
+
+void AudioStream::startLatencyControl(quint32 chunkFrames) {
+	if (settings.minAudioLatency == 0 || !settings.advancedTiming || latencyController != NULL) return;
+	quint32 minFrames = settings.minAudioLatency * sampleRate / MasterClock::MILLIS_PER_SECOND;
+	if (minFrames >= audioLatencyFrames) return;
+	// With advanced timing, the MIDI latency includes the whole audio latency, the adaptive target replaces it
+	baseMIDILatencyFrames = midiLatencyFrames - audioLatencyFrames;
+	latencyController = new AdaptiveLatencyController(minFrames, audioLatencyFrames, chunkFrames, sampleRate);
+	midiLatencyFrames = baseMIDILatencyFrames + latencyController->getTargetFrames();
+	qDebug() << "AudioStream: Adaptive latency control enabled, bounds:" << minFrames << "-" << audioLatencyFrames << "frames";
+}
+
+bool AudioStream::waitForLatencyTarget(const MasterClockNanos nanosNow, const quint32 framesInAudioBuffer) {
+	if (latencyController == NULL) return false;
+	quint32 chunkFrames = latencyController->getChunkFrames();
+	if (lateMIDIEventCount.fetchAndStoreRelaxed(0) != 0) {
+		// MIDI events arrived too late to be rendered at the intended time
+		latencyController->reportUnderrun(nanosNow);
+	} else if (framesInAudioBuffer < chunkFrames / 4) {
+		// Not quite an xrun yet, but the device buffer has nearly drained
+		latencyController->reportUnderrun(nanosNow);
+	}
+	latencyController->update(nanosNow);
+	quint32 targetFrames = latencyController->getTargetFrames();
+	midiLatencyFrames = baseMIDILatencyFrames + targetFrames;
+	if (framesInAudioBuffer <= targetFrames) return false;
+	quint32 excessFrames = qMin(framesInAudioBuffer - targetFrames, chunkFrames);
+	MasterClock::sleepForNanos(MasterClockNanos(excessFrames) * MasterClock::NANOS_PER_SECOND / sampleRate);
+	return true;
+}
+
+void AudioStream::reportUnderrun() {
+	if (latencyController != NULL) latencyController->reportUnderrun(MasterClock::getClockNanos());
+}
+
 AudioDevice::AudioDevice(AudioDriver &useDriver, QString useName) : driver(useDriver), name(useName) {}
 
 AudioDriver::AudioDriver(QString useID, QString useName) : id(useID), name(useName) {}
@@ -136,6 +288,9 @@ void AudioDriver::loadAudioSettings() {
 	settings.audioLatency = qSettings->value(id + "/AudioLatency").toInt();
 	settings.midiLatency = qSettings->value(id + "/MidiLatency").toInt();
 	settings.advancedTiming = qSettings->value(id + "/AdvancedTiming", true).toBool();
+	settings.renderAhead = qSettings->value(id + "/RenderAhead", 0).toUInt();
+	settings.minAudioLatency = qSettings->value(id + "/MinAudioLatency", 0).toUInt();
+	settings.clockSyncBandwidth = qSettings->value(id + "/ClockSyncBandwidth", 0.0).toDouble();
 	validateAudioSettings(settings);
 }
 
@@ -154,4 +309,7 @@ void AudioDriver::setAudioSettings(AudioDriverSettings &useSettings) {
 	qSettings->setValue(id + "/AudioLatency", settings.audioLatency);
 	qSettings->setValue(id + "/MidiLatency", settings.midiLatency);
 	qSettings->setValue(id + "/AdvancedTiming", settings.advancedTiming);
+	qSettings->setValue(id + "/RenderAhead", settings.renderAhead);
+	qSettings->setValue(id + "/MinAudioLatency", settings.minAudioLatency);
+	qSettings->setValue(id + "/ClockSyncBandwidth", settings.clockSyncBandwidth);
 }
@@ -6,15 +6,49 @@
 #include <QList>
 #include <QString>
 #include <QMetaType>
+#include <QThread>
+#include <QAtomicInt>
+
+#include <mt32emu/mt32emu.h>
 
 #include "../MasterClock.h"
 #include "../resample/SampleRateConverter.h"
 
 class AudioDriver;
+class AdaptiveLatencyController;
 class QSynth;
 class ClockSync;
 struct AudioDriverSettings;
 
+// Optional render-ahead stage of an audio stream. A dedicated thread keeps the synth output rendered up to aheadFrames
+// in advance into a single-producer single-consumer PCM ring, so the audio processing thread only copies frames out
+// while waiting for the device. Occasional spikes of rendering time are absorbed by the ring instead of causing xruns.
+// The processing thread only waits if the ring runs empty, the rendering thread polls when the ring is full.
+class RenderAheadBuffer : public QThread {
+public:
+	RenderAheadBuffer(QSynth &synth, quint32 aheadFrames, quint32 chunkFrames, MT32Emu::TraceBuffer *traceBuffer);
+	~RenderAheadBuffer();
+	void read(MT32Emu::Bit16s *buffer, quint32 frameCount);
+	quint32 getAheadFrames() const;
+	// Returns the number of frames rendered but not read yet
+	quint32 getFillFrames() const;
+
+protected:
+	void run();
+
+private:
+	QSynth &synth;
+	const quint32 aheadFrames;
+	const quint32 chunkFrames;
+	// One frame is always kept free to tell a full ring from an empty one
+	const quint32 ringFrames;
+	MT32Emu::Bit16s * const ring;
+	QAtomicInt readPosition;
+	QAtomicInt writePosition;
+	volatile bool stopRendering;
+	MT32Emu::TraceBuffer * const traceBuffer;
+};
+
 class AudioStream {
 protected:
 	QSynth &synth;
@@ -26,6 +60,18 @@ protected:
 	quint64 renderedFramesCount;
 	ClockSync *clockSync;
 
+	// Filled by the audio processing thread, NULL unless tracing
+	MT32Emu::TraceBuffer *traceBuffer;
+
+	// NULL unless the render-ahead stage is running
+	RenderAheadBuffer *renderAheadBuffer;
+
+	// NULL unless adaptive latency control is enabled. The MIDI latency is then kept at baseMIDILatencyFrames plus the target latency.
+	AdaptiveLatencyController *latencyController;
+	quint32 baseMIDILatencyFrames;
+	// Incremented by the MIDI receiving threads, collected and reset by the audio processing thread to report underruns
+	QAtomicInt lateMIDIEventCount;
+
 	struct {
 		MasterClockNanos lastPlayedNanos;
 		quint64 lastPlayedFramesCount;
@@ -35,6 +81,24 @@ protected:
 
 	void updateTimeInfo(const MasterClockNanos measuredNanos, const quint32 framesInAudioBuffer);
 
+	// Returns the timestamp to pass to traceAudioWrite() when tracing, 0 otherwise
+	double startTracingAudioWrite() const;
+	void traceAudioWrite(double startNanos, quint32 frameCount) const;
+
+	// Starts the render-ahead stage if configured in the settings. Should be invoked right before the processing thread starts.
+	void startRenderAhead(quint32 chunkFrames);
+	void stopRenderAhead();
+	// Obtains the next frames of synth output to be written to the device
+	void renderAudio(MT32Emu::Bit16s *buffer, quint32 frameCount);
+
+	// Starts adaptive latency control if configured in the settings and supported by the stream (requires advanced timing).
+	// Should be invoked once audioLatencyFrames and midiLatencyFrames are final.
+	void startLatencyControl(quint32 chunkFrames);
+	// Returns true if the processing thread has waited as the device buffer holds more than the target latency,
+	// in this case the buffer state should be measured anew before writing
+	bool waitForLatencyTarget(const MasterClockNanos nanosNow, const quint32 framesInAudioBuffer);
+	void reportUnderrun();
+
 public:
 	AudioStream(const AudioDriverSettings &settings, QSynth &synth, const quint32 sampleRate);
 	//virtual void suspend() = 0;
@@ -68,6 +132,16 @@ struct AudioDriverSettings {
 	// true - use advanced timing functions provided by audio API
 	// false - instead, compute average actual sample rate using clockSync
 	bool advancedTiming;
+	// The number of milliseconds to render ahead in a dedicated thread, 0 - render in the audio processing thread.
+	// Only supported by ALSA and PulseAudio drivers. The value adds to the MIDI latency.
+	unsigned int renderAhead;
+	// The lower bound of audio latency in milliseconds for adaptive latency control, 0 - disabled.
+	// When enabled, audioLatency is the upper bound and the queued audio along with the MIDI delay are adjusted in between at runtime.
+	// Only supported by ALSA and PulseAudio drivers with advanced timing.
+	unsigned int minAudioLatency;
+	// Bandwidth in Hz of the phase-locked loop estimating clock drift when advanced timing is off, 0 - use the block average estimator.
+	// Lower values make the timing smoother but slower to follow changes.
+	double clockSyncBandwidth;
 };
 
 class AudioDriver {
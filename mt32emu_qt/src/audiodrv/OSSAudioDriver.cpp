@@ -66,7 +66,9 @@ void *OSSAudioStream::processingThread(void *userData) {
 		}
 		audioStream.updateTimeInfo(nanosNow, framesInAudioBuffer);
 		audioStream.synth.render(audioStream.buffer, audioStream.bufferSize);
+		double writeStartNanos = audioStream.startTracingAudioWrite();
 		error = write(audioStream.stream, audioStream.buffer, FRAME_SIZE * audioStream.bufferSize);
+		audioStream.traceAudioWrite(writeStartNanos, audioStream.bufferSize);
 		if (error != int(FRAME_SIZE * audioStream.bufferSize)) {
 			if (error == -1) {
 				qDebug() << "OSS audio: write failed:" << errno;
@@ -152,8 +152,12 @@ void *PulseAudioStream::processingThread(void *userData) {
 			framesInAudioBuffer = 0;
 		}
 		audioStream.updateTimeInfo(nanosNow, framesInAudioBuffer);
-		audioStream.synth.render(audioStream.buffer, audioStream.bufferSize);
-		if (_pa_simple_write(audioStream.stream, audioStream.buffer, audioStream.bufferSize * FRAME_SIZE, &error) < 0) {
+		if (audioStream.waitForLatencyTarget(nanosNow, framesInAudioBuffer)) continue;
+		audioStream.renderAudio(audioStream.buffer, audioStream.bufferSize);
+		double writeStartNanos = audioStream.startTracingAudioWrite();
+		int result = _pa_simple_write(audioStream.stream, audioStream.buffer, audioStream.bufferSize * FRAME_SIZE, &error);
+		audioStream.traceAudioWrite(writeStartNanos, audioStream.bufferSize);
+		if (result < 0) {
 			qDebug() << "pa_simple_write() failed:" << _pa_strerror(error);
 			_pa_simple_free(audioStream.stream);
 			audioStream.stream = NULL;
@@ -212,9 +216,12 @@ bool PulseAudioStream::start() {
 		}
 		initFrames -= bufferSize;
 	}
+	startRenderAhead(bufferSize);
+	startLatencyControl(bufferSize);
 	error = pthread_create(&processingThreadID, NULL, processingThread, this);
 	if (error != 0) {
 		processingThreadID = 0;
+		stopRenderAhead();
 		qDebug() << "PulseAudio: Processing Thread creation failed:" << error;
 		_pa_simple_free(stream);
 		stream = NULL;
@@ -232,6 +239,7 @@ void PulseAudioStream::close() {
 			pthread_join(processingThreadID, NULL);
 			stopProcessing = false;
 			processingThreadID = 0;
+			stopRenderAhead();
 			qDebug() << "PulseAudio: Processing thread stopped";
 		}
 		if (_pa_simple_drain(stream, &error) < 0) {
@@ -155,11 +155,16 @@ void WinMMAudioStream::processingThread(void *userData) {
 		stream.updateTimeInfo(nanosNow, framesInAudioBuffer);
 		stream.synth.render(buf, frameCount);
 		stream.renderedFramesCount += frameCount;
-		if (!stream.ringBufferMode && waveOutWrite(stream.hWaveOut, waveHdr, sizeof(WAVEHDR)) != MMSYSERR_NOERROR) {
-			qDebug() << "WinMMAudioDriver: waveOutWrite failed, thread stopped";
-			stream.stopProcessing = true;
-			stream.synth.close();
-			return;
+		if (!stream.ringBufferMode) {
+			double writeStartNanos = stream.startTracingAudioWrite();
+			MMRESULT result = waveOutWrite(stream.hWaveOut, waveHdr, sizeof(WAVEHDR));
+			stream.traceAudioWrite(writeStartNanos, frameCount);
+			if (result != MMSYSERR_NOERROR) {
+				qDebug() << "WinMMAudioDriver: waveOutWrite failed, thread stopped";
+				stream.stopProcessing = true;
+				stream.synth.close();
+				return;
+			}
 		}
 	}
 	stream.stopProcessing = false;
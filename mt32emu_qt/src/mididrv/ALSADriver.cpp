@@ -36,6 +36,10 @@ void *ALSAMidiDriver::processingThread(void *userData) {
 void ALSAMidiDriver::processSeqEvents() {
 	int pollFDCount;
 	struct pollfd *pollFDs;
+	snd_seq_queue_status_t *queueStatus = NULL;
+
+	if (queueID >= 0) snd_seq_queue_status_malloc(&queueStatus);
+	queueClockSync.scheduleReset();
 
 	pollFDCount = snd_seq_poll_descriptors_count(snd_seq, POLLIN);
 	pollFDs = (struct pollfd *)malloc(pollFDCount * sizeof(struct pollfd));
@@ -67,6 +71,19 @@ void ALSAMidiDriver::processSeqEvents() {
 		if ((revents & POLLIN) == 0) {
 			continue;
 		}
+		// The queue time and the master clock are sampled once per wakeup, then all the pending events are drained as a batch.
+		// Each event is placed on the master clock according to its kernel timestamp, so that neither the scheduling delay
+		// of this thread nor the batching affect the relative timing of the events.
+		MasterClockNanos batchMasterNanos = MasterClock::getClockNanos();
+		MasterClockNanos batchQueueNanos = 0;
+		// Without the queue time, the kernel timestamps of the events can't be related to the master clock
+		bool batchQueueTimeValid = false;
+		if (queueStatus != NULL && snd_seq_get_queue_status(snd_seq, queueID, queueStatus) == 0) {
+			const snd_seq_real_time_t *queueTime = snd_seq_queue_status_get_real_time(queueStatus);
+			batchQueueNanos = queueTime->tv_sec * MasterClock::NANOS_PER_SECOND + queueTime->tv_nsec;
+			batchMasterNanos = queueClockSync.sync(batchMasterNanos, batchQueueNanos);
+			batchQueueTimeValid = true;
+		}
 		snd_seq_event_t *seq_event = NULL;
 		do {
 			int status = snd_seq_event_input(snd_seq, &seq_event);
@@ -92,12 +109,13 @@ void ALSAMidiDriver::processSeqEvents() {
 				showBalloon("Connected application:", appName);
 				qDebug() << "ALSAMidiDriver: Connected application" << appName;
 			}
-			if (processSeqEvent(seq_event, midiSession->getSynthRoute())) {
+			if (processSeqEvent(seq_event, midiSession->getSynthRoute(), getEventNanos(seq_event, batchQueueTimeValid ? &batchQueueNanos : NULL, batchMasterNanos))) {
 				break;
 			}
 		} while (!stopProcessing && snd_seq_event_input_pending(snd_seq, 1));
 	}
 	free(pollFDs);
+	if (queueStatus != NULL) snd_seq_queue_status_free(queueStatus);
 	snd_seq_close(snd_seq);
 	qDebug() << "ALSAMidiDriver: MIDI processing loop finished";
 
@@ -134,7 +152,17 @@ MidiSession *ALSAMidiDriver::findMidiSessionForClient(unsigned int clientAddr) {
 	return midiSessions.at(i);
 }
 
-bool ALSAMidiDriver::processSeqEvent(snd_seq_event_t *seq_event, SynthRoute *synthRoute) {
+MasterClockNanos ALSAMidiDriver::getEventNanos(const snd_seq_event_t *seq_event, const MasterClockNanos *batchQueueNanos, MasterClockNanos batchMasterNanos) {
+	// Events delivered directly to the port (rather than via a subscription) bypass timestamping.
+	// The same applies when the queue time couldn't be sampled for this batch.
+	if (batchQueueNanos == NULL || queueID < 0 || seq_event->queue != queueID || (seq_event->flags & SND_SEQ_TIME_STAMP_MASK) != SND_SEQ_TIME_STAMP_REAL) {
+		return MasterClock::getClockNanos();
+	}
+	MasterClockNanos eventQueueNanos = seq_event->time.time.tv_sec * MasterClock::NANOS_PER_SECOND + seq_event->time.time.tv_nsec;
+	return batchMasterNanos - (*batchQueueNanos - eventQueueNanos);
+}
+
+bool ALSAMidiDriver::processSeqEvent(snd_seq_event_t *seq_event, SynthRoute *synthRoute, MasterClockNanos eventNanos) {
 	MT32Emu::Bit32u msg = 0;
 	switch(seq_event->type) {
 	case SND_SEQ_EVENT_NOTEON:
@@ -142,7 +170,7 @@ bool ALSAMidiDriver::processSeqEvent(snd_seq_event_t *seq_event, SynthRoute *syn
 		msg |= seq_event->data.note.channel;
 		msg |= seq_event->data.note.note << 8;
 		msg |= seq_event->data.note.velocity << 16;
-		synthRoute->pushMIDIShortMessage(msg, MasterClock::getClockNanos());
+		synthRoute->pushMIDIShortMessage(msg, eventNanos);
 		break;
 
 	case SND_SEQ_EVENT_NOTEOFF:
@@ -150,7 +178,7 @@ bool ALSAMidiDriver::processSeqEvent(snd_seq_event_t *seq_event, SynthRoute *syn
 		msg |= seq_event->data.note.channel;
 		msg |= seq_event->data.note.note << 8;
 		msg |= seq_event->data.note.velocity << 16;
-		synthRoute->pushMIDIShortMessage(msg, MasterClock::getClockNanos());
+		synthRoute->pushMIDIShortMessage(msg, eventNanos);
 		break;
 
 	case SND_SEQ_EVENT_CONTROLLER:
@@ -158,7 +186,7 @@ bool ALSAMidiDriver::processSeqEvent(snd_seq_event_t *seq_event, SynthRoute *syn
 		msg |= seq_event->data.control.channel;
 		msg |= seq_event->data.control.param << 8;
 		msg |= seq_event->data.control.value << 16;
-		synthRoute->pushMIDIShortMessage(msg, MasterClock::getClockNanos());
+		synthRoute->pushMIDIShortMessage(msg, eventNanos);
 		break;
 
 	case SND_SEQ_EVENT_CONTROL14:
@@ -169,7 +197,7 @@ bool ALSAMidiDriver::processSeqEvent(snd_seq_event_t *seq_event, SynthRoute *syn
 		msg |= seq_event->data.control.channel;
 		msg |= seq_event->data.control.param << 8;
 		msg |= (seq_event->data.control.value >> 7) << 16;
-		synthRoute->pushMIDIShortMessage(msg, MasterClock::getClockNanos());
+		synthRoute->pushMIDIShortMessage(msg, eventNanos);
 		break;
 
 	case SND_SEQ_EVENT_NONREGPARAM:
@@ -181,23 +209,23 @@ bool ALSAMidiDriver::processSeqEvent(snd_seq_event_t *seq_event, SynthRoute *syn
 		if (seq_event->data.control.param != 0) break;
 		msg = 0x64B0;
 		msg |= seq_event->data.control.channel;
-		synthRoute->pushMIDIShortMessage(msg, MasterClock::getClockNanos());
+		synthRoute->pushMIDIShortMessage(msg, eventNanos);
 
 		msg &= 0xFF;
 		msg |= 0x6500;
-		synthRoute->pushMIDIShortMessage(msg, MasterClock::getClockNanos());
+		synthRoute->pushMIDIShortMessage(msg, eventNanos);
 
 		msg &= 0xFF;
 		msg |= 0x0600;
 		msg |= ((seq_event->data.control.value >> 7) & 0x7F) << 16;
-		synthRoute->pushMIDIShortMessage(msg, MasterClock::getClockNanos());
+		synthRoute->pushMIDIShortMessage(msg, eventNanos);
 		break;
 
 	case SND_SEQ_EVENT_PGMCHANGE:
 		msg = 0xC0;
 		msg |= seq_event->data.control.channel;
 		msg |= seq_event->data.control.value << 8;
-		synthRoute->pushMIDIShortMessage(msg, MasterClock::getClockNanos());
+		synthRoute->pushMIDIShortMessage(msg, eventNanos);
 		break;
 
 	case SND_SEQ_EVENT_PITCHBEND:
@@ -207,11 +235,11 @@ bool ALSAMidiDriver::processSeqEvent(snd_seq_event_t *seq_event, SynthRoute *syn
 		bend = seq_event->data.control.value + 8192;
 		msg |= (bend & 0x7F) << 8;
 		msg |= ((bend >> 7) & 0x7F) << 16;
-		synthRoute->pushMIDIShortMessage(msg, MasterClock::getClockNanos());
+		synthRoute->pushMIDIShortMessage(msg, eventNanos);
 		break;
 
 	case SND_SEQ_EVENT_SYSEX:
-		synthRoute->pushMIDISysex((MT32Emu::Bit8u *)seq_event->data.ext.ptr, seq_event->data.ext.len, MasterClock::getClockNanos());
+		synthRoute->pushMIDISysex((MT32Emu::Bit8u *)seq_event->data.ext.ptr, seq_event->data.ext.len, eventNanos);
 		break;
 
 	case SND_SEQ_EVENT_PORT_SUBSCRIBED:
@@ -247,7 +275,7 @@ bool ALSAMidiDriver::processSeqEvent(snd_seq_event_t *seq_event, SynthRoute *syn
 }
 
 int ALSAMidiDriver::alsa_setup_midi() {
-	int seqPort;
+	snd_seq_port_info_t *portInfo;
 
 	/* open sequencer interface for input */
 	if (snd_seq_open(&snd_seq, "default", SND_SEQ_OPEN_DUPLEX, 0) < 0) {
@@ -256,23 +284,42 @@ int ALSAMidiDriver::alsa_setup_midi() {
 	}
 
 	snd_seq_set_client_name(snd_seq, "Munt MT-32");
-	seqPort = snd_seq_create_simple_port(snd_seq, "Standard",
+	snd_seq_port_info_alloca(&portInfo);
+	snd_seq_port_info_set_name(portInfo, "Standard");
+	snd_seq_port_info_set_capability(portInfo,
 						SND_SEQ_PORT_CAP_SUBS_WRITE |
-						SND_SEQ_PORT_CAP_WRITE,
+						SND_SEQ_PORT_CAP_WRITE);
+	snd_seq_port_info_set_type(portInfo,
 						SND_SEQ_PORT_TYPE_MIDI_GENERIC |
 						SND_SEQ_PORT_TYPE_MIDI_MT32 |
 						SND_SEQ_PORT_TYPE_SYNTHESIZER);
-	if (seqPort < 0) {
+
+	// Have the kernel stamp the subscribed events with the real time of a queue upon arrival
+	queueID = snd_seq_alloc_named_queue(snd_seq, "Munt MT-32");
+	if (queueID < 0) {
+		qDebug() << "ALSAMidiDriver: Error allocating sequencer queue, events will be timestamped upon processing";
+	} else {
+		snd_seq_port_info_set_timestamping(portInfo, 1);
+		snd_seq_port_info_set_timestamp_real(portInfo, 1);
+		snd_seq_port_info_set_timestamp_queue(portInfo, queueID);
+	}
+
+	if (snd_seq_create_port(snd_seq, portInfo) < 0) {
 		qDebug() << "ALSAMidiDriver: Error creating sequencer port";
 		return -1;
 	}
+	if (queueID >= 0 && (snd_seq_start_queue(snd_seq, queueID, NULL) < 0 || snd_seq_drain_output(snd_seq) < 0)) {
+		qDebug() << "ALSAMidiDriver: Error starting sequencer queue, events will be timestamped upon processing";
+		snd_seq_free_queue(snd_seq, queueID);
+		queueID = -1;
+	}
 	QString midiPortStr = QString().setNum(snd_seq_client_id(snd_seq)) + ":0";
 	qDebug() << "MT-32 emulator ALSA address is:" << midiPortStr;
 	emit mainWindowTitleContributionUpdated("ALSA MIDI Port " + midiPortStr);
-	return seqPort;
+	return snd_seq_port_info_get_port(portInfo);
 }
 
-ALSAMidiDriver::ALSAMidiDriver(Master *useMaster) : MidiDriver(useMaster), processingThreadID(0) {}
+ALSAMidiDriver::ALSAMidiDriver(Master *useMaster) : MidiDriver(useMaster), processingThreadID(0), queueID(-1) {}
 
 ALSAMidiDriver::~ALSAMidiDriver() {
 	stop();
@@ -4,6 +4,7 @@
 #include <alsa/asoundlib.h>
 
 #include "MidiDriver.h"
+#include "../ClockSync.h"
 
 class SynthRoute;
 class MidiSession;
@@ -23,11 +24,16 @@ private:
 	pthread_t processingThreadID;
 	volatile bool stopProcessing;
 	QList<unsigned int> clients;
+	// Real-time queue used by the kernel to timestamp incoming events, -1 if unavailable
+	int queueID;
+	// Maps the queue time to the master clock
+	ClockSync queueClockSync;
 
 	static void *processingThread(void *userData);
 	int alsa_setup_midi();
 	void processSeqEvents();
-	bool processSeqEvent(snd_seq_event_t *seq_event, SynthRoute *synthRoute);
+	bool processSeqEvent(snd_seq_event_t *seq_event, SynthRoute *synthRoute, MasterClockNanos eventNanos);
+	MasterClockNanos getEventNanos(const snd_seq_event_t *seq_event, const MasterClockNanos *batchQueueNanos, MasterClockNanos batchMasterNanos);
 	unsigned int getSourceAddr(snd_seq_event_t *seq_event);
 	QString getClientName(unsigned int clientAddr);
 	MidiSession *findMidiSessionForClient(unsigned int clientAddr);
@@ -23,10 +23,88 @@
 #include "../MidiSession.h"
 
 static const MasterClockNanos MAX_SLEEP_TIME = 200 * MasterClock::NANOS_PER_MILLISECOND;
+static const uint DEFAULT_LOOKAHEAD_MILLIS = 200;
+static const MasterClockNanos QUEUE_FULL_RETRY_NANOS = 10 * MasterClock::NANOS_PER_MILLISECOND;
+static const int MAX_CACHED_FILES = 4;
 
-void SMFProcessor::sendChannelsReset(SynthRoute *synthRoute) {
+SMFParserCache::SMFParserCache() : workerActive(false), stopProcessing(false) {}
+
+SMFParserCache::~SMFParserCache() {
+	stopProcessing = true;
+	wait();
+}
+
+void SMFParserCache::prefetch(const QStringList &fileNames) {
+	QMutexLocker locker(&mutex);
+	pendingFileNames = fileNames;
+	if (workerActive || pendingFileNames.isEmpty()) return;
+	workerActive = true;
+	locker.unlock();
+	// The worker may still be returning from run() after it found nothing to do
+	wait();
+	start(QThread::LowPriority);
+}
+
+bool SMFParserCache::lookup(const QString &fileName, MidiParser &parser) {
+	QFileInfo fileInfo(fileName);
+	QMutexLocker locker(&mutex);
+	pendingFileNames.removeAll(fileName);
+	while (parsingFileName == fileName) {
+		parsingFinished.wait(&mutex);
+	}
+	int entryIx = findEntry(fileName, fileInfo);
+	if (entryIx < 0) return false;
+	entries.move(entryIx, 0);
+	parser = entries.first().parser;
+	return true;
+}
+
+int SMFParserCache::findEntry(const QString &fileName, const QFileInfo &fileInfo) const {
+	for (int i = 0; i < entries.size(); i++) {
+		const Entry &entry = entries.at(i);
+		if (entry.fileName == fileName && entry.fileSize == fileInfo.size() && entry.lastModified == fileInfo.lastModified()) return i;
+	}
+	return -1;
+}
+
+void SMFParserCache::run() {
+	QMutexLocker locker(&mutex);
+	while (!stopProcessing && !pendingFileNames.isEmpty()) {
+		Entry entry;
+		entry.fileName = pendingFileNames.takeFirst();
+		QFileInfo fileInfo(entry.fileName);
+		if (findEntry(entry.fileName, fileInfo) >= 0) continue;
+		entry.fileSize = fileInfo.size();
+		entry.lastModified = fileInfo.lastModified();
+		parsingFileName = entry.fileName;
+		locker.unlock();
+		bool parsed = entry.parser.parse(entry.fileName);
+		locker.relock();
+		parsingFileName.clear();
+		parsingFinished.wakeAll();
+		if (!parsed) {
+			qDebug() << "SMFDriver: Error prefetching MIDI file:" << entry.fileName;
+			continue;
+		}
+		// Replace a stale entry for the file if any
+		for (int i = entries.size() - 1; i >= 0; i--) {
+			if (entries.at(i).fileName == entry.fileName) entries.removeAt(i);
+		}
+		entries.prepend(entry);
+		while (entries.size() > MAX_CACHED_FILES) entries.removeLast();
+	}
+	workerActive = false;
+}
+
+void SMFProcessor::sendChannelsReset(SynthRoute *synthRoute, bool discardPendingEvents) {
 	if (synthRoute->getState() != SynthRouteState_OPEN) return;
-	synthRoute->flushMIDIQueue();
+	if (discardPendingEvents) {
+		// On stop and seek, the events pushed ahead haven't played yet, they are cancelled rather than played all at once
+		synthRoute->discardMIDIQueue();
+	} else {
+		// At the end of file, the last events may still wait within the MIDI latency, e.g. the final note-offs
+		synthRoute->flushMIDIQueue();
+	}
 	for (quint8 i = 0; i < 16; i++) {
 		// All notes off
 		quint32 msg = 0x7FB0 | i;
@@ -47,7 +125,7 @@ void SMFProcessor::start(QString useFileName) {
 	driver->seekPosition = -1;
 	driver->fastForwardingFactor = 0;
 	fileName = useFileName;
-	if (!parser.parse(fileName)) {
+	if (!driver->parserCache.lookup(fileName, parser) && !parser.parse(fileName)) {
 		qDebug() << "SMFDriver: Error parsing MIDI file:" << fileName;
 		QMessageBox::warning(NULL, "Error", "Error encountered while loading MIDI file");
 		emit driver->playbackFinished();
@@ -71,70 +149,79 @@ void SMFProcessor::run() {
 	const QMidiEventList &midiEvents = parser.getMIDIEvents();
 	midiTick = parser.getMidiTick();
 	quint32 totalSeconds = estimateRemainingTime(midiEvents, 0);
+	// Events are pushed to the synth queue this far ahead with exact timestamps, so the thread only wakes up to refill the window
+	MasterClockNanos lookaheadNanos = Master::getInstance()->getSettings()->value("Master/midiPlayerLookahead", DEFAULT_LOOKAHEAD_MILLIS).toUInt() * MasterClock::NANOS_PER_MILLISECOND;
+	MasterClockNanos refillNanos = qBound(MasterClockNanos(MasterClock::NANOS_PER_MILLISECOND), lookaheadNanos / 4, MAX_SLEEP_TIME);
 	MasterClockNanos startNanos = MasterClock::getClockNanos();
 	MasterClockNanos currentNanos = startNanos;
-	for (int currentEventIx = 0; currentEventIx < midiEvents.count(); currentEventIx++) {
-		currentNanos += midiEvents.at(currentEventIx).getTimestamp() * midiTick;
-		while (!stopProcessing && synthRoute->getState() == SynthRouteState_OPEN) {
-			if (bpmUpdated) {
-				bpmUpdated = false;
-				totalSeconds = (currentNanos - startNanos) / MasterClock::NANOS_PER_SECOND + estimateRemainingTime(midiEvents, currentEventIx + 1);
-			}
-			MasterClockNanos nanosNow = MasterClock::getClockNanos();
-			if (driver->seekPosition > -1) {
-				SMFProcessor::sendChannelsReset(synthRoute);
-				MasterClockNanos seekNanosSinceStart = totalSeconds * driver->seekPosition * MasterClock::NANOS_PER_MILLISECOND;
-				MasterClockNanos currentNanosSinceStart = currentNanos - startNanos;
-				MasterClockNanos lastEventNanosSinceStart = currentNanosSinceStart - midiEvents.at(currentEventIx).getTimestamp() * midiTick;
-				if (seekNanosSinceStart < lastEventNanosSinceStart || seekNanosSinceStart == 0) {
-					midiTick = parser.getMidiTick();
-					emit driver->tempoUpdated(0);
-					currentEventIx = 0;
-					currentNanosSinceStart = midiEvents.at(currentEventIx).getTimestamp() * midiTick;
-				}
-				seek(synthRoute, midiEvents, currentEventIx, currentNanosSinceStart, seekNanosSinceStart);
-				nanosNow = MasterClock::getClockNanos();
-				startNanos = nanosNow - seekNanosSinceStart;
-				currentNanos = currentNanosSinceStart + startNanos;
-				driver->seekPosition = -1;
+	int currentEventIx = 0;
+	if (!midiEvents.isEmpty()) currentNanos += midiEvents.at(currentEventIx).getTimestamp() * midiTick;
+	while (!stopProcessing && synthRoute->getState() == SynthRouteState_OPEN) {
+		if (bpmUpdated) {
+			bpmUpdated = false;
+			totalSeconds = (currentNanos - startNanos) / MasterClock::NANOS_PER_SECOND + estimateRemainingTime(midiEvents, currentEventIx + 1);
+		}
+		MasterClockNanos nanosNow = MasterClock::getClockNanos();
+		if (driver->seekPosition > -1) {
+			// The events pushed ahead are discarded along with any controller changes they carry, so always seek from the beginning
+			SMFProcessor::sendChannelsReset(synthRoute, true);
+			MasterClockNanos seekNanosSinceStart = totalSeconds * driver->seekPosition * MasterClock::NANOS_PER_MILLISECOND;
+			midiTick = parser.getMidiTick();
+			emit driver->tempoUpdated(0);
+			currentEventIx = 0;
+			MasterClockNanos currentNanosSinceStart = midiEvents.isEmpty() ? 0 : midiEvents.at(currentEventIx).getTimestamp() * midiTick;
+			if (!midiEvents.isEmpty()) seek(synthRoute, midiEvents, currentEventIx, currentNanosSinceStart, seekNanosSinceStart);
+			nanosNow = MasterClock::getClockNanos();
+			startNanos = nanosNow - seekNanosSinceStart;
+			currentNanos = currentNanosSinceStart + startNanos;
+			driver->seekPosition = -1;
+		}
+		emit driver->playbackTimeChanged(nanosNow - startNanos, totalSeconds);
+		MasterClockNanos sleepNanos = refillNanos;
+		while (currentEventIx < midiEvents.count() && currentNanos < nanosNow + lookaheadNanos) {
+			if (!pushEvent(synthRoute, midiEvents, currentEventIx, currentNanos)) {
+				// The synth MIDI queue is full, retry once the synth has consumed some events
+				sleepNanos = QUEUE_FULL_RETRY_NANOS;
+				break;
 			}
-			emit driver->playbackTimeChanged(nanosNow - startNanos, totalSeconds);
-			MasterClockNanos delay = currentNanos - nanosNow;
+			if (++currentEventIx == midiEvents.count()) break;
+			MasterClockNanos eventDelta = midiEvents.at(currentEventIx).getTimestamp() * midiTick;
 			if (driver->fastForwardingFactor > 1) {
-				MasterClockNanos timeShift = delay - (delay / driver->fastForwardingFactor);
-				delay -= timeShift;
-				currentNanos -= timeShift;
+				MasterClockNanos timeShift = eventDelta - (eventDelta / driver->fastForwardingFactor);
+				eventDelta -= timeShift;
 				startNanos -= timeShift;
 			}
-			if (delay < MasterClock::NANOS_PER_MILLISECOND) break;
-			usleep(((delay < MAX_SLEEP_TIME ? delay : MAX_SLEEP_TIME) - MasterClock::NANOS_PER_MILLISECOND) / MasterClock::NANOS_PER_MICROSECOND);
-		}
-		const QMidiEvent &e = midiEvents.at(currentEventIx);
-		if (stopProcessing || synthRoute->getState() != SynthRouteState_OPEN) break;
-		switch (e.getType()) {
-			case SHORT_MESSAGE:
-				synthRoute->pushMIDIShortMessage(e.getShortMessage(), currentNanos);
-				break;
-			case SYSEX:
-				synthRoute->pushMIDISysex(e.getSysexData(), e.getSysexLen(), currentNanos);
-				break;
-			case SET_TEMPO: {
-				uint tempo = e.getShortMessage();
-				midiTick = parser.getMidiTick(tempo);
-				emit driver->tempoUpdated(MidiParser::MICROSECONDS_PER_MINUTE / tempo);
-				break;
-			}
-			default:
-				break;
+			currentNanos += eventDelta;
 		}
+		// Once everything is pushed, wait for the last event to play before resetting the channels
+		if (currentEventIx == midiEvents.count() && currentNanos <= nanosNow) break;
+		usleep(sleepNanos / MasterClock::NANOS_PER_MICROSECOND);
 	}
-	SMFProcessor::sendChannelsReset(synthRoute);
+	SMFProcessor::sendChannelsReset(synthRoute, stopProcessing);
 	emit driver->playbackTimeChanged(0, 0);
 	qDebug() << "SMFDriver: processor thread stopped";
 	driver->deleteMidiSession(session);
 	if (!stopProcessing) emit driver->playbackFinished();
 }
 
+bool SMFProcessor::pushEvent(SynthRoute *synthRoute, const QMidiEventList &midiEvents, int eventIx, MasterClockNanos eventNanos) {
+	const QMidiEvent &e = midiEvents.at(eventIx);
+	switch (e.getType()) {
+		case SHORT_MESSAGE:
+			return synthRoute->pushMIDIShortMessage(e.getShortMessage(), eventNanos);
+		case SYSEX:
+			return synthRoute->pushMIDISysex(midiEvents.getSysexData(e), e.getSysexLen(), eventNanos);
+		case SET_TEMPO: {
+			uint tempo = e.getShortMessage();
+			midiTick = parser.getMidiTick(tempo);
+			emit driver->tempoUpdated(MidiParser::MICROSECONDS_PER_MINUTE / tempo);
+			return true;
+		}
+		default:
+			return true;
+	}
+}
+
 quint32 SMFProcessor::estimateRemainingTime(const QMidiEventList &midiEvents, int currentEventIx) {
 	MasterClockNanos tick = midiTick;
 	MasterClockNanos totalNanos = 0;
@@ -157,7 +244,7 @@ void SMFProcessor::seek(SynthRoute *synthRoute, const QMidiEventList &midiEvents
 				break;
 			}
 			case SYSEX:
-				synthRoute->playMIDISysexNow(e.getSysexData(), e.getSysexLen());
+				synthRoute->playMIDISysexNow(midiEvents.getSysexData(e), e.getSysexLen());
 				break;
 			case SET_TEMPO: {
 				uint tempo = e.getShortMessage();
@@ -213,6 +300,10 @@ void SMFDriver::jump(int newPosition) {
 	seekPosition = newPosition;
 }
 
+void SMFDriver::prefetch(const QStringList &fileNames) {
+	parserCache.prefetch(fileNames);
+}
+
 SMFDriver::~SMFDriver() {
 	stop();
 }
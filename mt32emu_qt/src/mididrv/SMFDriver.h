@@ -10,6 +10,41 @@
 
 class SMFDriver;
 
+// Parses the upcoming MIDI files on a background thread while the current one plays.
+// The parsed files are cached by path along with the file size and modification time to detect changes.
+class SMFParserCache : public QThread {
+public:
+	SMFParserCache();
+	~SMFParserCache();
+	// Replaces the files waiting to be parsed
+	void prefetch(const QStringList &fileNames);
+	// Returns true and fills the parser if the file is cached and hasn't changed since.
+	// If the file is being parsed at the moment, waits for it to finish.
+	bool lookup(const QString &fileName, MidiParser &parser);
+
+protected:
+	void run();
+
+private:
+	struct Entry {
+		QString fileName;
+		qint64 fileSize;
+		QDateTime lastModified;
+		MidiParser parser;
+	};
+
+	QMutex mutex;
+	QWaitCondition parsingFinished;
+	QStringList pendingFileNames;
+	QString parsingFileName;
+	// Most recently used first
+	QList<Entry> entries;
+	bool workerActive;
+	volatile bool stopProcessing;
+
+	int findEntry(const QString &fileName, const QFileInfo &fileInfo) const;
+};
+
 class SMFProcessor : public QThread {
 	Q_OBJECT
 
@@ -30,7 +65,8 @@ private:
 	volatile bool bpmUpdated;
 	QString fileName;
 
-	static void sendChannelsReset(SynthRoute *synthRoute);
+	static void sendChannelsReset(SynthRoute *synthRoute, bool discardPendingEvents);
+	bool pushEvent(SynthRoute *synthRoute, const QMidiEventList &midiEvents, int eventIx, MasterClockNanos eventNanos);
 	quint32 estimateRemainingTime(const QMidiEventList &midiEvents, int currentEventIx);
 	void seek(SynthRoute *synthRoute, const QMidiEventList &midiEvents, int &currentEventIx, MasterClockNanos &currentEventNanos, const MasterClockNanos seekNanos);
 };
@@ -48,9 +84,11 @@ public:
 	void setBPM(quint32 newBPM);
 	void setFastForwardingFactor(uint useFastForwardingFactor);
 	void jump(int newPosition);
+	void prefetch(const QStringList &fileNames);
 
 private:
 	SMFProcessor processor;
+	SMFParserCache parserCache;
 	volatile uint fastForwardingFactor;
 	volatile int seekPosition;
 
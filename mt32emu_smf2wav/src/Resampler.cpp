@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2015 Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <cstring>
+
+#include "Resampler.h"
+
+using namespace MT32Emu;
+
+// Number of input frames converted to float and filtered in one go
+static const unsigned int INPUT_CHUNK_FRAMES = 4096;
+
+// Number of zero crossings of the sinc on each side of the centre, determines the steepness of the filter
+static const unsigned int ZERO_CROSSINGS = 16;
+
+// Upper limit of the number of tabulated filter phases, intermediate phases are interpolated
+static const unsigned int MAX_PHASE_COUNT = 1024;
+
+// Passband edge relative to the Nyquist frequency of the lower of the two sample rates
+static const double PASSBAND = 0.91;
+
+// Kaiser window shape parameter, gives about 90 dB stopband attenuation
+static const double KAISER_BETA = 8.6;
+
+static const double PI = 3.1415926535897932;
+
+static unsigned int gcd(unsigned int a, unsigned int b) {
+	while (b != 0) {
+		unsigned int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+// Zeroth order modified Bessel function of the first kind
+static double besselI0(double x) {
+	double sum = 1.0;
+	double term = 1.0;
+	double halfX = x / 2.0;
+	for (unsigned int k = 1; k < 64; k++) {
+		term *= (halfX / k) * (halfX / k);
+		sum += term;
+		if (term < sum * 1e-12) break;
+	}
+	return sum;
+}
+
+// Four independent accumulators let the compiler vectorise the loop without reassociating floating point additions.
+static inline float convolve(const float *samples, const float *coeffs, unsigned int length) {
+	float acc0 = 0.0f, acc1 = 0.0f, acc2 = 0.0f, acc3 = 0.0f;
+	for (unsigned int i = 0; i < length; i += 4) {
+		acc0 += samples[i] * coeffs[i];
+		acc1 += samples[i + 1] * coeffs[i + 1];
+		acc2 += samples[i + 2] * coeffs[i + 2];
+		acc3 += samples[i + 3] * coeffs[i + 3];
+	}
+	return (acc0 + acc1) + (acc2 + acc3);
+}
+
+static inline Bit16s convertOutputSample(float sample) {
+	float rounded = sample + ((sample < 0) ? -0.5f : +0.5f);
+	if (rounded <= -32768.0f) return -32768;
+	if (rounded >= 32767.0f) return 32767;
+	return Bit16s(rounded);
+}
+
+Resampler::Resampler(unsigned int inputSampleRate, unsigned int outputSampleRate) {
+	unsigned int divisor = gcd(inputSampleRate, outputSampleRate);
+	upFactor = outputSampleRate / divisor;
+	downFactor = inputSampleRate / divisor;
+	phaseCount = upFactor < MAX_PHASE_COUNT ? upFactor : MAX_PHASE_COUNT;
+
+	// When downsampling, the cutoff moves down along with the output Nyquist frequency, and the filter gets longer
+	double bandwidth = outputSampleRate < inputSampleRate ? double(outputSampleRate) / inputSampleRate : 1.0;
+	unsigned int halfTapCount = unsigned(ceil(ZERO_CROSSINGS / bandwidth));
+	halfTapCount = (halfTapCount + 1) & ~1u;
+	tapCount = 2 * halfTapCount;
+
+	kernel = new float[(phaseCount + 1) * tapCount];
+	interpolatedKernel = new float[tapCount];
+	initKernel(PASSBAND * bandwidth);
+
+	leftBuffer = new float[tapCount + INPUT_CHUNK_FRAMES];
+	rightBuffer = new float[tapCount + INPUT_CHUNK_FRAMES];
+	// Pre-fill the history with silence, so that the first output frame is centred at the first input frame
+	bufferedFrameCount = halfTapCount - 1;
+	memset(leftBuffer, 0, bufferedFrameCount * sizeof(float));
+	memset(rightBuffer, 0, bufferedFrameCount * sizeof(float));
+	windowStart = 0;
+	phaseNumerator = 0;
+}
+
+Resampler::~Resampler() {
+	delete[] kernel;
+	delete[] interpolatedKernel;
+	delete[] leftBuffer;
+	delete[] rightBuffer;
+}
+
+void Resampler::initKernel(double cutoff) {
+	double halfTapCount = tapCount / 2;
+	double windowNorm = besselI0(KAISER_BETA);
+	for (unsigned int phase = 0; phase <= phaseCount; phase++) {
+		float *coeffs = kernel + phase * tapCount;
+		double delay = double(phase) / phaseCount;
+		double sum = 0.0;
+		for (unsigned int tap = 0; tap < tapCount; tap++) {
+			double t = tap - (halfTapCount - 1.0) - delay;
+			double x = cutoff * t;
+			double sinc = (fabs(x) < 1e-9) ? 1.0 : sin(PI * x) / (PI * x);
+			double r = t / halfTapCount;
+			double window = (fabs(r) < 1.0) ? besselI0(KAISER_BETA * sqrt(1.0 - r * r)) / windowNorm : 0.0;
+			double coeff = cutoff * sinc * window;
+			coeffs[tap] = float(coeff);
+			sum += coeff;
+		}
+		// Normalise each phase for unity DC gain, so there's no ripple at the rate of the phase change
+		for (unsigned int tap = 0; tap < tapCount; tap++) {
+			coeffs[tap] = float(coeffs[tap] / sum);
+		}
+	}
+}
+
+const float *Resampler::getKernel() {
+	if (phaseCount == upFactor) {
+		return kernel + phaseNumerator * tapCount;
+	}
+	double phase = double(phaseNumerator) * phaseCount / upFactor;
+	unsigned int phaseIx = unsigned(phase);
+	float fraction = float(phase - phaseIx);
+	const float *coeffs0 = kernel + phaseIx * tapCount;
+	const float *coeffs1 = coeffs0 + tapCount;
+	for (unsigned int tap = 0; tap < tapCount; tap++) {
+		interpolatedKernel[tap] = coeffs0[tap] + fraction * (coeffs1[tap] - coeffs0[tap]);
+	}
+	return interpolatedKernel;
+}
+
+unsigned int Resampler::getMaxOutputFrameCount(unsigned int inputFrameCount) const {
+	return unsigned(double(inputFrameCount) * upFactor / downFactor) + 2;
+}
+
+// Filters the history at the current position and advances the position by one output frame
+void Resampler::produceOutputFrame(Bit16s *output) {
+	const float *coeffs = getKernel();
+	output[0] = convertOutputSample(convolve(leftBuffer + windowStart, coeffs, tapCount));
+	output[1] = convertOutputSample(convolve(rightBuffer + windowStart, coeffs, tapCount));
+	windowStart += downFactor / upFactor;
+	phaseNumerator += downFactor % upFactor;
+	if (phaseNumerator >= upFactor) {
+		phaseNumerator -= upFactor;
+		windowStart++;
+	}
+}
+
+unsigned int Resampler::process(const Bit16s *input, unsigned int inputFrameCount, Bit16s *output) {
+	unsigned int outputFrameCount = 0;
+	while (inputFrameCount > 0) {
+		unsigned int chunkFrameCount = tapCount + INPUT_CHUNK_FRAMES - bufferedFrameCount;
+		if (chunkFrameCount > inputFrameCount) chunkFrameCount = inputFrameCount;
+		for (unsigned int i = 0; i < chunkFrameCount; i++) {
+			leftBuffer[bufferedFrameCount + i] = *(input++);
+			rightBuffer[bufferedFrameCount + i] = *(input++);
+		}
+		bufferedFrameCount += chunkFrameCount;
+		inputFrameCount -= chunkFrameCount;
+
+		while (windowStart + tapCount <= bufferedFrameCount) {
+			produceOutputFrame(output);
+			output += 2;
+			outputFrameCount++;
+		}
+
+		// Drop the history that is no longer needed
+		if (windowStart > bufferedFrameCount) {
+			// Heavy downsampling may step over the whole buffer
+			windowStart -= bufferedFrameCount;
+			bufferedFrameCount = 0;
+		} else {
+			bufferedFrameCount -= windowStart;
+			memmove(leftBuffer, leftBuffer + windowStart, bufferedFrameCount * sizeof(float));
+			memmove(rightBuffer, rightBuffer + windowStart, bufferedFrameCount * sizeof(float));
+			windowStart = 0;
+		}
+	}
+	return outputFrameCount;
+}
+
+unsigned int Resampler::getMaxFlushFrameCount() const {
+	return getMaxOutputFrameCount(tapCount / 2);
+}
+
+unsigned int Resampler::flush(Bit16s *output) {
+	// The history is shorter than the filter after process(), so there is always room for the padding
+	unsigned int halfTapCount = tapCount / 2;
+	unsigned int inputEndIx = bufferedFrameCount;
+	memset(leftBuffer + bufferedFrameCount, 0, halfTapCount * sizeof(float));
+	memset(rightBuffer + bufferedFrameCount, 0, halfTapCount * sizeof(float));
+	bufferedFrameCount += halfTapCount;
+
+	// The output frame is centred at index windowStart + halfTapCount - 1 of the history (plus the fractional phase).
+	// Only the frames centred within the actual input are produced, so the output length matches the input duration.
+	unsigned int outputFrameCount = 0;
+	while (windowStart + tapCount <= bufferedFrameCount && windowStart + halfTapCount - 1 < inputEndIx) {
+		produceOutputFrame(output);
+		output += 2;
+		outputFrameCount++;
+	}
+	bufferedFrameCount = 0;
+	windowStart = 0;
+	return outputFrameCount;
+}
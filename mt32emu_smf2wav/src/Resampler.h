@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2015 Jerome Fisher, Sergey V. Mikayev
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <mt32emu/mt32emu.h>
+
+// Polyphase windowed-sinc sample rate converter for interleaved 16-bit stereo streams.
+// The time position is tracked as an exact fraction of the input sample, so the output never drifts.
+// When the reduced output rate has too many phases to tabulate, the filter is interpolated between adjacent phases.
+class Resampler {
+public:
+	Resampler(unsigned int inputSampleRate, unsigned int outputSampleRate);
+	~Resampler();
+
+	// Returns the maximum number of frames process() may produce given inputFrameCount frames.
+	unsigned int getMaxOutputFrameCount(unsigned int inputFrameCount) const;
+
+	// Consumes inputFrameCount stereo frames and fills in as many output frames as the input allows.
+	// Returns the number of output frames produced. Note, the filter holds back half its length of the input.
+	unsigned int process(const MT32Emu::Bit16s *input, unsigned int inputFrameCount, MT32Emu::Bit16s *output);
+
+	// Returns the maximum number of frames flush() may produce.
+	unsigned int getMaxFlushFrameCount() const;
+
+	// Pads the input with silence to produce the output frames held back by the filter at the end of the stream.
+	// Returns the number of output frames produced. The resampler must not be used afterwards.
+	unsigned int flush(MT32Emu::Bit16s *output);
+
+private:
+	// Upsampling ratio and downsampling ratio reduced by GCD
+	unsigned int upFactor;
+	unsigned int downFactor;
+
+	unsigned int tapCount;
+	unsigned int phaseCount;
+	// tapCount coefficients per phase, phaseCount + 1 phases to simplify interpolation
+	float *kernel;
+	float *interpolatedKernel;
+
+	// Planar input history, windowStart is the index of the first sample covered by the filter
+	float *leftBuffer;
+	float *rightBuffer;
+	unsigned int bufferedFrameCount;
+	unsigned int windowStart;
+	// Fractional part of the position in units of 1 / upFactor of the input sample
+	unsigned int phaseNumerator;
+
+	void initKernel(double cutoff);
+	const float *getKernel();
+	void produceOutputFrame(MT32Emu::Bit16s *output);
+
+	Resampler(const Resampler &);
+	Resampler &operator=(const Resampler &);
+};
+
+#endif // RESAMPLER_H
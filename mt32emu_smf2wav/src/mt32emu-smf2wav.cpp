@@ -22,22 +22,44 @@
 #include <cstdlib>
 #include <cstring>
 
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
 #include <glib.h>
 
 #include <mt32emu/mt32emu.h>
 
 #include "config.h"
 #include "smf.h"
+#include "Resampler.h"
 
 static const int DEFAULT_BUFFER_SIZE = 128 * 1024;
 
 // Maximum number of frames to render in each pass while waiting for reverb to become inactive.
 static const unsigned int MAX_REVERB_END_FRAMES = 8192;
 
-static const int HEADEROFFS_RIFFLEN = 4;
-static const int HEADEROFFS_SAMPLERATE = 24;
-static const int HEADEROFFS_BYTERATE = 28;
-static const int HEADEROFFS_DATALEN = 40;
+// Rendered data is handed over to the output thread in blocks through a ring of this many entries.
+static const unsigned int OUTPUT_BLOCK_COUNT = 4;
+static const unsigned int OUTPUT_BLOCK_SIZE = 256 * 1024;
+
+// Size of the data in the ds64 chunk of an RF64 file. While the file fits in 4 GB, the space is reserved with a JUNK chunk.
+static const guint32 DS64_CHUNK_DATA_SIZE = 28;
+static const unsigned int MAX_HEADER_SIZE = 128;
+
+// Trailing 12 bytes of Sony Wave64 GUIDs, the leading 4 bytes contain the familiar RIFF tag.
+static const guint8 W64_RIFF_GUID_TAIL[] = {0x2E, 0x91, 0xCF, 0x11, 0xA5, 0xD6, 0x28, 0xDB, 0x04, 0xC1, 0x00, 0x00};
+static const guint8 W64_GUID_TAIL[] = {0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A};
+
+enum OutputFormat {
+	// RIFF WAVE, automatically turns into RF64 when the file grows beyond 4 GB.
+	OutputFormat_WAVE,
+	// Sony Wave64, 64-bit chunk sizes.
+	OutputFormat_W64,
+	// Headerless interleaved samples, suitable for streaming.
+	OutputFormat_RAW
+};
 
 static const MT32Emu::DACInputMode DAC_INPUT_MODES[] = {
 	MT32Emu::DACInputMode_NICE,
@@ -58,18 +80,26 @@ struct Options {
 	gchar *outputFilename;
 	gboolean force;
 	gboolean quiet;
+	FILE *messageStream;
+
+	OutputFormat outputFormat;
+	gboolean floatSamples;
+	bool outputToStdout;
 
 	gchar *romDir;
 	unsigned int bufferFrameCount;
+	// Sample rate of the output file
 	gint sampleRate;
+	// Sample rate the synth renders at, MIDI events are timed in these frames
+	unsigned int synthSampleRate;
 
 	MT32Emu::DACInputMode dacInputMode;
 	MT32Emu::AnalogOutputMode analogOutputMode;
 	int rawChannelMap[8];
 	int rawChannelCount;
 
-	unsigned int renderMinFrames;
-	unsigned int renderMaxFrames;
+	guint64 renderMinFrames;
+	guint64 renderMaxFrames;
 	gint recordMaxStartSilentFrames;
 	gint recordMaxEndSilentFrames;
 	gint recordMaxLA32EndSilentFrames;
@@ -78,16 +108,35 @@ struct Options {
 	gboolean sendAllNotesOff;
 };
 
+// Writes the rendered data to the output file in a separate thread, so that I/O stalls don't stall rendering.
+struct OutputWriter {
+	FILE *file;
+	GThread *thread;
+	GMutex mutex;
+	GCond cond;
+	guint8 *blocks[OUTPUT_BLOCK_COUNT];
+	gsize blockLengths[OUTPUT_BLOCK_COUNT];
+	// Queued blocks are consumed by the output thread starting from headBlockIx.
+	unsigned int headBlockIx;
+	unsigned int queuedBlockCount;
+	// Block being filled by the rendering thread, it always follows the queued ones.
+	unsigned int fillBlockIx;
+	bool finished;
+	bool ioError;
+};
+
 struct State {
 	MT32Emu::Bit16s *stereoSampleBuffer;
 	MT32Emu::Bit16s *rawSampleBuffer[6];
+	MT32Emu::Bit16s *resampledSampleBuffer;
 	MT32Emu::Synth *synth;
-	FILE *outputFile;
+	Resampler *resampler;
+	OutputWriter *writer;
 	bool lastInputFile;
 	bool firstNoiseEncountered;
-	unsigned long unwrittenSilentFrames;
-	unsigned long renderedFrames;
-	unsigned long writtenFrames;
+	guint64 unwrittenSilentFrames;
+	guint64 renderedFrames;
+	guint64 writtenFrames;
 };
 
 static void freeOptions(Options *options) {
@@ -102,6 +151,7 @@ static void freeOptions(Options *options) {
 static bool parseOptions(int argc, char *argv[], Options *options) {
 	gint dacInputModeIx = 0;
 	gint analogOutputModeIx = 0;
+	gint outputFormatIx = OutputFormat_WAVE;
 	gint bufferFrameCount = DEFAULT_BUFFER_SIZE;
 	gint renderMinFrames = 0;
 	gint renderMaxFrames = -1;
@@ -111,8 +161,12 @@ static bool parseOptions(int argc, char *argv[], Options *options) {
 	options->outputFilename = NULL;
 	options->force = false;
 	options->quiet = false;
+	options->messageStream = stdout;
+	options->floatSamples = false;
+	options->outputToStdout = false;
 
 	options->romDir = NULL;
+	options->sampleRate = 0;
 
 	options->dacInputMode = DAC_INPUT_MODES[0];
 	options->analogOutputMode = ANALOG_OUTPUT_MODES[0];
@@ -126,7 +180,14 @@ static bool parseOptions(int argc, char *argv[], Options *options) {
 	options->sendAllNotesOff = true;
 	// FIXME: Perhaps there's a nicer way to represent long argument descriptions...
 	GOptionEntry entries[] = {
-		{"output", 'o', 0, G_OPTION_ARG_FILENAME, &options->outputFilename, "Output file (default: last source file name with \".wav\" appended)", "<filename>"},
+		{"output", 'o', 0, G_OPTION_ARG_FILENAME, &options->outputFilename, "Output file (default: last source file name with \".wav\" appended)\n"
+		 "                \"-\" streams raw samples to the standard output, output format is ignored in this case", "<filename>"},
+		{"output-format", 'F', 0, G_OPTION_ARG_INT, &outputFormatIx, "Output file format (default: 0)\n"
+		 "                Ignored if -w is used (in which case raw file is always written)\n"
+		 "                 0: WAVE (turns into RF64 when exceeding 4 GB)\n"
+		 "                 1: Wave64\n"
+		 "                 2: RAW (headerless stereo samples, little-endian)", "<output_format>"},
+		{"float", 0, 0, G_OPTION_ARG_NONE, &options->floatSamples, "Write 32-bit floating point samples instead of signed 16-bit integer", NULL},
 		{"force", 'f', 0, G_OPTION_ARG_NONE, &options->force, "Overwrite the output file if it already exists", NULL},
 		{"quiet", 'q', 0, G_OPTION_ARG_NONE, &options->quiet, "Be quiet", NULL},
 
@@ -134,7 +195,9 @@ static bool parseOptions(int argc, char *argv[], Options *options) {
 		// buffer-size determines the maximum number of frames to be rendered by the emulator in one pass.
 		// This can have a big impact on performance (Generally more at a time=better).
 		{"buffer-size", 'b', 0, G_OPTION_ARG_INT, &bufferFrameCount, "Buffer size in frames (minimum: 1)", "<frame_count>"},  // FIXME: Show default
-//		{"sample-rate", 'r', 0, G_OPTION_ARG_INT, &options->sampleRate, "Sample rate in Hz (minimum: 1, default: auto)", "<sample_rate>"},
+		{"sample-rate", 'r', 0, G_OPTION_ARG_INT, &options->sampleRate, "Sample rate in Hz (minimum: 1, default: auto)\n"
+		 "                If it differs from the rate the synth renders at, the output is resampled\n"
+		 "                Not supported with -w", "<sample_rate>"},
 
 		{"analog-output-mode", 'a', 0, G_OPTION_ARG_INT, &analogOutputModeIx, "Analogue low-pass filter emulation mode (default: 0)\n"
 		 "                 0: DISABLED\n"
@@ -148,7 +211,7 @@ static bool parseOptions(int argc, char *argv[], Options *options) {
 		 "                 1: PURE\n"
 		 "                 2: GENERATION1\n"
 		 "                 3: GENERATION2", "<dac_input_mode>"},
-		{"raw-stream", 'w', 0, G_OPTION_ARG_STRING_ARRAY, &rawStreams, "Write a raw file with signed 16-bit big-endian samples instead of a WAVE file, and include the specified channel.\n"
+		{"raw-stream", 'w', 0, G_OPTION_ARG_STRING_ARRAY, &rawStreams, "Write a raw file with signed 16-bit (or 32-bit float if --float is used) big-endian samples instead of a WAVE file, and include the specified channel.\n"
 		 "                This option can be specified multiple times (up to eight), in which case streams will be written to the file multiplexed sample-by-sample in the order given.\n"
 		 "                Available stream IDs:\n"
 		 "                -1: Dummy stream filled with 0\n"
@@ -188,13 +251,21 @@ static bool parseOptions(int argc, char *argv[], Options *options) {
 		fprintf(stderr, "dac-input-mode must be between 0 and 3\n");
 		parseSuccess = false;
 	}
+	if (outputFormatIx < OutputFormat_WAVE || outputFormatIx > OutputFormat_RAW) {
+		fprintf(stderr, "output-format must be between 0 and 2\n");
+		parseSuccess = false;
+	}
+	if (options->sampleRate < 0) {
+		fprintf(stderr, "sample-rate must be greater than 0\n");
+		parseSuccess = false;
+	}
 	if (bufferFrameCount < 1) {
 		fprintf(stderr, "buffer-size must be greater than 0\n");
 		parseSuccess = false;
 	} else {
 		options->bufferFrameCount = bufferFrameCount;
 	}
-	options->renderMaxFrames = renderMaxFrames < 0 ? INT_MAX : renderMaxFrames;
+	options->renderMaxFrames = renderMaxFrames < 0 ? G_MAXUINT64 : renderMaxFrames;
 	options->renderMinFrames = renderMinFrames < 0 ? 0 : renderMinFrames;
 	if (options->renderMinFrames > options->renderMaxFrames) {
 		options->renderMinFrames = options->renderMaxFrames;
@@ -242,7 +313,21 @@ static bool parseOptions(int argc, char *argv[], Options *options) {
 		parseSuccess = false;
 	}
 	options->analogOutputMode = ANALOG_OUTPUT_MODES[analogOutputModeIx];
+	options->outputToStdout = g_strcmp0(options->outputFilename, "-") == 0;
+	if (options->outputToStdout) {
+		// The header can't be updated in a stream, and the standard output is occupied with samples.
+		options->outputFormat = OutputFormat_RAW;
+		options->messageStream = stderr;
+	} else if (options->rawChannelCount > 0) {
+		options->outputFormat = OutputFormat_RAW;
+	} else {
+		options->outputFormat = OutputFormat(outputFormatIx);
+	}
 	g_strfreev(rawStreams);
+	if (options->rawChannelCount > 0 && options->sampleRate > 0) {
+		fprintf(stderr, "sample-rate cannot be used with raw-stream\n");
+		parseSuccess = false;
+	}
 	if (options->rawChannelCount > 0) {
 		options->dacInputMode = MT32Emu::DACInputMode_PURE;
 	} else {
@@ -261,64 +346,268 @@ static long secondsToSamples(double seconds, int sampleRate) {
 	return long(seconds * sampleRate);
 }
 
-static bool writeWAVEHeader(FILE *outputFile, int sampleRate) {
-	int byteRate = sampleRate * 4;
+// Returns the number of frames the synth renders to produce the given number of output frames
+static guint64 convertOutputToSynthFrames(guint64 outputFrames, const Options &options) {
+	if (outputFrames == G_MAXUINT64) return outputFrames;
+	return (outputFrames * options.synthSampleRate + options.sampleRate - 1) / options.sampleRate;
+}
+
+static guint8 *putTag(guint8 *p, const char *tag) {
+	memcpy(p, tag, 4);
+	return p + 4;
+}
+
+static guint8 *putBytes(guint8 *p, const guint8 *bytes, gsize length) {
+	memcpy(p, bytes, length);
+	return p + length;
+}
+
+static guint8 *putLE16(guint8 *p, guint16 value) {
+	p[0] = value & 0xFF;
+	p[1] = (value >> 8) & 0xFF;
+	return p + 2;
+}
+
+static guint8 *putLE32(guint8 *p, guint32 value) {
+	p = putLE16(p, value & 0xFFFF);
+	return putLE16(p, (value >> 16) & 0xFFFF);
+}
+
+static guint8 *putLE64(guint8 *p, guint64 value) {
+	p = putLE32(p, guint32(value & 0xFFFFFFFF));
+	return putLE32(p, guint32(value >> 32));
+}
+
+static guint8 *putBE16(guint8 *p, guint16 value) {
+	p[0] = (value >> 8) & 0xFF;
+	p[1] = value & 0xFF;
+	return p + 2;
+}
+
+static guint8 *putBE32(guint8 *p, guint32 value) {
+	p = putBE16(p, (value >> 16) & 0xFFFF);
+	return putBE16(p, value & 0xFFFF);
+}
+
+static inline guint8 *putSample(guint8 *p, MT32Emu::Bit16s sample, bool floatSamples, bool bigEndian) {
+	if (floatSamples) {
+		float floatSample = sample / 32768.0f;
+		guint32 bits;
+		memcpy(&bits, &floatSample, sizeof(bits));
+		return bigEndian ? putBE32(p, bits) : putLE32(p, bits);
+	}
+	return bigEndian ? putBE16(p, sample) : putLE16(p, sample);
+}
+
+static unsigned int getOutputFrameSize(const Options &options) {
+	unsigned int channelCount = options.rawChannelCount > 0 ? options.rawChannelCount : 2;
+	return channelCount * (options.floatSamples ? 4 : 2);
+}
+
+static gsize makeWAVEHeader(guint8 *header, const Options &options, guint64 frameCount) {
+	guint32 frameSize = getOutputFrameSize(options);
+	guint64 dataSize = frameCount * frameSize;
+	guint32 fmtSize = options.floatSamples ? 18 : 16;
+	guint32 factChunkSize = options.floatSamples ? 12 : 0;
+	guint64 riffSize = 4 + (8 + DS64_CHUNK_DATA_SIZE) + (8 + fmtSize) + factChunkSize + 8 + dataSize;
+	bool rf64 = riffSize > 0xFFFFFFFFu;
 	// All values are little-endian
-	unsigned char waveHeader[] = {
-		'R','I','F','F',
-		0,0,0,0, // Length to be filled in later
-		'W','A','V','E',
-
-		// "fmt " chunk
-		'f','m','t',' ',
-		0x10, 0x00, 0x00, 0x00, // 0x00000010 - 16 byte chunk
-		0x01, 0x00, // 0x0001 - PCM/Uncompressed
-		0x02, 0x00, // 0x0002 - 2 channels
-		0x00, 0x7D, 0x00, 0x00, // 0x00007D00 - 32kHz, overwritten by real sample rate below
-		0x00, 0xF4, 0x01, 0x00, // 0x0001F400 - 128000 bytes/sec, overwritten with real value below
-		0x04, 0x00, // 0x0004 - 4 byte alignment
-		0x10, 0x00, // 0x0010 - 16 bits/sample
-
-		// "data" chunk
-		'd','a','t','a',
-		0x00, 0x00, 0x00, 0x00 // Chunk length, to be filled in later
-	};
-	waveHeader[HEADEROFFS_SAMPLERATE] = sampleRate & 0xFF;
-	waveHeader[HEADEROFFS_SAMPLERATE + 1] = (sampleRate >> 8) & 0xFF;
-	waveHeader[HEADEROFFS_SAMPLERATE + 2] = (sampleRate >> 16) & 0xFF;
-	waveHeader[HEADEROFFS_SAMPLERATE + 3] = (sampleRate >> 24) & 0xFF;
-	waveHeader[HEADEROFFS_BYTERATE] = byteRate & 0xFF;
-	waveHeader[HEADEROFFS_BYTERATE + 1] = (byteRate >> 8) & 0xFF;
-	waveHeader[HEADEROFFS_BYTERATE + 2] = (byteRate >> 16) & 0xFF;
-	waveHeader[HEADEROFFS_BYTERATE + 3] = (byteRate >> 24) & 0xFF;
-	return fwrite(waveHeader, 1, sizeof(waveHeader), outputFile) == sizeof(waveHeader);
-}
-
-static bool fillWAVESizes(FILE *outputFile, int numFrames) {
-	// FIXME: Check return codes, etc.
-	int dataSize = numFrames * 4;
-	int riffSize = dataSize + 28;
-	if (fseek(outputFile, HEADEROFFS_RIFFLEN, SEEK_SET))
-		return false;
-	if (fputc(riffSize & 0xFF, outputFile) == EOF)
-		return false;
-	if (fputc((riffSize >> 8) & 0xFF, outputFile) == EOF)
-		return false;
-	if (fputc((riffSize >> 16) & 0xFF, outputFile) == EOF)
-		return false;
-	if (fputc((riffSize >> 24) & 0xFF, outputFile) == EOF)
-		return false;
-	if (fseek(outputFile, HEADEROFFS_DATALEN, SEEK_SET))
-		return false;
-	if (fputc(dataSize & 0xFF, outputFile) == EOF)
-		return false;
-	if (fputc((dataSize >> 8) & 0xFF, outputFile) == EOF)
-		return false;
-	if (fputc((dataSize >> 16) & 0xFF, outputFile) == EOF)
-		return false;
-	if (fputc((dataSize >> 24) & 0xFF, outputFile) == EOF)
+	guint8 *p = header;
+	p = putTag(p, rf64 ? "RF64" : "RIFF");
+	p = putLE32(p, rf64 ? 0xFFFFFFFFu : guint32(riffSize));
+	p = putTag(p, "WAVE");
+
+	// "ds64" chunk, or "JUNK" chunk reserving space for it
+	p = putTag(p, rf64 ? "ds64" : "JUNK");
+	p = putLE32(p, DS64_CHUNK_DATA_SIZE);
+	p = putLE64(p, rf64 ? riffSize : 0);
+	p = putLE64(p, rf64 ? dataSize : 0);
+	p = putLE64(p, rf64 ? frameCount : 0);
+	p = putLE32(p, 0); // No table entries
+
+	// "fmt " chunk
+	p = putTag(p, "fmt ");
+	p = putLE32(p, fmtSize);
+	p = putLE16(p, options.floatSamples ? 0x0003 : 0x0001); // IEEE float or PCM/Uncompressed
+	p = putLE16(p, 2); // 2 channels
+	p = putLE32(p, options.sampleRate);
+	p = putLE32(p, options.sampleRate * frameSize); // bytes/sec
+	p = putLE16(p, frameSize); // alignment
+	p = putLE16(p, options.floatSamples ? 32 : 16); // bits/sample
+	if (options.floatSamples) {
+		p = putLE16(p, 0); // No extension
+
+		// "fact" chunk, mandatory for non-PCM formats
+		p = putTag(p, "fact");
+		p = putLE32(p, 4);
+		p = putLE32(p, rf64 ? 0xFFFFFFFFu : guint32(frameCount));
+	}
+
+	// "data" chunk
+	p = putTag(p, "data");
+	p = putLE32(p, rf64 ? 0xFFFFFFFFu : guint32(dataSize));
+	return p - header;
+}
+
+static guint8 *putW64ChunkHeader(guint8 *p, const char *tag, guint64 chunkDataSize) {
+	p = putTag(p, tag);
+	p = putBytes(p, W64_GUID_TAIL, sizeof(W64_GUID_TAIL));
+	// Chunk size includes the 24-byte chunk header but not the padding up to 8-byte boundary
+	return putLE64(p, chunkDataSize + 24);
+}
+
+static guint64 getW64Padding(guint64 size) {
+	return (8 - (size & 7)) & 7;
+}
+
+static gsize makeW64Header(guint8 *header, const Options &options, guint64 frameCount) {
+	guint32 frameSize = getOutputFrameSize(options);
+	guint64 dataSize = frameCount * frameSize;
+	guint32 fmtSize = options.floatSamples ? 18 : 16;
+	guint64 fmtChunkSize = 24 + fmtSize + getW64Padding(fmtSize);
+	guint64 factChunkSize = options.floatSamples ? 24 + 8 : 0;
+	guint64 riffSize = 40 + fmtChunkSize + factChunkSize + 24 + dataSize + getW64Padding(dataSize);
+	// All values are little-endian
+	guint8 *p = header;
+	p = putTag(p, "riff");
+	p = putBytes(p, W64_RIFF_GUID_TAIL, sizeof(W64_RIFF_GUID_TAIL));
+	p = putLE64(p, riffSize);
+	p = putTag(p, "wave");
+	p = putBytes(p, W64_GUID_TAIL, sizeof(W64_GUID_TAIL));
+
+	p = putW64ChunkHeader(p, "fmt ", fmtSize);
+	p = putLE16(p, options.floatSamples ? 0x0003 : 0x0001); // IEEE float or PCM/Uncompressed
+	p = putLE16(p, 2); // 2 channels
+	p = putLE32(p, options.sampleRate);
+	p = putLE32(p, options.sampleRate * frameSize); // bytes/sec
+	p = putLE16(p, frameSize); // alignment
+	p = putLE16(p, options.floatSamples ? 32 : 16); // bits/sample
+	if (options.floatSamples) {
+		p = putLE16(p, 0); // No extension
+		memset(p, 0, getW64Padding(fmtSize));
+		p += getW64Padding(fmtSize);
+
+		p = putW64ChunkHeader(p, "fact", 8);
+		p = putLE64(p, frameCount);
+	}
+
+	p = putW64ChunkHeader(p, "data", dataSize);
+	return p - header;
+}
+
+static bool writeHeader(FILE *outputFile, const Options &options, guint64 frameCount) {
+	guint8 header[MAX_HEADER_SIZE];
+	gsize headerSize;
+	switch (options.outputFormat) {
+	case OutputFormat_WAVE:
+		headerSize = makeWAVEHeader(header, options, frameCount);
+		break;
+	case OutputFormat_W64:
+		headerSize = makeW64Header(header, options, frameCount);
+		break;
+	default:
+		return true;
+	}
+	return fwrite(header, 1, headerSize, outputFile) == headerSize;
+}
+
+// Rewrites the header once the final sizes are known. The header length doesn't depend on the sizes.
+static bool fillHeaderSizes(FILE *outputFile, const Options &options, guint64 frameCount) {
+	if (options.outputFormat == OutputFormat_RAW) {
+		return true;
+	}
+	if (options.outputFormat == OutputFormat_W64) {
+		static const guint8 zeros[8] = {0};
+		gsize padding = gsize(getW64Padding(frameCount * getOutputFrameSize(options)));
+		if (fwrite(zeros, 1, padding, outputFile) != padding) {
+			return false;
+		}
+	}
+	if (fseek(outputFile, 0, SEEK_SET)) {
 		return false;
-	return true;
+	}
+	return writeHeader(outputFile, options, frameCount);
+}
+
+static gpointer outputThread(gpointer data) {
+	OutputWriter *writer = (OutputWriter *)data;
+	g_mutex_lock(&writer->mutex);
+	for (;;) {
+		while (writer->queuedBlockCount == 0 && !writer->finished) {
+			g_cond_wait(&writer->cond, &writer->mutex);
+		}
+		if (writer->queuedBlockCount == 0) break;
+		unsigned int blockIx = writer->headBlockIx;
+		bool skip = writer->ioError;
+		g_mutex_unlock(&writer->mutex);
+		bool success = skip || fwrite(writer->blocks[blockIx], 1, writer->blockLengths[blockIx], writer->file) == writer->blockLengths[blockIx];
+		g_mutex_lock(&writer->mutex);
+		if (!success) {
+			writer->ioError = true;
+		}
+		writer->headBlockIx = (blockIx + 1) % OUTPUT_BLOCK_COUNT;
+		writer->queuedBlockCount--;
+		g_cond_signal(&writer->cond);
+	}
+	g_mutex_unlock(&writer->mutex);
+	return NULL;
+}
+
+static void startOutputWriter(OutputWriter &writer, FILE *outputFile) {
+	writer.file = outputFile;
+	for (unsigned int i = 0; i < OUTPUT_BLOCK_COUNT; i++) {
+		writer.blocks[i] = new guint8[OUTPUT_BLOCK_SIZE];
+		writer.blockLengths[i] = 0;
+	}
+	writer.headBlockIx = 0;
+	writer.queuedBlockCount = 0;
+	writer.fillBlockIx = 0;
+	writer.finished = false;
+	writer.ioError = false;
+	g_mutex_init(&writer.mutex);
+	g_cond_init(&writer.cond);
+	writer.thread = g_thread_new("output", outputThread, &writer);
+}
+
+// Hands the block being filled over to the output thread and waits until a free block is available.
+static void submitOutputBlock(OutputWriter &writer) {
+	g_mutex_lock(&writer.mutex);
+	writer.queuedBlockCount++;
+	g_cond_signal(&writer.cond);
+	while (writer.queuedBlockCount == OUTPUT_BLOCK_COUNT) {
+		g_cond_wait(&writer.cond, &writer.mutex);
+	}
+	g_mutex_unlock(&writer.mutex);
+	writer.fillBlockIx = (writer.fillBlockIx + 1) % OUTPUT_BLOCK_COUNT;
+	writer.blockLengths[writer.fillBlockIx] = 0;
+}
+
+// Returns a pointer to byteCount bytes of the output stream to be filled in. byteCount must not exceed OUTPUT_BLOCK_SIZE.
+static inline guint8 *reserveOutput(OutputWriter &writer, gsize byteCount) {
+	if (writer.blockLengths[writer.fillBlockIx] + byteCount > OUTPUT_BLOCK_SIZE) {
+		submitOutputBlock(writer);
+	}
+	guint8 *p = writer.blocks[writer.fillBlockIx] + writer.blockLengths[writer.fillBlockIx];
+	writer.blockLengths[writer.fillBlockIx] += byteCount;
+	return p;
+}
+
+// Flushes pending data and stops the output thread. Returns false if any data failed to be written.
+static bool stopOutputWriter(OutputWriter &writer) {
+	g_mutex_lock(&writer.mutex);
+	if (writer.blockLengths[writer.fillBlockIx] > 0) {
+		writer.queuedBlockCount++;
+	}
+	writer.finished = true;
+	g_cond_signal(&writer.cond);
+	g_mutex_unlock(&writer.mutex);
+	g_thread_join(writer.thread);
+	g_cond_clear(&writer.cond);
+	g_mutex_clear(&writer.mutex);
+	for (unsigned int i = 0; i < OUTPUT_BLOCK_COUNT; i++) {
+		delete[] writer.blocks[i];
+	}
+	return !writer.ioError;
 }
 
 static bool loadFile(MT32Emu::Bit8u *&fileBuffer, gsize &fileBufferLength, const gchar *filename, const gchar *displayFilename) {
@@ -360,56 +649,77 @@ enum Occasion {
 };
 
 static void flushSilence(Occasion occasion, const Options &options, State &state) {
-	unsigned int channelCount = options.rawChannelCount > 0 ? options.rawChannelCount : 2;
-	int writtenFrames = state.unwrittenSilentFrames;
+	guint64 writtenFrames = state.unwrittenSilentFrames;
 	switch(occasion) {
 	case NOISE_DETECTED:
 		if (!state.firstNoiseEncountered) {
 			state.firstNoiseEncountered = true;
-			writtenFrames = MIN(writtenFrames, options.recordMaxStartSilentFrames);
+			writtenFrames = MIN(writtenFrames, guint64(options.recordMaxStartSilentFrames));
 		}
 		state.unwrittenSilentFrames = 0;
 		break;
 	case MIDI_ENDED:
-		writtenFrames = MIN(writtenFrames, options.recordMaxEndSilentFrames);
+		writtenFrames = MIN(writtenFrames, guint64(options.recordMaxEndSilentFrames));
 		state.unwrittenSilentFrames -= writtenFrames;
 		break;
 	case LA32_INACTIVE:
-		writtenFrames = MIN(writtenFrames, options.recordMaxLA32EndSilentFrames);
+		writtenFrames = MIN(writtenFrames, guint64(options.recordMaxLA32EndSilentFrames));
 		state.unwrittenSilentFrames -= writtenFrames;
 		break;
 	}
-	for (unsigned long i = 0; i < writtenFrames * sizeof(MT32Emu::Bit16s) * channelCount; i++) {
-		fputc(0, state.outputFile);
+	unsigned int frameSize = getOutputFrameSize(options);
+	guint64 framesLeft = writtenFrames;
+	while (framesLeft > 0) {
+		// Zero bits represent silence for both integer and float samples
+		unsigned int framesThisPass = unsigned(MIN(framesLeft, guint64(OUTPUT_BLOCK_SIZE / frameSize)));
+		memset(reserveOutput(*state.writer, framesThisPass * frameSize), 0, framesThisPass * frameSize);
+		framesLeft -= framesThisPass;
 	}
 	state.writtenFrames += writtenFrames;
 }
 
+static void writeStereo(const MT32Emu::Bit16s *outputBuffer, unsigned int frameCount, const Options &options, State &state) {
+	unsigned int frameSize = getOutputFrameSize(options);
+	for (unsigned int i = 0; i < frameCount; i++) {
+		unsigned int leftIx = i * 2;
+		unsigned int rightIx = leftIx + 1;
+		bool silent = outputBuffer[leftIx] == 0 && outputBuffer[rightIx] == 0;
+		if (silent) {
+			state.unwrittenSilentFrames++;
+			continue;
+		}
+		flushSilence(NOISE_DETECTED, options, state);
+		guint8 *p = reserveOutput(*state.writer, frameSize);
+		p = putSample(p, outputBuffer[leftIx], options.floatSamples != 0, false);
+		putSample(p, outputBuffer[rightIx], options.floatSamples != 0, false);
+		state.writtenFrames++;
+	}
+}
+
 static void renderStereo(unsigned int frameCount, const Options &options, State &state) {
 	state.renderedFrames += frameCount;
 	while (frameCount > 0) {
 		unsigned int renderedFramesThisPass = MIN(frameCount, options.bufferFrameCount);
 		state.synth->render(state.stereoSampleBuffer, renderedFramesThisPass);
-		for (unsigned int i = 0; i < renderedFramesThisPass; i++) {
-			unsigned int leftIx = i * 2;
-			unsigned int rightIx = leftIx + 1;
-			bool silent = state.stereoSampleBuffer[leftIx] == 0 && state.stereoSampleBuffer[rightIx] == 0;
-			if (silent) {
-				state.unwrittenSilentFrames++;
-				continue;
-			}
-			flushSilence(NOISE_DETECTED, options, state);
-			fputc(state.stereoSampleBuffer[leftIx] & 0xFF, state.outputFile);
-			fputc((state.stereoSampleBuffer[leftIx] >> 8) & 0xFF, state.outputFile);
-			fputc(state.stereoSampleBuffer[rightIx] & 0xFF, state.outputFile);
-			fputc((state.stereoSampleBuffer[rightIx] >> 8) & 0xFF, state.outputFile);
-			state.writtenFrames++;
+		if (state.resampler != NULL) {
+			unsigned int outputFramesThisPass = state.resampler->process(state.stereoSampleBuffer, renderedFramesThisPass, state.resampledSampleBuffer);
+			writeStereo(state.resampledSampleBuffer, outputFramesThisPass, options, state);
+		} else {
+			writeStereo(state.stereoSampleBuffer, renderedFramesThisPass, options, state);
 		}
 		frameCount -= renderedFramesThisPass;
 	}
 }
 
+// Writes out the frames the resampler holds back at the end of the stream
+static void flushResampler(const Options &options, State &state) {
+	if (state.resampler == NULL) return;
+	unsigned int outputFrameCount = state.resampler->flush(state.resampledSampleBuffer);
+	writeStereo(state.resampledSampleBuffer, outputFrameCount, options, state);
+}
+
 static void renderRaw(unsigned int frameCount, const Options &options, State &state) {
+	unsigned int frameSize = getOutputFrameSize(options);
 	state.renderedFrames += frameCount;
 	while (frameCount > 0) {
 		unsigned int renderedFramesThisPass = MIN(frameCount, options.bufferFrameCount);
@@ -429,15 +739,13 @@ static void renderRaw(unsigned int frameCount, const Options &options, State &st
 				continue;
 			}
 			flushSilence(NOISE_DETECTED, options, state);
+			guint8 *p = reserveOutput(*state.writer, frameSize);
 			for (int chanMapIx = 0; chanMapIx < options.rawChannelCount; chanMapIx++) {
-				if (options.rawChannelMap[chanMapIx] < 0) {
-					fputc(0, state.outputFile);
-					fputc(0, state.outputFile);
-				} else {
-					MT32Emu::Bit16s sample = state.rawSampleBuffer[options.rawChannelMap[chanMapIx]][i];
-					fputc((sample >> 8) & 0xFF, state.outputFile);
-					fputc(sample & 0xFF, state.outputFile);
+				MT32Emu::Bit16s sample = 0;
+				if (options.rawChannelMap[chanMapIx] >= 0) {
+					sample = state.rawSampleBuffer[options.rawChannelMap[chanMapIx]][i];
 				}
+				p = putSample(p, sample, options.floatSamples != 0, true);
 			}
 			state.writtenFrames++;
 		}
@@ -456,10 +764,10 @@ static void render(unsigned int frameCount, const Options &options, State &state
 static void playSMF(smf_t *smf, const Options &options, State &state) {
 	int unterminatedSysexLen = 0;
 	unsigned char *unterminatedSysex = NULL;
-	unsigned long renderedFrames = 0;
+	guint64 renderedFrames = 0;
 	for (;;) {
 		smf_event_t *event = smf_get_next_event(smf);
-		unsigned long eventFrameIx;
+		guint64 eventFrameIx;
 
 		if (event == NULL) {
 			break;
@@ -467,10 +775,10 @@ static void playSMF(smf_t *smf, const Options &options, State &state) {
 
 		assert(event->track->track_number >= 0);
 
-		eventFrameIx = secondsToSamples(event->time_seconds, options.sampleRate);
-		unsigned int renderLength = (eventFrameIx > renderedFrames) ? eventFrameIx - renderedFrames : 1;
+		eventFrameIx = secondsToSamples(event->time_seconds, options.synthSampleRate);
+		unsigned int renderLength = (eventFrameIx > renderedFrames) ? unsigned(eventFrameIx - renderedFrames) : 1;
 		if (state.renderedFrames + renderLength > options.renderMaxFrames) {
-			renderLength = options.renderMaxFrames - state.renderedFrames;
+			renderLength = unsigned(options.renderMaxFrames - state.renderedFrames);
 		}
 		render(renderLength, options, state);
 		renderedFrames += renderLength;
@@ -481,7 +789,7 @@ static void playSMF(smf_t *smf, const Options &options, State &state) {
 		if (smf_event_is_metadata(event)) {
 			char *decoded = smf_event_decode(event);
 			if (decoded && !options.quiet) {
-				fprintf(stdout, "Metadata: %s\n", decoded);
+				fprintf(options.messageStream, "Metadata: %s\n", decoded);
 			}
 		} else if (smf_event_is_sysex(event) || smf_event_is_sysex_continuation(event))  {
 			bool unterminated = smf_event_is_unterminated_sysex(event) != 0;
@@ -551,7 +859,7 @@ static void playSMF(smf_t *smf, const Options &options, State &state) {
 		}
 	}
 	if (state.lastInputFile && options.renderMinFrames > state.renderedFrames) {
-		render(options.renderMinFrames - state.renderedFrames, options, state);
+		render(unsigned(options.renderMinFrames - state.renderedFrames), options, state);
 	}
 	if (options.waitForLA32) {
 		while (state.renderedFrames < options.renderMaxFrames && state.synth->hasActivePartials()) {
@@ -570,7 +878,7 @@ static void playSMF(smf_t *smf, const Options &options, State &state) {
 				// Note that once we've detected inactivity, silent samples will not be written.
 				unsigned int renderLength = reverbEndFrames;
 				if (state.renderedFrames + renderLength > options.renderMaxFrames) {
-					renderLength = options.renderMaxFrames - state.renderedFrames;
+					renderLength = unsigned(options.renderMaxFrames - state.renderedFrames);
 				}
 				render(renderLength, options, state);
 			}
@@ -595,7 +903,7 @@ static bool playFile(const gchar *inputFilename, const gchar *displayInputFilena
 	if (smf != NULL) {
 		if (!options.quiet) {
 			char *decoded = smf_decode(smf);
-			fprintf(stdout, "%s.\n", decoded);
+			fprintf(options.messageStream, "%s.\n", decoded);
 			free(decoded);
 		}
 		assert(smf->number_of_tracks >= 1);
@@ -609,11 +917,11 @@ static bool playFile(const gchar *inputFilename, const gchar *displayInputFilena
 
 int main(int argc, char *argv[]) {
 	Options options;
-	printf("Munt MT32Emu MIDI to Wave Conversion Utility. Version %s\n", VERSION);
-	printf("  Copyright (C) 2009, 2011 Jerome Fisher <re_munt@kingguppy.com>\n");
 	if (!parseOptions(argc, argv, &options)) {
 		return -1;
 	}
+	fprintf(options.messageStream, "Munt MT32Emu MIDI to Wave Conversion Utility. Version %s\n", VERSION);
+	fprintf(options.messageStream, "  Copyright (C) 2009, 2011 Jerome Fisher <re_munt@kingguppy.com>\n");
 	gchar *outputFilename;
 	gchar *displayOutputFilename;
 	if (options.outputFilename != NULL) {
@@ -626,8 +934,10 @@ int main(int argc, char *argv[]) {
 			fprintf(stderr, "Error allocating %lu bytes for destination filename.\n", allocLen);
 			return -1;
 		}
-		if (options.rawChannelCount > 0) {
+		if (options.outputFormat == OutputFormat_RAW) {
 			sprintf(outputFilename, "%s.raw", lastInputFilename);
+		} else if (options.outputFormat == OutputFormat_W64) {
+			sprintf(outputFilename, "%s.w64", lastInputFilename);
 		} else {
 			sprintf(outputFilename, "%s.wav", lastInputFilename);
 		}
@@ -665,12 +975,26 @@ int main(int argc, char *argv[]) {
 	MT32Emu::Synth *synth = new MT32Emu::Synth();
 	if (synth->open(*controlROMImage, *pcmROMImage, options.analogOutputMode)) {
 		synth->setDACInputMode(options.dacInputMode);
-		options.sampleRate = synth->getStereoOutputSampleRate();
-		printf("Using output sample rate %d Hz\n", options.sampleRate);
+		// Raw streams are taken at the DAC entrance, so they are never affected by the analogue circuit emulation
+		options.synthSampleRate = options.rawChannelCount > 0 ? MT32Emu::SAMPLE_RATE : synth->getStereoOutputSampleRate();
+		if (options.sampleRate == 0) {
+			options.sampleRate = options.synthSampleRate;
+		}
+		fprintf(options.messageStream, "Using output sample rate %d Hz\n", options.sampleRate);
+		if (unsigned(options.sampleRate) != options.synthSampleRate) {
+			fprintf(options.messageStream, "Resampling from %d Hz\n", options.synthSampleRate);
+			// The limits are given in output frames, while the rendering is counted in the frames produced by the synth
+			options.renderMinFrames = convertOutputToSynthFrames(options.renderMinFrames, options);
+			options.renderMaxFrames = convertOutputToSynthFrames(options.renderMaxFrames, options);
+		}
 
 		FILE *outputFile;
 		bool outputFileExists = false;
-		if (!options.force) {
+		if (options.outputToStdout) {
+#ifdef _WIN32
+			_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		} else if (!options.force) {
 			// FIXME: Lame way of avoiding overwriting an existing file
 			// (since it could theoretically be created between us testing and
 			// opening for writing)
@@ -678,7 +1002,9 @@ int main(int argc, char *argv[]) {
 				outputFileExists = true;
 			}
 		}
-		if (outputFileExists) {
+		if (options.outputToStdout) {
+			outputFile = stdout;
+		} else if (outputFileExists) {
 			fprintf(stderr, "Destination file '%s' exists.\n", displayOutputFilename);
 			outputFile = NULL;
 		} else {
@@ -688,9 +1014,10 @@ int main(int argc, char *argv[]) {
 		clock_t startTime = clock();
 
 		if (outputFile != NULL) {
-			if (options.rawChannelCount > 0 || writeWAVEHeader(outputFile, options.sampleRate)) {
-				State state = {NULL, {NULL, NULL, NULL, NULL, NULL, NULL}, synth, outputFile, false, false, 0, 0, 0};
-				state.outputFile = outputFile;
+			if (writeHeader(outputFile, options, 0)) {
+				OutputWriter writer;
+				startOutputWriter(writer, outputFile);
+				State state = {NULL, {NULL, NULL, NULL, NULL, NULL, NULL}, NULL, synth, NULL, &writer, false, false, 0, 0, 0};
 				if (options.rawChannelCount > 0) {
 					state.rawSampleBuffer[0] = new MT32Emu::Bit16s[options.bufferFrameCount];
 					state.rawSampleBuffer[1] = new MT32Emu::Bit16s[options.bufferFrameCount];
@@ -700,6 +1027,11 @@ int main(int argc, char *argv[]) {
 					state.rawSampleBuffer[5] = new MT32Emu::Bit16s[options.bufferFrameCount];
 				} else {
 					state.stereoSampleBuffer = new MT32Emu::Bit16s[options.bufferFrameCount * 2];
+					if (unsigned(options.sampleRate) != options.synthSampleRate) {
+						state.resampler = new Resampler(options.synthSampleRate, options.sampleRate);
+						unsigned int resampledFrameCount = MAX(state.resampler->getMaxOutputFrameCount(options.bufferFrameCount), state.resampler->getMaxFlushFrameCount());
+						state.resampledSampleBuffer = new MT32Emu::Bit16s[resampledFrameCount * 2];
+					}
 				}
 				gchar **inputFilename = options.inputFilenames;
 				while (*inputFilename != NULL) {
@@ -709,21 +1041,30 @@ int main(int argc, char *argv[]) {
 					inputFilename++;
 					g_free(displayInputFilename);
 				}
+				flushResampler(options, state);
 				delete[] state.stereoSampleBuffer;
+				delete[] state.resampledSampleBuffer;
+				delete state.resampler;
 				delete[] state.rawSampleBuffer[0];
 				delete[] state.rawSampleBuffer[1];
 				delete[] state.rawSampleBuffer[2];
 				delete[] state.rawSampleBuffer[3];
 				delete[] state.rawSampleBuffer[4];
 				delete[] state.rawSampleBuffer[5];
-				if (options.rawChannelCount == 0 && !fillWAVESizes(outputFile, state.writtenFrames)) {
-					fprintf(stderr, "Error writing final sizes to WAVE header\n");
+				if (!stopOutputWriter(writer)) {
+					fprintf(stderr, "Error writing to '%s'\n", displayOutputFilename);
+				} else if (!fillHeaderSizes(outputFile, options, state.writtenFrames)) {
+					fprintf(stderr, "Error writing final sizes to file header\n");
 				}
 			} else {
-				fprintf(stderr, "Error writing WAVE header to '%s'\n", displayOutputFilename);
+				fprintf(stderr, "Error writing file header to '%s'\n", displayOutputFilename);
+			}
+			if (options.outputToStdout) {
+				fflush(outputFile);
+			} else {
+				fclose(outputFile);
 			}
-			fclose(outputFile);
-			printf("Elapsed time: %f sec\n", float(clock() - startTime) / CLOCKS_PER_SEC);
+			fprintf(options.messageStream, "Elapsed time: %f sec\n", float(clock() - startTime) / CLOCKS_PER_SEC);
 		} else {
 			fprintf(stderr, "Error opening file '%s' for writing.\n", displayOutputFilename);
 		}